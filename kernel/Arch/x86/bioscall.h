@@ -57,7 +57,8 @@ struct bios_regs {
  *        of the CPU after the call.
  * @param int_no the number of the bioscall/interrupt to perform.
  *
- * @note must be called in protected mode.
+ * @note must be called in protected mode, with the stack in the first 4 MB:
+ *       the code runs from their identity mapping until paging is off.
  */
 void bioscall(struct bios_regs *regs, unsigned char int_no);
 
@@ -10,10 +10,42 @@
 #ifndef _BOOTSTRAP_H_
 #define _BOOTSTRAP_H_
 
+#include "stdint.h"
+
 /**
- * Kernel offset of virtual address space.
+ * Kernel offset of virtual address space: the last GB on x86, the last
+ * 2 GB on x86_64, where -mcmodel=kernel code must run.
  */
+#ifdef __x86_64__
+#define KERNEL_BASE     0xFFFFFFFF80000000ul
+#else
 #define KERNEL_BASE     0xC0000000
+#endif
+
+/**
+ * Kernel image limits, virtual addresses.
+ */
+extern char _start[];
+extern char _bss_end[];
+
+/**
+ * Init sections: code and data only used while the kernel starts. Their
+ * pages are given to the page frame allocator once it runs, nothing from
+ * them may be used after kernel_main has set the allocators up.
+ */
+#define __init          __attribute__((section(".init.text")))
+#define __initdata      __attribute__((section(".init.data")))
+
+extern char _init_start[];
+extern char _init_end[];
+
+/**
+ * Size of the bootstrap heap, block map included: the bootheap=<size>
+ * kernel argument, in bytes or with a K or M suffix. It is carved from free
+ * memory when the kernel starts.
+ */
+#define BOOTSTRAP_HEAP_DEFAULT  (1024 * 1024)
+extern uint32_t bootstrap_heap_size;
 
 /**
  * Tors limits;
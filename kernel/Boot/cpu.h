@@ -9,6 +9,38 @@
 #ifndef __CPU_H__
 #define __CPU_H__
 
+/* Control registers bits */
+#define CR0_WP          0x00010000      /* Read only pages hold in kernel mode too */
+#define CR0_PG          0x80000000      /* Paging */
+#define CR4_PSE         0x00000010      /* 4 MB pages */
+#define CR4_PAE         0x00000020      /* 64 bits entries, 36 bits physical addresses */
+#define CR4_PGE         0x00000080      /* Global pages */
+
+/* CPUID leaf 1 features, in EDX */
+#define CPUID_PSE       0x00000008
+#define CPUID_PAE       0x00000040
+#define CPUID_PGE       0x00002000
+
+/* CPUID extended leaves, and leaf 0x80000001 features in EDX */
+#define CPUID_EXTENDED  0x80000000
+#define CPUID_FEATURES  0x80000001
+#define CPUID_LONG_MODE 0x20000000
+
+/* Extended feature enable register, and its long mode enable bit */
+#define MSR_EFER        0xC0000080
+#define EFER_LME        0x00000100
+
+/* Page directory and page table entries bits */
+#define PAGE_PRESENT    0x001
+#define PAGE_WRITE      0x002
+#define PAGE_USER       0x004
+#define PAGE_ACCESSED   0x020
+#define PAGE_DIRTY      0x040
+#define PAGE_LARGE      0x080           /* 4 MB page, 2 MB with PAE, in a directory entry */
+#define PAGE_GLOBAL     0x100           /* Kept in the TLB when CR3 changes */
+
+#ifndef __ASSEMBLER__
+
 #include "stdint.h"
 
 __inline__ static void outb(uint8_t value, uint16_t port)
@@ -16,5 +48,82 @@ __inline__ static void outb(uint8_t value, uint16_t port)
 	__asm__ __volatile__("outb %0, %1" : : "a" (value), "Nd" (port));
 }
 
+__inline__ static uint8_t inb(uint16_t port)
+{
+	uint8_t value;
+
+	__asm__ __volatile__("inb %1, %0" : "=a" (value) : "Nd" (port));
+	return value;
+}
+
+__inline__ static uint64_t rdtsc(void)
+{
+	uint32_t low, high;
+
+	/* Not "=A": on x86_64 it would be a single register, not edx:eax */
+	__asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+	return ((uint64_t) high << 32) | low;
+}
+
+__inline__ static void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+                             uint32_t *ecx, uint32_t *edx)
+{
+	__asm__ __volatile__("cpuid"
+	                     : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+	                     : "a" (leaf));
+}
+
+__inline__ static unsigned long read_cr2(void)
+{
+	unsigned long value;
+
+	__asm__ __volatile__("mov %%cr2, %0" : "=r" (value));
+	return value;
+}
+
+__inline__ static unsigned long read_cr4(void)
+{
+	unsigned long value;
+
+	__asm__ __volatile__("mov %%cr4, %0" : "=r" (value));
+	return value;
+}
+
+__inline__ static void write_cr4(unsigned long value)
+{
+	__asm__ __volatile__("mov %0, %%cr4" : : "r" (value) : "memory");
+}
+
+__inline__ static void write_cr3(unsigned long value)
+{
+	__asm__ __volatile__("mov %0, %%cr3" : : "r" (value) : "memory");
+}
+
+/* Index of the lowest bit set in a word, that must not be null */
+__inline__ static uint32_t bit_scan_forward(uint32_t word)
+{
+	uint32_t index;
+
+	__asm__("bsfl %1, %0" : "=r" (index) : "rm" (word));
+	return index;
+}
+
+/* Index of the highest bit set in a word, that must not be null */
+__inline__ static uint32_t bit_scan_reverse(uint32_t word)
+{
+	uint32_t index;
+
+	__asm__("bsrl %1, %0" : "=r" (index) : "rm" (word));
+	return index;
+}
+
+/* Drop the TLB entry of a virtual address, global or not */
+__inline__ static void invlpg(unsigned long address)
+{
+	__asm__ __volatile__("invlpg (%0)" : : "r" (address) : "memory");
+}
+
+#endif /* __ASSEMBLER__ */
+
 #endif
 
@@ -0,0 +1,75 @@
+/*
+ * memorymap.cpp
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Physical memory map construction. Loaders give entries in any order,
+ * sometimes overlapping: PhysicalMemoryMap sorts them out.
+ */
+
+extern "C" {
+#include "stdio.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "multiboot.h"
+#include "bootstrap.h"
+}
+#include "new.h"
+#include "memorymap.h"
+#include "Memory/PhysicalMemoryMap.h"
+
+/* The map of the machine, in static storage: no allocator is ready yet */
+static PhysicalMemoryMap *memory_map = (PhysicalMemoryMap*) NULL;
+static void *memory_map_storage[(sizeof(PhysicalMemoryMap) + sizeof(void*) - 1) / sizeof(void*)];
+
+/* Status names, for display */
+static const char *status_names[] = { "free", "reserved", "unknown" };
+
+void __init memorymap_setup(void)
+{
+        struct memory_chunk chunks[MEMORY_MAP_MAX_CHUNKS];
+        const multiboot_memory_map_t *entry;
+        PhysicalMemoryMap::iterator chunk;
+        int count;
+        int i;
+
+        count = 0;
+        for (i = 0; i < multiboot_mmap_count() && count < MEMORY_MAP_MAX_CHUNKS; i++) {
+                entry = multiboot_mmap_entry(i);
+                chunks[count].address = entry->addr;
+                chunks[count].length = entry->len;
+                chunks[count].status = (entry->type == MULTIBOOT_MEMORY_AVAILABLE)
+                                       ? FREE_MEMORY : RESERVED_MEMORY;
+                count++;
+        }
+
+        /* No map from the loader: trust the memory sizes */
+        if (count == 0) {
+                chunks[0].address = 0;
+                chunks[0].length = (uint64_t) multiboot_lower_memory() * 1024;
+                chunks[0].status = FREE_MEMORY;
+                chunks[1].address = 0x100000;
+                chunks[1].length = (uint64_t) multiboot_upper_memory() * 1024;
+                chunks[1].status = FREE_MEMORY;
+                count = 2;
+        }
+
+        if (memory_map == NULL) {
+                memory_map = new (memory_map_storage) PhysicalMemoryMap();
+        }
+        memory_map->build(chunks, count);
+
+        printf("Physical memory map:\n");
+        for (chunk = memory_map->begin(); chunk != memory_map->end(); chunk++) {
+                printf("  %08x%08x - %08x%08x %s\n",
+                       (uint32_t) (chunk->address >> 32), (uint32_t) chunk->address,
+                       (uint32_t) ((chunk->address + chunk->length - 1) >> 32),
+                       (uint32_t) (chunk->address + chunk->length - 1),
+                       status_names[chunk->status]);
+        }
+}
+
+PhysicalMemoryMap *memorymap_get(void)
+{
+        return memory_map;
+}
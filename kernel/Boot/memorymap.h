@@ -0,0 +1,36 @@
+/*
+ * memorymap.h
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Physical memory map of the machine, built from what the loader reports.
+ */
+
+#ifndef _MEMORYMAP_H_
+#define _MEMORYMAP_H_
+
+#ifdef __cplusplus
+class PhysicalMemoryMap;
+
+extern "C" {
+#endif
+
+/**
+ * Build the physical memory map from the multiboot memory map, or from the
+ * lower and upper memory sizes if the loader gave no map. Must be called
+ * after multiboot_save.
+ */
+void memorymap_setup(void);
+
+#ifdef __cplusplus
+/**
+ * Provides the physical memory map built by memorymap_setup.
+ *
+ * @return the memory map, sorted and without overlap. NULL if it was
+ *         not built yet.
+ */
+PhysicalMemoryMap *memorymap_get(void);
+}
+#endif
+
+#endif /* _MEMORYMAP_H_ */
@@ -23,6 +23,9 @@ static multiboot_info_t mb_info;
 static char bootloader_name[256];
 static char cmdline_args[1024];
 
+static multiboot_memory_map_t mmap_entries[MULTIBOOT_MMAP_MAX];
+static int mmap_count;
+
 /* Local addresses translation macro */
 #define PHY_TO_VIRT(add)        ((add) + KERNEL_BASE)
 
@@ -34,10 +37,10 @@ int multiboot_check(uint32_t magic)
         return (magic == MULTIBOOT_BOOTLOADER_MAGIC);
 }
 
-void multiboot_save(multiboot_info_t *mb)
+void __init multiboot_save(multiboot_info_t *mb)
 {
         /* Check we have a virtual adress */
-        if (((uint32_t)mb & KERNEL_BASE) != KERNEL_BASE) {
+        if (((uintptr_t)mb & KERNEL_BASE) != KERNEL_BASE) {
                 printf("%s\n", "multiboot: multiboot_info_t pointer is not a valid virtual address");
                 return;
         }
@@ -59,6 +62,23 @@ void multiboot_save(multiboot_info_t *mb)
         } else {
                 cmdline_args[0] = '\0';
         }
+
+        /* Memory map: entries begin with their size, the size excluded */
+        mmap_count = 0;
+        if ((mb_info.flags & MULTIBOOT_INFO_MEM_MAP) == MULTIBOOT_INFO_MEM_MAP) {
+                uint32_t offset;
+                multiboot_memory_map_t *entry;
+
+                for (offset = 0;
+                     offset < mb_info.mmap_length && mmap_count < MULTIBOOT_MMAP_MAX;
+                     offset += entry->size + sizeof(entry->size)) {
+                        entry = (multiboot_memory_map_t*) PHY_TO_VIRT(mb_info.mmap_addr + offset);
+                        memcpy(&mmap_entries[mmap_count++], entry, sizeof(multiboot_memory_map_t));
+                }
+                if (offset < mb_info.mmap_length) {
+                        printf("multiboot: memory map truncated to %d entries\n", MULTIBOOT_MMAP_MAX);
+                }
+        }
 }
 
 const char *multiboot_bootloader_name(void)
@@ -79,3 +99,34 @@ const char *multiboot_cmdline_args(void)
         }
 }
 
+
+int multiboot_mmap_count(void)
+{
+        return mmap_count;
+}
+
+const multiboot_memory_map_t *multiboot_mmap_entry(int index)
+{
+        if (index < 0 || index >= mmap_count) {
+                return NULL;
+        }
+        return &mmap_entries[index];
+}
+
+uint32_t multiboot_lower_memory(void)
+{
+        if ((mb_info.flags & MULTIBOOT_INFO_MEMORY) == MULTIBOOT_INFO_MEMORY) {
+                return mb_info.mem_lower;
+        } else {
+                return 0;
+        }
+}
+
+uint32_t multiboot_upper_memory(void)
+{
+        if ((mb_info.flags & MULTIBOOT_INFO_MEMORY) == MULTIBOOT_INFO_MEMORY) {
+                return mb_info.mem_upper;
+        } else {
+                return 0;
+        }
+}
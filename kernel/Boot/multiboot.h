@@ -254,5 +254,39 @@ const char *multiboot_bootloader_name(void);
  */
 const char *multiboot_cmdline_args(void);
 
+/**
+ * Most memory map entries kept from the loader.
+ */
+#define MULTIBOOT_MMAP_MAX                      64
+
+/**
+ * Provides the count of memory map entries given by the loader.
+ *
+ * @return the count of entries, 0 if the memory map is not available.
+ */
+int multiboot_mmap_count(void);
+
+/**
+ * Provides a memory map entry given by the loader.
+ *
+ * @param index the index of the entry, less than multiboot_mmap_count()
+ * @return the entry, in the order the loader gave them.
+ */
+const multiboot_memory_map_t *multiboot_mmap_entry(int index);
+
+/**
+ * Provides the amount of memory below 1 MB.
+ *
+ * @return the size of lower memory in kB, 0 if it's not available.
+ */
+uint32_t multiboot_lower_memory(void);
+
+/**
+ * Provides the amount of memory above 1 MB, up to the first memory hole.
+ *
+ * @return the size of upper memory in kB, 0 if it's not available.
+ */
+uint32_t multiboot_upper_memory(void);
+
 #endif /* ! MULTIBOOT_HEADER */
 
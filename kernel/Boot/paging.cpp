@@ -0,0 +1,155 @@
+/*
+ * paging.cpp
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Kernel address space setup. The normal zone is mapped at KERNEL_BASE for
+ * good, with global large pages: one TLB entry per 4 MB, or 2 MB with PAE,
+ * kept across address space switches.
+ *
+ * On x86_64, crt0.S already mapped the whole normal zone with 2 MB pages,
+ * in four level page tables the AddressSpace does not handle yet: they are
+ * kept as they are, and there is no kernel AddressSpace.
+ *
+ * Built with PAGING_BENCH, paging_bench() measures how fast 4 kB pages are
+ * mapped and unmapped, page tables being reached through the self map.
+ */
+
+extern "C" {
+#include "stdio.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "panic.h"
+#include "cpu.h"
+#include "bootstrap.h"
+#include "timestamp.h"
+}
+#include "paging.h"
+#include "memorymap.h"
+#include "Memory/PhysicalMemoryMap.h"
+#include "Memory/AddressSpace.h"
+#include "Memory/VirtualAllocator.h"
+
+/* Paging mode, for the boot messages */
+#ifdef PAGING_PAE
+#define PAGING_MODE         ", PAE"
+#else
+#define PAGING_MODE         ""
+#endif
+
+#ifdef PAGING_BENCH
+/* Pages mapped then unmapped one by one in each round: 16 MB, 4 tables */
+#define BENCH_PAGES         4096
+#define BENCH_ROUNDS        16
+#endif
+
+#ifdef __x86_64__
+void __init paging_setup(void)
+{
+        /* Long mode has global pages, the boot entries are global already */
+        write_cr4(read_cr4() | CR4_PGE);
+
+        printf("Paging: %u MB at %08x%08x with %u MB pages, global, long mode\n",
+               BOOT_MAPPED_SIZE >> 20, (uint32_t) (KERNEL_BASE >> 32), (uint32_t) KERNEL_BASE,
+               PAGE_LARGE_SIZE >> 20);
+}
+#else
+void __init paging_setup(void)
+{
+        PhysicalMemoryMap *map = memorymap_get();
+        PhysicalMemoryMap::iterator chunk;
+        AddressSpace *kernel;
+        uint32_t eax, ebx, ecx, edx;
+        uint32_t features;
+        uint64_t end, highest;
+
+        /* crt0.S already relies on large pages, PAE ones always exist */
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+#ifndef PAGING_PAE
+        if ((edx & CPUID_PSE) == 0) {
+                panic("paging: the processor has no 4 MB pages");
+        }
+#endif
+        features = PAGE_LARGE;
+        if (edx & CPUID_PGE) {
+                write_cr4(read_cr4() | CR4_PGE);
+                features |= PAGE_GLOBAL;
+        }
+        kernel = AddressSpace::setup((page_entry_t*) boot_page_directory, features);
+
+        /* Memory of the normal zone, up to the large page holding its end */
+        highest = 0;
+        for (chunk = map->begin(); chunk != map->end(); chunk++) {
+                end = chunk->address + chunk->length;
+                if (chunk->status == FREE_MEMORY && end > highest) {
+                        highest = end;
+                }
+        }
+        highest = (highest > PAGE_ZONE_NORMAL_END) ? PAGE_ZONE_NORMAL_END : highest;
+        highest = (highest + PAGE_LARGE_SIZE - 1) & ~(uint64_t) (PAGE_LARGE_SIZE - 1);
+
+        if (highest > BOOT_MAPPED_SIZE) {
+                kernel->map(KERNEL_BASE + BOOT_MAPPED_SIZE, BOOT_MAPPED_SIZE,
+                            (uint32_t) highest - BOOT_MAPPED_SIZE, PAGE_WRITE | PAGE_GLOBAL);
+        }
+
+        printf("Paging: %u MB at %08x with %u MB pages%s%s\n",
+               (uint32_t) ((highest > BOOT_MAPPED_SIZE ? highest : BOOT_MAPPED_SIZE) >> 20),
+               KERNEL_BASE, PAGE_LARGE_SIZE >> 20, (features & PAGE_GLOBAL) ? ", global" : "",
+               PAGING_MODE);
+}
+#endif
+
+int paging_fault(unsigned long address, uint32_t error)
+{
+        VirtualAllocator *ranges = VirtualAllocator::getInstance();
+
+        /* Kernel ranges have 32 bits addresses */
+        return ranges != NULL && address == (uint32_t) address && ranges->fault(address, error);
+}
+
+#ifdef PAGING_BENCH
+void paging_bench(void)
+{
+        AddressSpace *kernel = AddressSpace::getInstance();
+        uint32_t range, address, round;
+        uint32_t mapUs = 0, unmapUs = 0;
+        uint64_t frame, start;
+
+        range = VirtualAllocator::getInstance()->reserve(BENCH_PAGES * PAGE_FRAME_SIZE, 0);
+        frame = PageFrameAllocator::getInstance()->allocPages(0);
+        if (range == 0 || frame == 0) {
+                printf("bench: paging: no memory\n");
+                return;
+        }
+
+        /* All pages map the same frame: only the tables are measured */
+        for (round = 0; round < BENCH_ROUNDS; round++) {
+                start = timestamp_read();
+                for (address = range; address < range + BENCH_PAGES * PAGE_FRAME_SIZE;
+                     address += PAGE_FRAME_SIZE) {
+                        if (kernel->map(address, frame, PAGE_FRAME_SIZE, PAGE_WRITE) != 0) {
+                                panic("bench: paging: no frame for a page table");
+                        }
+                }
+                mapUs += timestamp_elapsed_us(start);
+
+                start = timestamp_read();
+                for (address = range; address < range + BENCH_PAGES * PAGE_FRAME_SIZE;
+                     address += PAGE_FRAME_SIZE) {
+                        kernel->unmap(address, PAGE_FRAME_SIZE);
+                }
+                unmapUs += timestamp_elapsed_us(start);
+        }
+
+        mapUs = (mapUs == 0) ? 1 : mapUs;
+        unmapUs = (unmapUs == 0) ? 1 : unmapUs;
+        printf("bench: paging: %u pages of 4 kB, map %u ms (%u kpages/s), unmap %u ms (%u kpages/s)\n",
+               BENCH_PAGES * BENCH_ROUNDS,
+               mapUs / 1000, (uint32_t) ((uint64_t) BENCH_PAGES * BENCH_ROUNDS * 1000 / mapUs),
+               unmapUs / 1000, (uint32_t) ((uint64_t) BENCH_PAGES * BENCH_ROUNDS * 1000 / unmapUs));
+
+        PageFrameAllocator::getInstance()->freePages(frame, 0);
+        VirtualAllocator::getInstance()->release(range);
+}
+#endif
@@ -0,0 +1,74 @@
+/*
+ * paging.h
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Kernel address space setup. crt0.S turns paging on with a boot page
+ * directory mapping the first BOOT_MAPPED_SIZE bytes of memory at
+ * KERNEL_BASE, paging_setup() maps the rest of the normal zone.
+ */
+
+#ifndef _PAGING_H_
+#define _PAGING_H_
+
+/**
+ * Memory mapped at KERNEL_BASE by crt0.S, with large pages: room for the
+ * kernel image and the loader data. The first 4 MB are also identity
+ * mapped, for the switch to paging and BIOS calls.
+ *
+ * On x86_64, crt0.S maps the first GB, the whole normal zone: the kernel
+ * keeps these page tables, and has no page frames above them.
+ */
+#ifdef __x86_64__
+#define BOOT_MAPPED_SIZE    0x40000000
+#else
+#define BOOT_MAPPED_SIZE    0x1000000
+#endif
+
+#ifndef __ASSEMBLER__
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Page directory built by crt0.S, the directory of the kernel address
+ * space: the four directories in a row with PAE, of 64 bits entries.
+ */
+extern uint32_t boot_page_directory[];
+
+/**
+ * Build the kernel address space on the boot page directory and map the
+ * memory of the normal zone at KERNEL_BASE with global large pages. Must
+ * be called after memorymap_setup.
+ */
+void paging_setup(void);
+
+/**
+ * Handle a page fault of the kernel: back the page if it belongs to a
+ * demand range of the VirtualAllocator.
+ *
+ * @param address the faulting address
+ * @param error the error code of the fault
+ *
+ * @return 1 if the access can be retried, 0 if the fault is fatal.
+ */
+int paging_fault(unsigned long address, uint32_t error);
+
+#ifdef PAGING_BENCH
+/**
+ * Map and unmap 4 kB pages one by one in a kernel virtual range, and print
+ * the throughput on a "bench:" line. Needs the allocators of kernel_main.
+ */
+void paging_bench(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _PAGING_H_ */
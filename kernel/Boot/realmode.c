@@ -19,7 +19,7 @@
 extern char _real_mode_start[];
 extern char _real_mode_end[];
 
-void realmode_setup(void)
+void __init realmode_setup(void)
 {
         char *code_location;
         size_t code_size;
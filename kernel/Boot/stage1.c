@@ -21,6 +21,10 @@
 #include "multiboot.h"
 #include "bootstrap.h"
 #include "putbytes.h"
+#include "timestamp.h"
+#include "memorymap.h"
+#include "paging.h"
+#include "traps.h"
 #include "kernel.h"
 
 #ifdef QEMU_DEBUG
@@ -29,10 +33,13 @@
 #include "vga.h"
 #endif
 
+/* Boot options */
+uint32_t bootstrap_heap_size = BOOTSTRAP_HEAP_DEFAULT;
+
 /**
  * Abstract display initialization, depending on compilation parameters.
  */
-static void stage1_setup_display(void)
+static void __init stage1_setup_display(void)
 {
 #ifdef QEMU_DEBUG
         putbytes_callback(qemu_putbytes);
@@ -44,6 +51,52 @@ static void stage1_setup_display(void)
 #endif
 }
 
+/**
+ * Parse a size: decimal digits with an optional K or M suffix.
+ *
+ * @param str the size
+ * @param size where to store it
+ *
+ * @return 0, -1 if the size is not valid or does not fit in 32 bits.
+ */
+static int __init stage1_parse_size(const char *str, uint32_t *size)
+{
+        uint32_t value = 0;
+        uint32_t unit = 1;
+        uint32_t digit;
+
+        if (*str < '0' || *str > '9') {
+                return -1;
+        }
+        for (; *str >= '0' && *str <= '9'; str++) {
+                digit = *str - '0';
+                if (value > (UINT32_MAX - digit) / 10) {
+                        return -1;
+                }
+                value = value * 10 + digit;
+        }
+        switch (*str) {
+                case 'K':
+                case 'k':
+                        unit = 1024;
+                        str++;
+                        break;
+                case 'M':
+                case 'm':
+                        unit = 1024 * 1024;
+                        str++;
+                        break;
+                default:
+                        break;
+        }
+        if (*str != '\0' || value > UINT32_MAX / unit) {
+                return -1;
+        }
+
+        *size = value * unit;
+        return 0;
+}
+
 /**
  * Transform multiboot command line and standard C arguments.
  *
@@ -53,18 +106,20 @@ static void stage1_setup_display(void)
  *
  * @return a pointer on the tab of arguments.
  */
-char **stage1_argumentize(const char *mb_args, int *argc)
+char ** __init stage1_argumentize(const char *mb_args, int *argc)
 {
         static char *argv[32];
         static char arguments[1024];
 
         char *c;
         int count;
+        int i;
 
         /* We have no argument to parse */
         if (mb_args == NULL || mb_args[0] == '\0') {
                 argv[0] = NULL;
                 *argc = 0;
+                return argv;
         }
 
         /* Save the original argument list */
@@ -78,8 +133,7 @@ char **stage1_argumentize(const char *mb_args, int *argc)
                         case ' ':
                         case '\t':
                                 *c = '\0';
-                                count++;
-                                argv[count] = (c + 1);
+                                argv[count++] = (c + 1);
                                 break;
                         default:
                                 /* Ignore the char ... */
@@ -87,6 +141,14 @@ char **stage1_argumentize(const char *mb_args, int *argc)
                 }
         }
 
+        /* Boot options, kept for the kernel */
+        for (i = 1; i < count; i++) {
+                if (strncmp(argv[i], "bootheap=", 9) == 0
+                    && stage1_parse_size(argv[i] + 9, &bootstrap_heap_size) != 0) {
+                        printf("Ignoring %s: bad size\n", argv[i]);
+                }
+        }
+
         *argc = count;
         return argv;
 }
@@ -121,6 +183,9 @@ void stage1_main(uint32_t multiboot_magic, multiboot_info_t *multiboot_info)
         printf("%s\n", "Simple Object Kernel");
         printf("%s\n", "Running stage 1 ...");
 
+        /* Clock for boot time measurements */
+        timestamp_calibrate();
+
         /* Check we have been loaded by a compliant mutliboot loader */
         if (multiboot_check(multiboot_magic)) {
                 multiboot_save(multiboot_info);
@@ -129,6 +194,15 @@ void stage1_main(uint32_t multiboot_magic, multiboot_info_t *multiboot_info)
                 return;
         }
 
+        /* Describe physical memory for the memory management */
+        memorymap_setup();
+
+        /* Map all the normal zone, crt0.S only mapped the beginning */
+        paging_setup();
+
+        /* Catch exceptions, page faults back the demand ranges */
+        traps_setup();
+
         bootloader_name = multiboot_bootloader_name();
         if (bootloader_name != NULL) {
                 printf("Loaded by %s\n", bootloader_name);
@@ -0,0 +1,67 @@
+/*
+ * timestamp.c
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Time stamp counter calibration. The PIT channel 2 is programmed for a
+ * one shot count of 10 ms, its output is read from the speaker port.
+ */
+
+#include "stdint.h"
+#include "cpu.h"
+#include "bootstrap.h"
+#include "timestamp.h"
+
+/* PIT input clock, in Hz */
+#define PIT_FREQUENCY           1193182u
+
+/* PIT ports */
+#define PIT_CHANNEL2            0x42
+#define PIT_COMMAND             0x43
+#define PIT_SPEAKER             0x61
+
+/* Calibration duration */
+#define CALIBRATION_MS          10
+
+/* Measured frequency */
+static uint32_t cycles_per_us;
+
+void __init timestamp_calibrate(void)
+{
+        uint32_t count = PIT_FREQUENCY / (1000 / CALIBRATION_MS);
+        uint64_t start;
+
+        /* Gate channel 2 on, speaker off */
+        outb((inb(PIT_SPEAKER) & ~0x02) | 0x01, PIT_SPEAKER);
+
+        /* Channel 2, low then high byte, one shot, binary */
+        outb(0xB0, PIT_COMMAND);
+        outb(count & 0xFF, PIT_CHANNEL2);
+        outb(count >> 8, PIT_CHANNEL2);
+
+        /* Wait for the output to rise */
+        start = rdtsc();
+        while ((inb(PIT_SPEAKER) & 0x20) == 0) {
+                /* Busy wait */
+        }
+
+        cycles_per_us = (uint32_t) (rdtsc() - start) / (CALIBRATION_MS * 1000);
+}
+
+uint64_t timestamp_read(void)
+{
+        return rdtsc();
+}
+
+uint32_t timestamp_elapsed_us(uint64_t since)
+{
+        uint64_t elapsed = rdtsc() - since;
+
+        if (cycles_per_us == 0) {
+                return 0;
+        }
+        if ((elapsed >> 32) != 0) {
+                elapsed = 0xFFFFFFFFu;
+        }
+        return (uint32_t) elapsed / cycles_per_us;
+}
@@ -0,0 +1,43 @@
+/*
+ * timestamp.h
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Time stamp counter, calibrated against the PIT, to measure boot steps.
+ */
+
+#ifndef _TIMESTAMP_H_
+#define _TIMESTAMP_H_
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Measure the time stamp counter frequency. Takes 10 ms.
+ */
+void timestamp_calibrate(void);
+
+/**
+ * Read the time stamp counter.
+ *
+ * @return the count of cycles since the CPU reset
+ */
+uint64_t timestamp_read(void);
+
+/**
+ * Compute the time elapsed since a timestamp.
+ *
+ * @param since a value returned by timestamp_read
+ * @return the elapsed microseconds, 0 if the counter was not calibrated.
+ *         Saturates after 2^32 cycles.
+ */
+uint32_t timestamp_elapsed_us(uint64_t since);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TIMESTAMP_H_ */
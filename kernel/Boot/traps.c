@@ -0,0 +1,111 @@
+/*
+ * traps.c
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Exception handling. The IDT only has the exception vectors: interrupt
+ * gates to the stubs of trap_entries.S, so that interrupts stay disabled
+ * while an exception is handled.
+ */
+
+#include "stddef.h"
+#include "stdint.h"
+#include "panic.h"
+#include "cpu.h"
+#include "bootstrap.h"
+#include "paging.h"
+#include "traps.h"
+
+/* Kernel code selector, from the GDT of crt0.S */
+#define KERNEL_CODE_SELECTOR    0x08
+
+/* Present 32 bits interrupt gate, 64 bits in long mode, for the kernel only */
+#define INTERRUPT_GATE          0x8E00
+
+/* Words per gate: the offset is 64 bits wide in long mode */
+#ifdef __x86_64__
+#define GATE_WORDS              4
+#else
+#define GATE_WORDS              2
+#endif
+
+/* Stubs of trap_entries.S */
+extern char trap_entries[];
+
+/* Interrupt descriptor table */
+static uint32_t idt[TRAP_COUNT][GATE_WORDS] __attribute__((aligned(8)));
+
+/* IDT register value */
+static struct {
+        uint16_t limit;
+        uintptr_t base;
+} __attribute__((packed)) idt_desc;
+
+static const char *trap_names[TRAP_COUNT] = {
+        "divide error", "debug", "NMI", "breakpoint", "overflow",
+        "bound range", "invalid opcode", "no FPU", "double fault",
+        "FPU segment overrun", "invalid TSS", "segment not present",
+        "stack fault", "general protection", "page fault", "reserved",
+        "FPU error", "alignment check", "machine check", "SIMD error"
+};
+
+void __init traps_setup(void)
+{
+        uintptr_t entry;
+        int vector;
+
+        for (vector = 0; vector < TRAP_COUNT; vector++) {
+                entry = (uintptr_t) trap_entries + vector * TRAP_ENTRY_SIZE;
+                idt[vector][0] = (KERNEL_CODE_SELECTOR << 16) | (entry & 0xFFFF);
+                idt[vector][1] = (entry & 0xFFFF0000) | INTERRUPT_GATE;
+#ifdef __x86_64__
+                idt[vector][2] = (uint32_t) (entry >> 32);
+                idt[vector][3] = 0;
+#endif
+        }
+
+        idt_desc.limit = sizeof(idt) - 1;
+        idt_desc.base = (uintptr_t) idt;
+        __asm__ __volatile__("lidt %0" : : "m" (idt_desc));
+}
+
+#ifdef __x86_64__
+/* Upper and lower halves of a 64 bits register, for %08x%08x */
+#define HIGH(reg)               ((uint32_t) ((reg) >> 32))
+#define LOW(reg)                ((uint32_t) (reg))
+#endif
+
+void trap_dispatch(struct trap_frame *frame)
+{
+        const char *name;
+        unsigned long address = 0;
+
+        if (frame->vector == TRAP_PAGE_FAULT) {
+                address = read_cr2();
+                if (paging_fault(address, frame->error)) {
+                        return;
+                }
+        }
+
+        name = (trap_names[frame->vector] != NULL) ? trap_names[frame->vector] : "reserved";
+#ifdef __x86_64__
+        panic("trap: %s at %08x%08x, error %x, address %08x%08x\n"
+              "rax %08x%08x rbx %08x%08x rcx %08x%08x rdx %08x%08x\n"
+              "rsi %08x%08x rdi %08x%08x rbp %08x%08x rsp %08x%08x\n"
+              "rflags %08x",
+              name, HIGH(frame->rip), LOW(frame->rip), (uint32_t) frame->error,
+              HIGH(address), LOW(address),
+              HIGH(frame->rax), LOW(frame->rax), HIGH(frame->rbx), LOW(frame->rbx),
+              HIGH(frame->rcx), LOW(frame->rcx), HIGH(frame->rdx), LOW(frame->rdx),
+              HIGH(frame->rsi), LOW(frame->rsi), HIGH(frame->rdi), LOW(frame->rdi),
+              HIGH(frame->rbp), LOW(frame->rbp), HIGH(frame->rsp), LOW(frame->rsp),
+              (uint32_t) frame->rflags);
+#else
+        panic("trap: %s at %08x, error %x, address %08x\n"
+              "eax %08x ebx %08x ecx %08x edx %08x\n"
+              "esi %08x edi %08x ebp %08x eflags %08x",
+              name, frame->eip, frame->error, (uint32_t) address,
+              frame->eax, frame->ebx, frame->ecx, frame->edx,
+              frame->esi, frame->edi, frame->ebp, frame->eflags);
+#endif
+}
@@ -0,0 +1,100 @@
+/*
+ * traps.h
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Processor exceptions. Each one has a stub in trap_entries.S of the
+ * architecture that saves the registers and calls trap_dispatch(). Page
+ * faults are given to the paging code, the other exceptions are fatal.
+ */
+
+#ifndef _TRAPS_H_
+#define _TRAPS_H_
+
+/** Exception vectors */
+#define TRAP_COUNT          32
+#define TRAP_PAGE_FAULT     14
+
+/** Size of each stub in trap_entries.S */
+#define TRAP_ENTRY_SIZE     16
+
+#ifndef __ASSEMBLER__
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __x86_64__
+/**
+ * Registers of the interrupted code, as the stubs push them: the general
+ * purpose registers, the vector, the error code or 0, then what the
+ * processor saved, stack included.
+ */
+struct trap_frame {
+        uint64_t r15;
+        uint64_t r14;
+        uint64_t r13;
+        uint64_t r12;
+        uint64_t r11;
+        uint64_t r10;
+        uint64_t r9;
+        uint64_t r8;
+        uint64_t rbp;
+        uint64_t rdi;
+        uint64_t rsi;
+        uint64_t rdx;
+        uint64_t rcx;
+        uint64_t rbx;
+        uint64_t rax;
+        uint64_t vector;
+        uint64_t error;
+        uint64_t rip;
+        uint64_t cs;
+        uint64_t rflags;
+        uint64_t rsp;
+        uint64_t ss;
+};
+#else
+/**
+ * Registers of the interrupted code, as the stubs push them: pushal, the
+ * vector, the error code or 0, then what the processor saved.
+ */
+struct trap_frame {
+        uint32_t edi;
+        uint32_t esi;
+        uint32_t ebp;
+        uint32_t esp;
+        uint32_t ebx;
+        uint32_t edx;
+        uint32_t ecx;
+        uint32_t eax;
+        uint32_t vector;
+        uint32_t error;
+        uint32_t eip;
+        uint32_t cs;
+        uint32_t eflags;
+};
+#endif
+
+/**
+ * Load an IDT with the exception stubs. Interrupts stay disabled.
+ */
+void traps_setup(void);
+
+/**
+ * Handle an exception, called by the stubs.
+ *
+ * @param frame the registers of the interrupted code, restored when the
+ *        function returns
+ */
+void trap_dispatch(struct trap_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _TRAPS_H_ */
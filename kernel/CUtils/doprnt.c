@@ -180,7 +180,7 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 	unsigned long	u;
 	int		plus_sign;
 	int		sign_char;
-	unsigned char	altfmt, truncate;
+	unsigned char	altfmt, truncate, longfmt;
 	int		base;
 	char		c;
 #ifdef DOPRNT_FLOATS
@@ -262,8 +262,12 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		}
 	    }
 
-	    if (*fmt == 'l')
-		fmt++;	/* need it if sizeof(int) < sizeof(long) */
+	    /* Arguments are int sized unless %l: on x86_64 longs are wider */
+	    longfmt = FALSE;
+	    if (*fmt == 'l') {
+		longfmt = TRUE;
+		fmt++;
+	    }
 
 	    truncate = FALSE;
 #ifdef DOPRNT_FLOATS
@@ -473,7 +477,8 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 
 		case 'p':
 		    padc = '0';
-		    length = 8;
+		    length = 2 * sizeof(void *);
+		    longfmt = TRUE;
 		    /*
 		     * We do this instead of just setting altfmt to TRUE
 		     * because we want 0 to have a 0x in front, and we want
@@ -506,7 +511,7 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		    goto print_unsigned;
 
 		print_signed:
-		    n = va_arg(args, long);
+		    n = longfmt ? va_arg(args, long) : va_arg(args, int);
 		    if (n >= 0) {
 			u = n;
 			sign_char = plus_sign;
@@ -518,7 +523,7 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		    goto print_num;
 
 		print_unsigned:
-		    u = va_arg(args, unsigned long);
+		    u = longfmt ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
 		    goto print_num;
 
 		print_num:
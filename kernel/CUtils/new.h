@@ -0,0 +1,24 @@
+/*
+ * new.h
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * Placement new, to construct objects in memory we already own. Only for
+ * kernel code: never include it along with the C++ standard library.
+ */
+
+#ifndef _NEW_H_
+#define _NEW_H_
+
+#include "stddef.h"
+
+inline void *operator new(size_t, void *where)
+{
+        return where;
+}
+
+inline void operator delete(void *, void *)
+{
+}
+
+#endif
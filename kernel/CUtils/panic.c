@@ -35,7 +35,7 @@ void panic(const char *fmt, ...)
         printf("\nstack trace:\n");
         for (i = 0; i < max; ++i) {
                 addr = backtrace_buffer[i];
-                printf(" %3d: %08x\n", i, (uintptr_t) addr);
+                printf(" %3d: %08lx\n", i, (unsigned long) addr);
         }
 
         /* Stop here... */
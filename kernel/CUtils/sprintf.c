@@ -40,6 +40,7 @@
  * the rights to redistribute these changes.
  */
 
+#include "stddef.h"
 #include "stdarg.h"
 #include "doprnt.h"
 
@@ -79,7 +80,7 @@ int vsprintf(char *s, const char *fmt, va_list args)
 	return state.len;
 }
 
-int vsnprintf(char *s, unsigned int size, const char *fmt, va_list args)
+int vsnprintf(char *s, size_t size, const char *fmt, va_list args)
 {
 	struct sprintf_state state;
 	state.max = size;
@@ -104,7 +105,7 @@ int sprintf(char *s, const char *fmt, ...)
 	return err;
 }
 
-int snprintf(char *s, unsigned int size, const char *fmt, ...)
+int snprintf(char *s, size_t size, const char *fmt, ...)
 {
 	va_list	args;
 	int err;
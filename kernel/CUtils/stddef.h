@@ -21,9 +21,10 @@
 
 
 /**
- * Standard size type.
+ * Standard size type, the one the compiler expects for sizeof: 32 bits
+ * wide on x86, 64 bits wide on x86_64.
  */
-typedef unsigned int size_t;
+typedef __SIZE_TYPE__ size_t;
 
 /**
  * Offset of a field in it's structure.
@@ -23,6 +23,15 @@
 #ifndef _STDINT_H
 #define _STDINT_H	1
 
+/* Word size of the target, <bits/wordsize.h> of the GNU C Library.  */
+#ifndef __WORDSIZE
+# ifdef __x86_64__
+#  define __WORDSIZE	64
+# else
+#  define __WORDSIZE	32
+# endif
+#endif
+
 /* Exact integral types.  */
 
 /* Signed.  */
@@ -15,13 +15,14 @@ extern "C" {
 #endif
 
 #include "stdarg.h"
+#include "stddef.h"
 
 int printf(const char *__format, ...) __attribute__((format (printf, 1, 2)));
 int vprintf(const char *__format, va_list __vl) __attribute__((format (printf, 1, 0)));
 int sprintf(char *__dest, const char *__format, ...) __attribute__((format (printf, 2, 3)));
-int snprintf(char *__dest, unsigned int __size, const char *__format, ...) __attribute__((format (printf, 3, 4)));
+int snprintf(char *__dest, size_t __size, const char *__format, ...) __attribute__((format (printf, 3, 4)));
 int vsprintf(char *__dest, const char *__format, va_list __vl) __attribute__((format (printf, 2, 0)));
-int vsnprintf(char *__dest, unsigned int __size, const char *__format, va_list __vl) __attribute__((format (printf, 3, 0)));
+int vsnprintf(char *__dest, size_t __size, const char *__format, va_list __vl) __attribute__((format (printf, 3, 0)));
 
 #ifdef __cplusplus
 }
@@ -20,6 +20,7 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 void *memccpy(void *dst, const void *src, int c, size_t n)
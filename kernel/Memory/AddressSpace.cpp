@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * AddressSpace.cpp: address space implementation. A directory entry maps
+ * either a large page or a page table of 4 kB pages. Rights are given by
+ * the page table entries: directory entries of page tables allow
+ * everything.
+ *
+ * New mappings need no TLB flush, the processor does not cache absent
+ * entries. Unmapped pages are flushed one by one when the address space
+ * is the current one, global pages included.
+ *
+ * Through the self map, the table of an address is found without reading
+ * its directory entry: the processor walks the directory for us, and the
+ * TLB keeps the translation of the tables in use. The self map page of a
+ * table is flushed when the table is created: an earlier table of the same
+ * directory entry may still be in the TLB.
+ *
+ * With PAE, directory pointers only have a present bit. They are set once
+ * for good: the processor reads them when CR3 is loaded, not on each walk.
+ */
+
+#include "assert.h"
+#include "string.h"
+#include "new.h"
+#include "Boot/bootstrap.h"
+#include "AddressSpace.h"
+
+/** Directory entry of a page table */
+#define PAGE_TABLE_FLAGS    (PAGE_PRESENT | PAGE_WRITE | PAGE_USER)
+
+/** Index of an address in the directory, and in its page table */
+#define DIRECTORY_INDEX(address)    ((address) >> PAGE_LARGE_POWER)
+#define TABLE_INDEX(address)        (((address) >> PAGE_FRAME_POWER) & (PAGE_TABLE_ENTRIES - 1))
+
+/* False singleton implementation */
+AddressSpace *AddressSpace::mKernel = (AddressSpace*) NULL;
+AddressSpace *AddressSpace::mCurrent = (AddressSpace*) NULL;
+static void *instance[(sizeof(AddressSpace) + sizeof(void*) - 1) / sizeof(void*)]
+    __attribute__((aligned(__alignof__(AddressSpace))));
+
+
+AddressSpace::AddressSpace(page_entry_t *directory, uint32_t directoryAddress, char *window,
+                           PageFrameAllocator *frames, uint32_t features):
+    mDirectory(directory),
+    mDirectoryAddress(directoryAddress),
+    mWindow(window),
+    mFrames(frames),
+    mFeatures(features & (PAGE_LARGE | PAGE_GLOBAL)),
+    mSelfMapped(false)
+{
+#ifdef PAGING_PAE
+    int i;
+#endif
+
+    assert(directory != NULL && (directoryAddress & ~PAGE_ADDRESS_MASK) == 0);
+
+#ifdef PAGING_PAE
+    for (i = 0; i < PAGE_DIRECTORIES; i++) {
+        mPointers[i] = (directoryAddress + i * PAGE_FRAME_SIZE) | PAGE_PRESENT;
+    }
+#endif
+}
+
+
+page_entry_t *AddressSpace::tableOf(uint32_t address)
+{
+    page_entry_t entry = mDirectory[DIRECTORY_INDEX(address)];
+
+    assert((entry & (PAGE_PRESENT | PAGE_LARGE)) == PAGE_PRESENT);
+    if (mSelfMapped && mCurrent == this) {
+        return PAGE_TABLE_ENTRY(address & ~(PAGE_LARGE_SIZE - 1));
+    }
+    assert((entry & PAGE_ADDRESS_MASK) < PAGE_ZONE_NORMAL_END);
+    return (page_entry_t*) (mWindow + (entry & PAGE_ADDRESS_MASK));
+}
+
+page_entry_t *AddressSpace::pageTable(uint32_t address, bool create)
+{
+    page_entry_t *entry = &mDirectory[DIRECTORY_INDEX(address)];
+    PageFrameAllocator *frames;
+    page_entry_t *table;
+    uint64_t frame;
+
+    if (*entry & PAGE_PRESENT) {
+        return tableOf(address);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    /* Page tables live as long as their mappings, out of the window if they can */
+    frames = (mFrames != NULL) ? mFrames : PageFrameAllocator::getInstance();
+    assert(frames != NULL);
+    frame = frames->allocPages(0, (mSelfMapped && mCurrent == this) ? PAGE_ZONE_HIGH : PAGE_ZONE_NORMAL,
+                               PAGE_LIFETIME_PINNED);
+    if (frame == 0) {
+        return NULL;
+    }
+
+    *entry = (page_entry_t) frame | PAGE_TABLE_FLAGS;
+    table = tableOf(address);
+    if (mSelfMapped) {
+        invalidate((uint32_t) (uintptr_t) table);
+    }
+    memset(table, 0, PAGE_FRAME_SIZE);
+    return table;
+}
+
+void AddressSpace::releasePageTable(uint32_t address)
+{
+    page_entry_t *entry = &mDirectory[DIRECTORY_INDEX(address)];
+    page_entry_t *table = pageTable(address, false);
+    PageFrameAllocator *frames;
+    uint64_t frame;
+    int i;
+
+    if (table == NULL) {
+        return;
+    }
+    for (i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        if (table[i] != 0) {
+            return;
+        }
+    }
+
+    /* No translation goes through the table once its entry is flushed */
+    frame = *entry & PAGE_ADDRESS_MASK;
+    *entry = 0;
+    invalidate(address);
+    frames = (mFrames != NULL) ? mFrames : PageFrameAllocator::getInstance();
+    frames->freePages(frame, 0);
+}
+
+void AddressSpace::invalidate(uint32_t address)
+{
+    if (mCurrent == this) {
+        invlpg(address);
+    }
+}
+
+
+int AddressSpace::map(uint32_t address, uint64_t physical, uint32_t length, uint32_t flags)
+{
+    page_entry_t *table;
+    page_entry_t *entry;
+    uint32_t mapped;
+
+    assert(((address | physical | length) & ~PAGE_ADDRESS_MASK) == 0);
+    assert(physical + length <= PAGE_FRAME_LIMIT);
+    assert(length == 0 || address + (length - 1) >= address);
+    assert(length == 0 || !mSelfMapped || DIRECTORY_INDEX(address + (length - 1)) < PAGE_SELF_MAP_INDEX);
+
+    flags &= (PAGE_WRITE | PAGE_USER | mFeatures) & ~PAGE_LARGE;
+    flags |= PAGE_PRESENT;
+
+    for (mapped = 0; mapped < length; ) {
+        /* A whole directory entry when both sides are aligned */
+        if ((mFeatures & PAGE_LARGE)
+            && ((address + mapped) & (PAGE_LARGE_SIZE - 1)) == 0
+            && ((physical + mapped) & (PAGE_LARGE_SIZE - 1)) == 0
+            && length - mapped >= PAGE_LARGE_SIZE) {
+            entry = &mDirectory[DIRECTORY_INDEX(address + mapped)];
+            assert((*entry & PAGE_PRESENT) == 0);
+            *entry = (page_entry_t) (physical + mapped) | flags | PAGE_LARGE;
+            mapped += PAGE_LARGE_SIZE;
+            continue;
+        }
+
+        table = pageTable(address + mapped, true);
+        if (table == NULL) {
+            unmap(address, mapped);
+            return -1;
+        }
+        entry = &table[TABLE_INDEX(address + mapped)];
+        assert((*entry & PAGE_PRESENT) == 0);
+        *entry = (page_entry_t) (physical + mapped) | flags;
+        mapped += PAGE_FRAME_SIZE;
+    }
+    return 0;
+}
+
+void AddressSpace::unmap(uint32_t address, uint32_t length)
+{
+    page_entry_t *table;
+    page_entry_t *entry;
+    uint32_t current, step;
+    uint32_t unmapped;
+
+    assert(((address | length) & ~PAGE_ADDRESS_MASK) == 0);
+    assert(length == 0 || address + (length - 1) >= address);
+
+    for (unmapped = 0; unmapped < length; unmapped += step) {
+        current = address + unmapped;
+        entry = &mDirectory[DIRECTORY_INDEX(current)];
+
+        /* Nothing mapped up to the next directory entry */
+        if ((*entry & PAGE_PRESENT) == 0) {
+            step = PAGE_LARGE_SIZE - (current & (PAGE_LARGE_SIZE - 1));
+            continue;
+        }
+
+        if (*entry & PAGE_LARGE) {
+            assert((current & (PAGE_LARGE_SIZE - 1)) == 0 && length - unmapped >= PAGE_LARGE_SIZE);
+            *entry = 0;
+            invalidate(current);
+            step = PAGE_LARGE_SIZE;
+            continue;
+        }
+
+        table = pageTable(current, false);
+        table[TABLE_INDEX(current)] = 0;
+        invalidate(current);
+        step = PAGE_FRAME_SIZE;
+
+        /* Done with this page table */
+        if (TABLE_INDEX(current) == PAGE_TABLE_ENTRIES - 1 || unmapped + step >= length) {
+            releasePageTable(current);
+        }
+    }
+}
+
+bool AddressSpace::translate(uint32_t address, uint64_t *physical)
+{
+    page_entry_t entry = mDirectory[DIRECTORY_INDEX(address)];
+    page_entry_t *table;
+
+    if ((entry & PAGE_PRESENT) == 0) {
+        return false;
+    }
+    if (entry & PAGE_LARGE) {
+        *physical = (entry & PAGE_ADDRESS_MASK & ~(page_entry_t) (PAGE_LARGE_SIZE - 1))
+                    | (address & (PAGE_LARGE_SIZE - 1));
+        return true;
+    }
+
+    table = pageTable(address, false);
+    entry = table[TABLE_INDEX(address)];
+    if ((entry & PAGE_PRESENT) == 0) {
+        return false;
+    }
+    *physical = (entry & PAGE_ADDRESS_MASK) | (address & ~PAGE_ADDRESS_MASK);
+    return true;
+}
+
+
+page_entry_t *AddressSpace::fixedEntry(uint32_t address)
+{
+    page_entry_t *table = pageTable(address, true);
+
+    assert(!mSelfMapped || DIRECTORY_INDEX(address) < PAGE_SELF_MAP_INDEX);
+    return (table != NULL) ? &table[TABLE_INDEX(address)] : NULL;
+}
+
+void AddressSpace::selfMap(void)
+{
+    int i;
+
+    /* Not global: each address space has its own */
+    for (i = 0; i < PAGE_DIRECTORIES; i++) {
+        assert((mDirectory[PAGE_SELF_MAP_INDEX + i] & PAGE_PRESENT) == 0);
+        mDirectory[PAGE_SELF_MAP_INDEX + i] = (mDirectoryAddress + i * PAGE_FRAME_SIZE)
+                                              | PAGE_PRESENT | PAGE_WRITE;
+    }
+    mSelfMapped = true;
+}
+
+char *AddressSpace::window(void)
+{
+    return mWindow;
+}
+
+void AddressSpace::load(void)
+{
+#ifdef PAGING_PAE
+    /* The pointers are reached through the window, like the directories */
+    write_cr3((uint32_t) ((char*) mPointers - mWindow));
+#else
+    write_cr3(mDirectoryAddress);
+#endif
+    mCurrent = this;
+}
+
+
+AddressSpace *AddressSpace::setup(page_entry_t *directory, uint32_t features)
+{
+    mKernel = new (instance) AddressSpace(directory, (uintptr_t) directory - KERNEL_BASE,
+                                          (char*) KERNEL_BASE, NULL, features);
+    mKernel->selfMap();
+#ifdef PAGING_PAE
+    /* Same directories as the boot pointers of crt0.S */
+    mKernel->load();
+#else
+    mCurrent = mKernel;
+#endif
+    return mKernel;
+}
+
+AddressSpace *AddressSpace::getInstance(void)
+{
+    return mKernel;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * AddressSpace.h: virtual address space, a two level x86 page directory.
+ * Ranges are mapped with large pages wherever their addresses and length
+ * allow it, with 4 kB pages elsewhere. The last directory entries can map
+ * the directory itself, so that the entries of the current address space
+ * are at fixed virtual addresses.
+ *
+ * Built with PAGING_PAE, entries are 64 bits wide and reach 64 GB of
+ * physical memory. Large pages are 2 MB, and four directories of 512
+ * entries, one per GB, follow each other: with the directory pointers
+ * table on top, they are used as a single directory of 2048 entries.
+ */
+
+#ifndef _ADDRESS_SPACE_H_
+#define _ADDRESS_SPACE_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "Boot/cpu.h"
+#include "PageFrameAllocator.h"
+
+#ifdef PAGING_PAE
+
+/** Page directory or page table entry */
+typedef uint64_t page_entry_t;
+
+/** Size of a large page: 2^PAGE_LARGE_POWER bytes, a page directory entry */
+#define PAGE_LARGE_POWER    21
+
+/** Entries of a page table, and count of page directories */
+#define PAGE_TABLE_ENTRIES  512
+#define PAGE_DIRECTORIES    4
+
+/** Physical address in an entry */
+#define PAGE_ADDRESS_MASK   0x000FFFFFFFFFF000ull
+
+#else
+
+typedef uint32_t page_entry_t;
+#define PAGE_LARGE_POWER    22
+#define PAGE_TABLE_ENTRIES  1024
+#define PAGE_DIRECTORIES    1
+#define PAGE_ADDRESS_MASK   0xFFFFF000u
+
+#endif /* PAGING_PAE */
+
+#define PAGE_LARGE_SIZE     (1u << PAGE_LARGE_POWER)
+
+/** Entries of all the page directories */
+#define PAGE_DIRECTORY_ENTRIES  (PAGE_DIRECTORIES * PAGE_TABLE_ENTRIES)
+
+/**
+ * Self map: the last directory entries point to the directories. Through
+ * them, the page tables are an array of entries at PAGE_SELF_MAP, up to the
+ * end of the address space, and the directories are the last pages of this
+ * array.
+ */
+#define PAGE_SELF_MAP_INDEX (PAGE_DIRECTORY_ENTRIES - PAGE_DIRECTORIES)
+#define PAGE_SELF_MAP       ((uint32_t) PAGE_SELF_MAP_INDEX << PAGE_LARGE_POWER)
+#define PAGE_SELF_DIRECTORY (PAGE_SELF_MAP + (PAGE_SELF_MAP >> PAGE_FRAME_POWER) * sizeof(page_entry_t))
+
+/** Entry translating an address in the current self mapped address space */
+#define PAGE_TABLE_ENTRY(address)       ((page_entry_t*) PAGE_SELF_MAP + ((address) >> PAGE_FRAME_POWER))
+#define PAGE_DIRECTORY_ENTRY(address)   ((page_entry_t*) PAGE_SELF_DIRECTORY + ((address) >> PAGE_LARGE_POWER))
+
+/**
+ * Address space of 32 bits virtual addresses. Page tables are page frames,
+ * reached through the window where physical memory is mapped: they are
+ * taken from the normal zone.
+ *
+ * Once self mapped, the tables of the address space are reached through
+ * the self map while it is the current one: they can be taken from any
+ * zone, and the address space must be current to be changed if some are
+ * out of the window.
+ */
+class AddressSpace {
+    private:
+        /** Singleton implementation: the kernel address space */
+        static AddressSpace *mKernel;
+
+        /** The address space in CR3: its changes are flushed from the TLB */
+        static AddressSpace *mCurrent;
+
+        /** Page directory, and its physical address */
+        page_entry_t *mDirectory;
+        uint32_t mDirectoryAddress;
+
+#ifdef PAGING_PAE
+        /** Page directory pointers, loaded in CR3: the directories in order */
+        uint64_t mPointers[PAGE_DIRECTORIES] __attribute__((aligned(32)));
+#endif
+
+        /** Where physical memory is mapped */
+        char *mWindow;
+
+        /** Allocator of the page tables, NULL for the kernel one */
+        PageFrameAllocator *mFrames;
+
+        /** Entry bits the processor supports, among PAGE_LARGE and PAGE_GLOBAL */
+        uint32_t mFeatures;
+
+        /** The last directory entries map the directory */
+        bool mSelfMapped;
+
+        /**
+         * Get the page table a present directory entry points to.
+         * @param address a virtual address the table covers
+         */
+        page_entry_t *tableOf(uint32_t address);
+
+        /**
+         * Get the page table covering an address.
+         * @param address the virtual address
+         * @param create allocate the table if there is none
+         * @return the table, NULL if there is none or no frame for it
+         */
+        page_entry_t *pageTable(uint32_t address, bool create);
+
+        /** Give the page table covering an address back if it is empty */
+        void releasePageTable(uint32_t address);
+
+    public:
+        /**
+         * Create an address space on a page directory, with its current
+         * entries.
+         * @param directory the page directory, through the window: the
+         *                  PAGE_DIRECTORIES pages of the directories
+         * @param directoryAddress its physical address, below 4 GB
+         * @param window where physical memory is mapped, KERNEL_BASE
+         * @param frames the allocator of the page tables, NULL for the one
+         *               built by PageFrameAllocator::setup()
+         * @param features the entry bits the processor supports, among
+         *                 PAGE_LARGE and PAGE_GLOBAL
+         */
+        AddressSpace(page_entry_t *directory, uint32_t directoryAddress, char *window,
+                     PageFrameAllocator *frames, uint32_t features);
+
+        /**
+         * Map a physical range. Large pages are used where both addresses
+         * are aligned on PAGE_LARGE_SIZE and a large page remains to map.
+         * Nothing may be mapped in the range yet.
+         * @param address the virtual address, page aligned
+         * @param physical the physical address, page aligned
+         * @param length the length of the range, whole pages
+         * @param flags PAGE_WRITE, PAGE_USER and PAGE_GLOBAL, the last one
+         *              is dropped if the processor ignores it
+         * @return 0, -1 if there was no frame left for a page table: the
+         *         range is left unmapped
+         */
+        int map(uint32_t address, uint64_t physical, uint32_t length, uint32_t flags);
+
+        /**
+         * Unmap a range, mapped or not, and give empty page tables back.
+         * Large pages must be unmapped whole.
+         * @param address the virtual address, page aligned
+         * @param length the length of the range, whole pages
+         */
+        void unmap(uint32_t address, uint32_t length);
+
+        /**
+         * Translate a virtual address.
+         * @param address the virtual address
+         * @param physical where to store the physical address
+         * @return true if the address is mapped
+         */
+        bool translate(uint32_t address, uint64_t *physical);
+
+        /**
+         * Get the entry of a 4 kB page, for mappings changed too often to
+         * go through map() and unmap(). The page table is created if
+         * needed, and never given back: the range must not be unmapped.
+         * @param address the virtual address
+         * @return the entry, NULL if there was no frame for the table
+         */
+        page_entry_t *fixedEntry(uint32_t address);
+
+        /**
+         * Drop the TLB entry of an address if this is the current address
+         * space, once its entry changed.
+         */
+        void invalidate(uint32_t address);
+
+        /** Where physical memory is mapped, to reach the frames of the normal zone */
+        char *window(void);
+
+        /**
+         * Point the last PAGE_DIRECTORIES directory entries to the
+         * directories. Nothing may be mapped from PAGE_SELF_MAP.
+         */
+        void selfMap(void);
+
+        /** Make this address space the current one */
+        void load(void);
+
+        /**
+         * Build the kernel address space on the page directory crt0.S
+         * loaded, mapped at KERNEL_BASE like all the normal zone, and self
+         * map it.
+         * @param directory the page directory
+         * @param features the entry bits the processor supports
+         * @return the address space, also available with getInstance()
+         */
+        static AddressSpace *setup(page_entry_t *directory, uint32_t features);
+
+        /**
+         * Singleton implementation: the kernel address space built by
+         * setup(), NULL before.
+         */
+        static AddressSpace *getInstance(void);
+};
+
+#endif /* _ADDRESS_SPACE_H_ */
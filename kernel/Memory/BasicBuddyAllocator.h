@@ -0,0 +1,1035 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * BasicBuddyAllocator.h: buddy allocator implementation, as a template on
+ * its smallest and largest block powers.
+ * by Damien Dejean <djod4556@yahoo.fr>
+ *
+ * Free areas are doubly linked circular lists, so any free block can be
+ * unlinked in constant time. A block map with one byte per minimum sized
+ * block records the power of two of every block, allocated or free, at the
+ * address it begins. Finding out if a buddy is free and taking it out of its
+ * free area is then O(1) at every level, and a chunk can be freed without
+ * knowing its size.
+ *
+ * A summary word keeps one bit per non empty free area, so the first fitting
+ * area is found with a single bit scan whatever the number of orders.
+ *
+ * The heap does not need to be one power of two: regions of any size are
+ * carved into aligned power of two blocks of the arena. The holes between
+ * regions are never free, so blocks never merge across them.
+ *
+ * Memory is zeroed lazily. A clean free block is all zero but its links,
+ * a dirty one holds garbage. Clean blocks are queued at the tail of their
+ * free area and dirty ones at the head: alloc() takes the head, allocZeroed()
+ * the tail, and only has to clear the links when the block is clean.
+ *
+ * allocAligned() hands out chunks that are not a power of two: the block
+ * that fits both the size and the alignment is taken, and the part past
+ * the last minimum sized block of the chunk is given back. The chunk is then
+ * a run of blocks of decreasing sizes, all but the last flagged as followed
+ * by another block of the same chunk. Blocks are aligned on their size
+ * relative to the heap base only: a heap handing out aligned chunks must
+ * itself be aligned on the largest alignment asked for, and limits are
+ * addresses of the heap mapping, not physical ones.
+ *
+ * In lazy coalescing mode, a few freed blocks per order are kept in their
+ * free area without looking for their buddy: the next allocation of the
+ * same size takes them back without splitting. They are merged when an
+ * allocation finds no fitting block, when free memory falls under a
+ * watermark, and before scrubbing.
+ *
+ * When the arena size is a template parameter, the free area table is a
+ * member and every bound on the block powers is a constant: the arena
+ * checks and the merge loop fold to immediate compares. With
+ * BUDDY_RUNTIME_POWER the arena size is given to the constructor, this is
+ * BuddyAllocator.
+ */
+
+#ifndef _BASIC_BUDDY_ALLOCATOR_H_
+#define _BASIC_BUDDY_ALLOCATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stdio.h"
+#include "string.h"
+#include "assert.h"
+#include "Boot/cpu.h"
+
+/* Most powers of two of a block: arena offsets are 32 bits wide */
+#define BUDDY_MAX_POWER         32
+
+/* Arena size given at construction instead of as a template parameter */
+#define BUDDY_RUNTIME_POWER     0
+
+/*
+ * Free block: self contained links to its neighbours in the free area.
+ * Free areas heads are sentinels of circular lists.
+ */
+struct freeblock {
+        struct freeblock *next;
+        struct freeblock *prev;
+};
+
+/*
+ * Allocator statistics. Per block counters are indexed by the power of two
+ * of the blocks, entries below the smallest block power stay null.
+ */
+struct buddy_stats {
+        uint32_t allocs[BUDDY_MAX_POWER];       /* Blocks handed out */
+        uint32_t frees[BUDDY_MAX_POWER];        /* Blocks given back */
+        uint32_t splits[BUDDY_MAX_POWER];       /* Blocks split in two buddies */
+        uint32_t merges[BUDDY_MAX_POWER];       /* Blocks made of two free buddies */
+        uint32_t freeBlocks[BUDDY_MAX_POWER];   /* Blocks in the free areas */
+        uint32_t usedBytes;                     /* Size of the allocated blocks */
+        uint32_t highWater;                     /* Highest usedBytes so far */
+        uint32_t failedAllocs;                  /* Requests no free block could serve */
+        uint32_t deferredFrees;                 /* Blocks freed without merging */
+        uint32_t coalesceRuns;                  /* Merges of the deferred blocks */
+        uint32_t zeroedBytes;                   /* Cleared by allocZeroed and scrub */
+};
+
+/*
+ * Block map entry flags: the block is in a free area, its content is zero,
+ * it was not merged with its buddy. An allocated block can't be lazy, the
+ * same bit tells the next block belongs to the same chunk.
+ */
+#define BUDDY_BLOCK_FREE        0x80u
+#define BUDDY_BLOCK_CLEAN       0x40u
+#define BUDDY_BLOCK_LAZY        0x20u
+#define BUDDY_BLOCK_RUN         0x20u
+#define BUDDY_BLOCK_POWER       0x1Fu
+
+#ifdef BUDDY_TRACE
+/* Record an operation in the trace ring, the size is 0 for a free */
+void buddy_trace_record(void *address, size_t size);
+#define BUDDY_TRACE_ALLOC(chunk, size)  buddy_trace_record((chunk), (size))
+#define BUDDY_TRACE_FREE(chunk)         buddy_trace_record((chunk), 0)
+#else
+#define BUDDY_TRACE_ALLOC(chunk, size)
+#define BUDDY_TRACE_FREE(chunk)
+#endif
+
+/*
+ * Free area table: a member when its size is known at compile time.
+ */
+template <uint32_t MaxPower>
+struct buddy_free_areas {
+        struct freeblock table[MaxPower];
+
+        void setup(struct freeblock *freeAreas, uint32_t capacities)
+        {
+                (void) freeAreas;
+                assert(capacities == MaxPower);
+        }
+        struct freeblock *areas(void) { return table; }
+        uint32_t capacities(void) const { return MaxPower; }
+};
+
+/*
+ * Free area table provided at construction, for any arena size.
+ */
+template <>
+struct buddy_free_areas<BUDDY_RUNTIME_POWER> {
+        struct freeblock *table;
+        uint32_t count;
+
+        void setup(struct freeblock *freeAreas, uint32_t capacities)
+        {
+                table = freeAreas;
+                count = capacities;
+        }
+        struct freeblock *areas(void) { return table; }
+        uint32_t capacities(void) const { return count; }
+};
+
+
+template <uint32_t MinPower, uint32_t MaxPower>
+class BasicBuddyAllocator {
+        private:
+                /* Free area management, 2^power blocks in entry power-1 */
+                buddy_free_areas<MaxPower> mFreeAreas;
+
+                /* Summary of non empty free areas: bit (power-1) for 2^power blocks */
+                uint32_t mFreeOrders;
+
+                /*
+                 * Block map: for each minimum sized block of the heap, the
+                 * power of two of the block beginning there and its state.
+                 * Zero if no block begins there.
+                 */
+                uint8_t *mBlockMap;
+
+                /*
+                 * Memory heap: the arena is the 2^capacities bytes from
+                 * mHeap, buddy addresses are relative to it. Only memory of
+                 * the added regions is ever handed out, mHeapSize bytes.
+                 */
+                char *mHeap;
+                uint32_t mHeapSize;
+
+                /* Statistics, a few increments on paths that already write the block map */
+                struct buddy_stats mStats;
+
+                /*
+                 * Lazy coalescing: count of unmerged free blocks per power,
+                 * their bound per power, 0 when the mode is off, and the
+                 * free memory under which blocks are merged again.
+                 */
+                uint16_t mLazyBlocks[BUDDY_MAX_POWER];
+                uint32_t mLazyTotal;
+                uint32_t mLazyLimit;
+                uint32_t mLazyWatermark;
+
+                /* Check an address is inside the arena */
+                inline bool inArena(void *address);
+
+                /* Find the address of my buddy chunk */
+                inline void *myBuddyAddress(void *me, size_t mySize);
+
+                /* Block map and free areas maintenance */
+                inline uint8_t *blockEntry(void *block);
+                inline bool isFreeBlock(void *block, uint32_t power);
+                inline void insertBlock(void *block, uint32_t power, bool clean);
+                inline void removeBlock(struct freeblock *block);
+
+                /* Give back a block, merging it with its free buddies */
+                void release(void *chunk, uint32_t power, bool clean);
+
+                /* Give back an allocated block, keeping it apart in lazy coalescing mode */
+                void freeBlock(void *chunk, uint32_t power);
+
+                /* Split a block taken out of its free area down to a smaller power */
+                inline void splitBlock(void *block, uint32_t power, uint32_t sizePower, bool clean);
+
+                /* Hand out a block: its map entry and the statistics */
+                inline void chargeBlock(void *block, uint32_t power, uint8_t flags);
+
+                /*
+                 * Find a free block of 2^power bytes or more whose first
+                 * length bytes end at or below limit, NULL for no limit.
+                 */
+                struct freeblock *findBlock(uint32_t power, size_t length, char *limit);
+
+                /* Take a block, telling if its content is zero but its links */
+                void *allocBlock(size_t size, bool preferClean, bool *clean);
+
+                /* Free memory, from the statistics */
+                inline uint32_t freeBytes(void);
+
+        protected:
+                /* Set up the allocator, for the constructors */
+                void setup(struct freeblock *freeAreas, uint32_t capacities,
+                           uint8_t *blockMap, char *heap, uint32_t heapSize, bool clean);
+
+                /* For derived classes that call setup() themselves */
+                BasicBuddyAllocator(void) {}
+
+        public:
+                /** Size in bytes of the block map needed by an arena of 2^MaxPower bytes */
+                static const uint32_t MAP_SIZE = (uint32_t) (((uint64_t) 1 << MaxPower) >> MinPower);
+
+                /**
+                 * Create an allocator of an arena of 2^MaxPower bytes.
+                 * @param blockMap the block map, MAP_SIZE bytes
+                 * @param heap the arena
+                 * @param heapSize the usable size from heap, may be 0
+                 * @param clean true if the heap is known to be zero
+                 */
+                BasicBuddyAllocator(uint8_t *blockMap, char *heap, uint32_t heapSize, bool clean = false)
+                {
+                        setup(NULL, MaxPower, blockMap, heap, heapSize, clean);
+                }
+
+                /**
+                 * Give a memory region to the allocator. It is split into the
+                 * largest aligned power of two blocks, they merge with free
+                 * buddies of previously added regions.
+                 * @param start the beginning of the region, inside the arena
+                 * @param length the size of the region, in bytes
+                 * @param clean true if the region is known to be zero, like
+                 *              BSS memory
+                 */
+                void addRegion(void *start, size_t length, bool clean = false);
+
+                /* Allocator implementation */
+                void *alloc(size_t size);
+                void free(void *chunk);
+
+                /**
+                 * Allocate a chunk filled with zeros. Memory is only cleared
+                 * if it may have been used.
+                 * @param size the size of the chunk
+                 * @return the chunk, NULL if there's no block big enough
+                 */
+                void *allocZeroed(size_t size);
+
+                /**
+                 * Allocate a chunk aligned on a power of two, for buffers
+                 * handed to devices. The chunk only keeps the minimum sized
+                 * blocks it covers, the end of its block is given back: a
+                 * 48 kB buffer takes 48 kB, not 64 kB. With a limit, the
+                 * free areas are walked until a block below it is found.
+                 * The heap base must be aligned on align: blocks are only
+                 * aligned relative to it.
+                 * @param size the size of the chunk
+                 * @param align the alignment of the chunk, a power of two
+                 * @param limit the address the chunk must end at or below,
+                 *              in the address space the heap is used from,
+                 *              NULL for anywhere in the heap. A physical
+                 *              bound is given through its mapping.
+                 * @return the chunk, NULL if no free block fits
+                 */
+                void *allocAligned(size_t size, size_t align, void *limit = NULL);
+
+                /**
+                 * Zero free blocks ahead of allocZeroed requests, for the
+                 * idle loop. Largest blocks are cleared first.
+                 * @param budget the count of bytes to zero, whole blocks are
+                 *               zeroed until it is reached
+                 * @return the count of bytes zeroed, 0 if all free blocks
+                 *         are clean
+                 */
+                size_t scrub(size_t budget);
+
+                /*
+                 * Free a chunk, checking that the provided size matches the
+                 * allocated one.
+                 */
+                void free(void *chunk, size_t size);
+
+                /**
+                 * Get the size of the blocks backing an allocated chunk.
+                 * @param chunk a chunk returned by alloc or allocAligned
+                 * @return the size of the blocks, 0 if chunk is not an allocated block
+                 */
+                size_t chunkSize(void *chunk);
+
+                /**
+                 * Find the allocated chunk an address belongs to.
+                 * @param address any address inside an allocated block
+                 * @return the chunk returned by alloc or allocAligned for
+                 *         this block, NULL if the address is not in an
+                 *         allocated block
+                 */
+                void *chunkOf(void *address);
+
+                /* Convenience */
+                uint32_t heapSize(void);
+                char *heapBase(void);
+
+                /**
+                 * Set the lazy coalescing mode up: up to blocksPerPower freed
+                 * blocks of each size are not merged with their buddy.
+                 * @param blocksPerPower the bound of unmerged blocks per
+                 *                       block size, 0 to merge on every free
+                 * @param watermark the free memory, in bytes, under which
+                 *                  blocks are merged again
+                 */
+                void setLazyCoalescing(uint32_t blocksPerPower, uint32_t watermark);
+
+                /**
+                 * Merge all the blocks freed without looking for their buddy.
+                 */
+                void coalesce(void);
+
+                /**
+                 * Copy the allocator statistics.
+                 * @param stats where to copy them
+                 */
+                void getStats(struct buddy_stats *stats);
+
+                /**
+                 * Tell how much of the free memory is too fragmented to serve
+                 * a block: the part of the free bytes in smaller blocks.
+                 * @param power the power of two of the block
+                 * @return a per mille index: 0 if all free memory is in large
+                 *         enough blocks, 1000 if none is or nothing is free
+                 */
+                uint32_t fragmentationIndex(uint32_t power);
+
+                /**
+                 * Print the statistics and the fragmentation index of every
+                 * block size on the console.
+                 */
+                void dumpStats(void);
+
+                /**
+                 * Compute the power of two of the block that serves a request.
+                 * @param size the requested size, not null
+                 * @return the power of two of the block size, at least MinPower,
+                 *         BUDDY_MAX_POWER + 1 when it does not fit in 32 bits
+                 */
+                static inline uint32_t powerFromSize(size_t size);
+};
+
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::setup(struct freeblock *freeAreas,
+                                                    uint32_t capacities,
+                                                    uint8_t *blockMap,
+                                                    char *heap,
+                                                    uint32_t heapSize,
+                                                    bool clean)
+{
+        struct freeblock *areas;
+        uint32_t i;
+
+        assert(sizeof(struct freeblock) <= (1u << MinPower));
+        assert(capacities >= MinPower && capacities < 32);
+        assert(heapSize <= (1u << capacities));
+
+        mFreeAreas.setup(freeAreas, capacities);
+        mFreeOrders = 0;
+        mBlockMap = blockMap;
+        mHeap = heap;
+
+        /* Empty all free areas */
+        areas = mFreeAreas.areas();
+        for(i = 0; i < capacities; i++) {
+                areas[i].next = &areas[i];
+                areas[i].prev = &areas[i];
+        }
+        memset(blockMap, 0, (1u << capacities) >> MinPower);
+        memset(&mStats, 0, sizeof(mStats));
+        memset(mLazyBlocks, 0, sizeof(mLazyBlocks));
+        mLazyTotal = 0;
+        mLazyLimit = 0;
+        mLazyWatermark = 0;
+
+        /* Declare all heap memory as free chunks */
+        mHeapSize = 0;
+        addRegion(heap, heapSize, clean);
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+uint32_t BasicBuddyAllocator<MinPower, MaxPower>::heapSize(void)
+{
+    return mHeapSize;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+char *BasicBuddyAllocator<MinPower, MaxPower>::heapBase(void)
+{
+    return mHeap;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+uint32_t BasicBuddyAllocator<MinPower, MaxPower>::powerFromSize(size_t n)
+{
+        if (n <= (1u << MinPower)) {
+                return MinPower;
+        }
+        /* Larger than any arena: above the capacities of every allocator */
+        if (((uint64_t) (n - 1) >> 32) != 0) {
+                return BUDDY_MAX_POWER + 1;
+        }
+        return bit_scan_reverse((uint32_t) (n - 1)) + 1;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+bool BasicBuddyAllocator<MinPower, MaxPower>::inArena(void *address)
+{
+        return (char*) address >= mHeap
+               && (uint64_t) ((char*) address - mHeap) < ((uint64_t) 1 << mFreeAreas.capacities());
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+uint8_t *BasicBuddyAllocator<MinPower, MaxPower>::blockEntry(void *block)
+{
+        return &mBlockMap[((char*) block - mHeap) >> MinPower];
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+bool BasicBuddyAllocator<MinPower, MaxPower>::isFreeBlock(void *block, uint32_t power)
+{
+        return (*blockEntry(block) & ~BUDDY_BLOCK_CLEAN) == (BUDDY_BLOCK_FREE | power);
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::insertBlock(void *block, uint32_t power, bool clean)
+{
+        struct freeblock *area = &mFreeAreas.areas()[power-1];
+        struct freeblock *fb = (struct freeblock*) block;
+
+        if (clean) {
+                /* Tail of the area */
+                fb->next = area;
+                fb->prev = area->prev;
+                area->prev->next = fb;
+                area->prev = fb;
+                *blockEntry(block) = BUDDY_BLOCK_FREE | BUDDY_BLOCK_CLEAN | power;
+        } else {
+                /* Head of the area */
+                fb->prev = area;
+                fb->next = area->next;
+                area->next->prev = fb;
+                area->next = fb;
+                *blockEntry(block) = BUDDY_BLOCK_FREE | power;
+        }
+
+        mFreeOrders |= (1u << (power - 1));
+        mStats.freeBlocks[power]++;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::removeBlock(struct freeblock *block)
+{
+        uint8_t *entry = blockEntry(block);
+
+        mStats.freeBlocks[*entry & BUDDY_BLOCK_POWER]--;
+        if ((*entry & BUDDY_BLOCK_LAZY) != 0) {
+                mLazyBlocks[*entry & BUDDY_BLOCK_POWER]--;
+                mLazyTotal--;
+        }
+        block->prev->next = block->next;
+        block->next->prev = block->prev;
+        if (block->next == block->prev) {
+                /* Only the sentinel is left */
+                mFreeOrders &= ~(1u << ((*entry & BUDDY_BLOCK_POWER) - 1));
+        }
+
+        *entry = 0;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::release(void *chunk, uint32_t power, bool clean)
+{
+        struct freeblock *matchingBuddy;
+        bool buddyClean;
+
+        /* Merge with the buddy as long as it is free */
+        while (power < mFreeAreas.capacities()) {
+                matchingBuddy = (struct freeblock *) myBuddyAddress(chunk, (size_t) 1 << power);
+                if (!isFreeBlock(matchingBuddy, power)) {
+                        break;
+                }
+                buddyClean = (*blockEntry(matchingBuddy) & BUDDY_BLOCK_CLEAN) != 0;
+                removeBlock(matchingBuddy);
+
+                /* The right buddy links end up inside the merged block */
+                if (clean && buddyClean) {
+                        memset((matchingBuddy < (struct freeblock*) chunk) ? chunk : (void*) matchingBuddy,
+                               0, sizeof(struct freeblock));
+                }
+                clean = clean && buddyClean;
+
+                /* Is it the left or the right buddy ? */
+                chunk = (matchingBuddy < (struct freeblock*) chunk) ? (void*) matchingBuddy : chunk;
+                power++;
+                mStats.merges[power]++;
+        }
+
+        /* Finally chain the buddy */
+        insertBlock(chunk, power, clean);
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::addRegion(void *start, size_t length, bool clean)
+{
+        uint32_t offset, end, i;
+        uint32_t power, sizePower;
+        uint8_t entry;
+
+        assert(inArena(start));
+        assert(length <= (1u << mFreeAreas.capacities()) - (uint32_t) ((char*) start - mHeap));
+
+        /* Only whole minimum sized blocks can be used */
+        offset = (uint32_t) ((char*) start - mHeap);
+        end = (offset + length) & ~((1u << MinPower) - 1);
+        offset = (offset + (1u << MinPower) - 1) & ~((1u << MinPower) - 1);
+
+        /*
+         * The region must not overlap blocks already known: none begins in
+         * it, and none of the blocks aligned below its start runs into it.
+         */
+        for (i = offset; i < end; i += 1u << MinPower) {
+                assert(*blockEntry(mHeap + i) == 0);
+        }
+        for (i = offset; i != 0; ) {
+                i &= i - 1;
+                entry = *blockEntry(mHeap + i);
+                assert(entry == 0 || i + (1u << (entry & BUDDY_BLOCK_POWER)) <= offset);
+        }
+
+        while (offset < end) {
+                /* Largest block aligned here that fits in the region */
+                power = (offset == 0) ? mFreeAreas.capacities() : bit_scan_forward(offset);
+                sizePower = bit_scan_reverse(end - offset);
+                power = (power < sizePower) ? power : sizePower;
+
+                /* Hand it over as a block being freed */
+                mHeapSize += 1u << power;
+                release(mHeap + offset, power, clean);
+
+                offset += 1u << power;
+        }
+}
+
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::splitBlock(void *block, uint32_t power,
+                                                         uint32_t sizePower, bool clean)
+{
+        /* Right buddies go back to the free areas */
+        while (power > sizePower) {
+                mStats.splits[power]++;
+                power--;
+                insertBlock((char*) block + (1u << power), power, clean);
+        }
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::chargeBlock(void *block, uint32_t power, uint8_t flags)
+{
+        *blockEntry(block) = flags | power;
+
+        mStats.allocs[power]++;
+        mStats.usedBytes += 1u << power;
+        if (mStats.usedBytes > mStats.highWater) {
+                mStats.highWater = mStats.usedBytes;
+        }
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+struct freeblock *BasicBuddyAllocator<MinPower, MaxPower>::findBlock(uint32_t power,
+                                                                     size_t length,
+                                                                     char *limit)
+{
+        struct freeblock *area;
+        struct freeblock *block;
+        uint32_t candidates;
+
+        candidates = mFreeOrders & ~((1u << (power - 1)) - 1);
+        if (limit == NULL) {
+                return (candidates == 0) ? NULL : mFreeAreas.areas()[bit_scan_forward(candidates)].next;
+        }
+
+        /* Smallest fitting blocks first, the chunk is carved at their beginning */
+        while (candidates != 0) {
+                area = &mFreeAreas.areas()[bit_scan_forward(candidates)];
+                for (block = area->next; block != area; block = block->next) {
+                        if ((char*) block < limit && (size_t) (limit - (char*) block) >= length) {
+                                return block;
+                        }
+                }
+                candidates &= candidates - 1;
+        }
+        return NULL;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void *BasicBuddyAllocator<MinPower, MaxPower>::allocBlock(size_t size, bool preferClean, bool *clean)
+{
+        uint32_t sizePower;
+        uint32_t power;
+        uint32_t candidates;
+        struct freeblock *freeArea;
+
+        if (size == 0) {
+                return NULL;
+        }
+
+        sizePower = powerFromSize(size);
+
+        /* Heap is too small */
+        if (sizePower > mFreeAreas.capacities()) {
+                mStats.failedAllocs++;
+                return NULL;
+        }
+
+        /* Look for the first fitting area, merge unmerged blocks if none */
+        candidates = mFreeOrders & ~((1u << (sizePower - 1)) - 1);
+        if (candidates == 0 && mLazyTotal > 0) {
+                coalesce();
+                candidates = mFreeOrders & ~((1u << (sizePower - 1)) - 1);
+        }
+        if (candidates == 0) {
+                mStats.failedAllocs++;
+                return NULL;
+        }
+        power = bit_scan_forward(candidates) + 1;
+
+        /* Get the free chunk: clean ones are at the tail */
+        freeArea = preferClean ? mFreeAreas.areas()[power-1].prev : mFreeAreas.areas()[power-1].next;
+        *clean = (*blockEntry(freeArea) & BUDDY_BLOCK_CLEAN) != 0;
+        removeBlock(freeArea);
+
+        splitBlock(freeArea, power, sizePower, *clean);
+        chargeBlock(freeArea, sizePower, 0);
+
+        /* Memory gets scarce: stop keeping blocks apart */
+        if (mLazyTotal > 0 && freeBytes() < mLazyWatermark) {
+                coalesce();
+        }
+
+        return freeArea;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void *BasicBuddyAllocator<MinPower, MaxPower>::alloc(size_t size)
+{
+        void *chunk;
+        bool clean;
+
+        chunk = allocBlock(size, false, &clean);
+        BUDDY_TRACE_ALLOC(chunk, size);
+        return chunk;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void *BasicBuddyAllocator<MinPower, MaxPower>::allocZeroed(size_t size)
+{
+        void *chunk;
+        size_t length;
+        bool clean;
+
+        chunk = allocBlock(size, true, &clean);
+        if (chunk != NULL) {
+                /* A clean block only has its links to clear */
+                length = (clean && size > sizeof(struct freeblock)) ? sizeof(struct freeblock) : size;
+                memset(chunk, 0, length);
+                mStats.zeroedBytes += length;
+        }
+        BUDDY_TRACE_ALLOC(chunk, size);
+        return chunk;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void *BasicBuddyAllocator<MinPower, MaxPower>::allocAligned(size_t size, size_t align, void *limit)
+{
+        struct freeblock *block;
+        char *chunk;
+        uint32_t power, blockPower;
+        size_t length;
+        bool clean;
+
+        assert(align != 0 && (align & (align - 1)) == 0);
+        if (size == 0) {
+                return NULL;
+        }
+
+        /* The block fits both the size and the alignment */
+        power = powerFromSize((size > align) ? size : align);
+        if (power > mFreeAreas.capacities()) {
+                mStats.failedAllocs++;
+                BUDDY_TRACE_ALLOC(NULL, size);
+                return NULL;
+        }
+        assert(((uintptr_t) mHeap & (align - 1)) == 0);
+        length = (size + (1u << MinPower) - 1) & ~(size_t) ((1u << MinPower) - 1);
+
+        block = findBlock(power, length, (char*) limit);
+        if (block == NULL && mLazyTotal > 0) {
+                coalesce();
+                block = findBlock(power, length, (char*) limit);
+        }
+        if (block == NULL) {
+                mStats.failedAllocs++;
+                BUDDY_TRACE_ALLOC(NULL, size);
+                return NULL;
+        }
+
+        blockPower = *blockEntry(block) & BUDDY_BLOCK_POWER;
+        clean = (*blockEntry(block) & BUDDY_BLOCK_CLEAN) != 0;
+        removeBlock(block);
+        splitBlock(block, blockPower, power, clean);
+
+        /*
+         * Keep the left halves the chunk fills, give back the right halves
+         * it does not reach: the chunk ends with the block holding its end.
+         */
+        chunk = (char*) block;
+        while (((size_t) 1 << power) != length) {
+                mStats.splits[power]++;
+                power--;
+                if (length > ((size_t) 1 << power)) {
+                        chargeBlock(chunk, power, BUDDY_BLOCK_RUN);
+                        chunk += (size_t) 1 << power;
+                        length -= (size_t) 1 << power;
+                } else {
+                        insertBlock(chunk + (1u << power), power, clean);
+                }
+        }
+        chargeBlock(chunk, power, 0);
+
+        /* Memory gets scarce: stop keeping blocks apart */
+        if (mLazyTotal > 0 && freeBytes() < mLazyWatermark) {
+                coalesce();
+        }
+
+        BUDDY_TRACE_ALLOC(block, size);
+        return block;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+size_t BasicBuddyAllocator<MinPower, MaxPower>::scrub(size_t budget)
+{
+        struct freeblock *area;
+        struct freeblock *block;
+        size_t zeroed = 0;
+        uint32_t power;
+
+        /* Blocks have to be merged to be scrubbed as clean blocks */
+        coalesce();
+
+        /* Largest blocks first, dirty blocks are at the head of the areas */
+        for (power = mFreeAreas.capacities(); power >= MinPower && zeroed < budget; power--) {
+                area = &mFreeAreas.areas()[power-1];
+                while (area->next != area && zeroed < budget) {
+                        block = area->next;
+                        if ((*blockEntry(block) & BUDDY_BLOCK_CLEAN) != 0) {
+                                break;
+                        }
+                        removeBlock(block);
+                        memset(block + 1, 0, ((size_t) 1 << power) - sizeof(struct freeblock));
+                        mStats.zeroedBytes += ((size_t) 1 << power) - sizeof(struct freeblock);
+                        insertBlock(block, power, true);
+                        zeroed += (size_t) 1 << power;
+                }
+        }
+        return zeroed;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void *BasicBuddyAllocator<MinPower, MaxPower>::myBuddyAddress(void *me, size_t mySize)
+{
+        return (void*) ((((uint64_t)me - (uint64_t)mHeap)^(uint64_t)mySize) + (uint64_t)mHeap);
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+size_t BasicBuddyAllocator<MinPower, MaxPower>::chunkSize(void *chunk)
+{
+        uint8_t entry;
+        size_t size = 0;
+
+        if (!inArena(chunk)) {
+                return 0;
+        }
+
+        entry = *blockEntry(chunk);
+        if (entry == 0 || (entry & BUDDY_BLOCK_FREE) != 0) {
+                return 0;
+        }
+
+        /* Blocks of a trimmed chunk follow each other */
+        size = (size_t) 1 << (entry & BUDDY_BLOCK_POWER);
+        while ((entry & BUDDY_BLOCK_RUN) != 0) {
+                entry = *blockEntry((char*) chunk + size);
+                size += (size_t) 1 << (entry & BUDDY_BLOCK_POWER);
+        }
+        return size;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void *BasicBuddyAllocator<MinPower, MaxPower>::chunkOf(void *address)
+{
+        uint32_t power;
+        uint32_t offset;
+        char *block;
+        char *previous;
+
+        if (!inArena(address)) {
+                return NULL;
+        }
+
+        /*
+         * Only block beginnings have a map entry: the first aligned address
+         * whose entry matches its alignment is the beginning of our block.
+         */
+        offset = (char*) address - mHeap;
+        for (power = MinPower; power <= mFreeAreas.capacities(); power++) {
+                block = mHeap + (offset & ~((1u << power) - 1));
+                if ((*blockEntry(block) & ~BUDDY_BLOCK_RUN) == power) {
+                        break;
+                }
+        }
+        if (power > mFreeAreas.capacities()) {
+                return NULL;
+        }
+
+        /*
+         * In a trimmed chunk, the previous block is larger, ends here and
+         * is flagged as followed by another one.
+         */
+        for (power++; power <= mFreeAreas.capacities(); power++) {
+                offset = (uint32_t) (block - mHeap);
+                if (offset >= (1u << power) && (offset & ((1u << power) - 1)) == 0) {
+                        previous = block - (1u << power);
+                        if (*blockEntry(previous) == (BUDDY_BLOCK_RUN | power)) {
+                                block = previous;
+                        }
+                }
+        }
+        return block;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::free(void *chunk, size_t size)
+{
+    size_t blocks;
+
+    if (chunk == NULL || size == 0) {
+        return;
+    }
+
+    /* Chunks from allocAligned only keep the minimum sized blocks they cover */
+    blocks = chunkSize(chunk);
+    assert(blocks == ((size_t) 1 << powerFromSize(size))
+           || blocks == ((size + (1u << MinPower) - 1) & ~(size_t) ((1u << MinPower) - 1)));
+    free(chunk);
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::free(void *chunk)
+{
+        uint8_t entry;
+
+        if (chunk == NULL) {
+                return;
+        }
+
+        assert(inArena(chunk));
+        BUDDY_TRACE_FREE(chunk);
+
+        /* Blocks of a trimmed chunk follow each other */
+        do {
+                entry = *blockEntry(chunk);
+                assert(entry != 0 && (entry & BUDDY_BLOCK_FREE) == 0);
+                freeBlock(chunk, entry & BUDDY_BLOCK_POWER);
+                chunk = (char*) chunk + (1u << (entry & BUDDY_BLOCK_POWER));
+        } while ((entry & BUDDY_BLOCK_RUN) != 0);
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::freeBlock(void *chunk, uint32_t power)
+{
+        uint8_t *entry;
+
+        entry = blockEntry(chunk);
+        *entry = 0;
+
+        mStats.frees[power]++;
+        mStats.usedBytes -= 1u << power;
+
+        /* Keep the block for the next allocation of its size if allowed */
+        if (mLazyBlocks[power] < mLazyLimit && power < mFreeAreas.capacities()
+            && freeBytes() >= mLazyWatermark) {
+                insertBlock(chunk, power, false);
+                *entry |= BUDDY_BLOCK_LAZY;
+                mLazyBlocks[power]++;
+                mLazyTotal++;
+                mStats.deferredFrees++;
+                return;
+        }
+
+        /* Freed memory is dirty */
+        release(chunk, power, false);
+}
+
+
+template <uint32_t MinPower, uint32_t MaxPower>
+uint32_t BasicBuddyAllocator<MinPower, MaxPower>::freeBytes(void)
+{
+        return mHeapSize - mStats.usedBytes;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::setLazyCoalescing(uint32_t blocksPerPower, uint32_t watermark)
+{
+        assert(blocksPerPower <= 0xFFFF);
+
+        mLazyLimit = blocksPerPower;
+        mLazyWatermark = watermark;
+        if (blocksPerPower == 0) {
+                coalesce();
+        }
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::coalesce(void)
+{
+        struct freeblock *area;
+        struct freeblock *block;
+        uint32_t power;
+
+        if (mLazyTotal == 0) {
+                return;
+        }
+        mStats.coalesceRuns++;
+
+        /* Smallest blocks first, merged blocks may meet larger unmerged ones */
+        for (power = MinPower; power < mFreeAreas.capacities() && mLazyTotal > 0; power++) {
+                area = &mFreeAreas.areas()[power-1];
+                while (mLazyBlocks[power] > 0) {
+                        /* Unmerged blocks are dirty, they are before clean ones */
+                        for (block = area->next; (*blockEntry(block) & BUDDY_BLOCK_LAZY) == 0;
+                             block = block->next) {
+                                assert(block != area);
+                        }
+                        removeBlock(block);
+                        release(block, power, false);
+                }
+        }
+}
+
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::getStats(struct buddy_stats *stats)
+{
+        assert(stats != NULL);
+        *stats = mStats;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+uint32_t BasicBuddyAllocator<MinPower, MaxPower>::fragmentationIndex(uint32_t power)
+{
+        uint32_t freeUnits = 0;
+        uint32_t unusable = 0;
+        uint32_t p;
+
+        /* Count in minimum sized blocks, the whole arena fits 32 bits */
+        for (p = MinPower; p <= mFreeAreas.capacities(); p++) {
+                freeUnits += mStats.freeBlocks[p] << (p - MinPower);
+                if (p < power) {
+                        unusable += mStats.freeBlocks[p] << (p - MinPower);
+                }
+        }
+
+        if (freeUnits == 0 || power > mFreeAreas.capacities()) {
+                return 1000;
+        }
+
+        /* Keep the per mille product in 32 bits, there is no 64 bits division */
+        while (freeUnits > 0xFFFFFFFFu / 1000) {
+                freeUnits >>= 1;
+                unusable >>= 1;
+        }
+        return unusable * 1000 / freeUnits;
+}
+
+template <uint32_t MinPower, uint32_t MaxPower>
+void BasicBuddyAllocator<MinPower, MaxPower>::dumpStats(void)
+{
+        uint32_t freeBytes = 0;
+        uint32_t power, index;
+
+        for (power = MinPower; power <= mFreeAreas.capacities(); power++) {
+                freeBytes += mStats.freeBlocks[power] << power;
+        }
+
+        printf("buddy: heap %u kB, used %u kB, high water %u kB, free %u kB, %u failed allocations, "
+               "%u kB zeroed\n",
+               mHeapSize / 1024, mStats.usedBytes / 1024, mStats.highWater / 1024,
+               freeBytes / 1024, mStats.failedAllocs, mStats.zeroedBytes / 1024);
+        printf("buddy: power free blocks     allocs      frees     splits     merges  frag\n");
+        for (power = MinPower; power <= mFreeAreas.capacities(); power++) {
+                index = fragmentationIndex(power);
+                printf("buddy: %5u %11u %10u %10u %10u %10u %u.%03u\n",
+                       power, mStats.freeBlocks[power], mStats.allocs[power],
+                       mStats.frees[power], mStats.splits[power], mStats.merges[power],
+                       index / 1000, index % 1000);
+        }
+}
+
+#endif /* _BASIC_BUDDY_ALLOCATOR_H_ */
@@ -9,34 +9,28 @@
 #include "BootstrapAllocator.h"
 #include "string.h"
 
-/* Allocator heap size: the size is computed like this: 2^BOOTSTRAP_POWER */
-#ifndef         BOOTSTRAP_POWER
-#define         BOOTSTRAP_POWER         20
-#endif
-
-/* Allocator heap size */
-#define         BOOTSTRAP_HEAP_SIZE     (1 << BOOTSTRAP_POWER)
-
-/* Allocator size must be a power of two, if not the following fails */
-#if ((BOOTSTRAP_HEAP_SIZE & (BOOTSTRAP_HEAP_SIZE - 1)) != 0)
-#error BOOTSTRAP_HEAP_SIZE must be a power of two !
-#endif
-
-/* Allocator heap */
-char memoryHeap[BOOTSTRAP_HEAP_SIZE];
-
 /* Free area table for the allocator*/
-struct freeblock freeAreas[BOOTSTRAP_POWER];
+struct freeblock freeAreas[BOOTSTRAP_MAX_POWER];
 
 
 /* False singleton implementation */
 static uint8_t allocator[sizeof(BootstrapAllocator)];
 
+char *BootstrapAllocator::mMemory = (char*) NULL;
+uint32_t BootstrapAllocator::mLength = 0;
+
 
-BootstrapAllocator::BootstrapAllocator():BuddyAllocator(freeAreas,
-                                                        BOOTSTRAP_POWER,
-                                                        memoryHeap,
-                                                        BOOTSTRAP_HEAP_SIZE){};
+BootstrapAllocator::BootstrapAllocator(char *memory, uint32_t length, bool clean)
+{
+        uint32_t power, mapSize;
+
+        /* The arena covers the heap, its block map ends the region */
+        power = powerFromSize(length);
+        mapSize = BUDDY_MAP_SIZE(power);
+        assert(power <= BOOTSTRAP_MAX_POWER && mapSize < length);
+        BuddyAllocator::setup(freeAreas, power, (uint8_t*) memory + length - mapSize,
+              memory, length - mapSize, clean);
+}
 
 void* BootstrapAllocator::operator new(size_t size)
 {
@@ -46,16 +40,62 @@ void* BootstrapAllocator::operator new(size_t size)
 
 BootstrapAllocator* BootstrapAllocator::mInstance = (BootstrapAllocator*) NULL;
 
+BootstrapAllocator *BootstrapAllocator::setup(char *memory, uint32_t length, bool clean)
+{
+        assert(length >= BOOTSTRAP_MIN_SIZE && length <= (1u << BOOTSTRAP_MAX_POWER));
+        assert(memory != NULL && ((uintptr_t) memory & (arenaSize(length) - 1)) == 0);
+
+        mMemory = memory;
+        mLength = length;
+        mInstance = new BootstrapAllocator(memory, length, clean);
+        return mInstance;
+}
+
+uint32_t BootstrapAllocator::arenaSize(uint32_t length)
+{
+        return 1u << powerFromSize(length);
+}
+
 BootstrapAllocator* BootstrapAllocator::getInstance(void)
 {
-        if (BootstrapAllocator::mInstance == NULL) {
-                BootstrapAllocator::mInstance = new BootstrapAllocator();
-        }
+        assert(BootstrapAllocator::mInstance != NULL);
         return BootstrapAllocator::mInstance;
 }
 
 void BootstrapAllocator::reset(void)
 {
-       mInstance =  new BootstrapAllocator();
+       assert(mMemory != NULL);
+       mInstance =  new BootstrapAllocator(mMemory, mLength, false);
+}
+
+size_t BootstrapAllocator::handOver(void (*give)(void *start, size_t length), size_t keep)
+{
+        struct buddy_stats stats;
+        size_t handed = 0;
+        size_t free, size;
+        uint32_t power, count;
+        void *block;
+
+        assert(give != NULL);
+        getStats(&stats);
+        free = heapSize() - stats.usedBytes;
+
+        /*
+         * Allocated for good, largest blocks first down to a page: blocks
+         * of the size asked for are left, none is split. A block that would
+         * leave less than keep bytes free stays, smaller ones may still go.
+         */
+        for (power = BOOTSTRAP_MAX_POWER; power >= PAGE_FRAME_POWER; power--) {
+                size = (size_t) 1 << power;
+                getStats(&stats);
+                for (count = stats.freeBlocks[power]; count > 0 && free >= keep + size; count--) {
+                        block = alloc(size);
+                        assert(block != NULL);
+                        give(block, size);
+                        handed += size;
+                        free -= size;
+                }
+        }
+        return handed;
 }
 
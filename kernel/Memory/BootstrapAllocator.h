@@ -7,6 +7,8 @@
  * Implemented as a singleton class, BUT, as we don't have any allocator yet, we
  * have to keep a public ctor.
  *
+ * The heap is not part of the kernel image: the boot code carves it from
+ * free memory, sized from the command line, and hands it to setup().
  */
 
 #ifndef _BOOTSTRAP_ALLOCATOR_H_
@@ -15,28 +17,75 @@
 #include "stdint.h"
 #include "stddef.h"
 #include "BuddyAllocator.h"
+#include "PageFrameAllocator.h"
+
+/* Largest bootstrap heap: 2^BOOTSTRAP_MAX_POWER bytes, the block map included */
+#define BOOTSTRAP_MAX_POWER     28
+
+/* Smallest bootstrap heap, the block map included */
+#define BOOTSTRAP_MIN_SIZE      (16 * PAGE_FRAME_SIZE)
 
 class BootstrapAllocator: public BuddyAllocator {
         private:
                 /* Singleton implementation */
                 static BootstrapAllocator *mInstance;
-                BootstrapAllocator();
+                BootstrapAllocator(char *memory, uint32_t length, bool clean);
                 void* operator new(size_t);
 
+                /* Memory given to setup(), for reset() */
+                static char *mMemory;
+                static uint32_t mLength;
+
         public:
+                /**
+                 * Build the allocator on a memory region. The block map is
+                 * taken from the end of the region, the heap is the rest.
+                 * Blocks are aligned relative to the region: it is aligned
+                 * on its arena size, so they are aligned in memory too and
+                 * allocAligned() may serve device buffers.
+                 * @param memory the region, aligned on arenaSize(length)
+                 * @param length the length of the region, from
+                 *               BOOTSTRAP_MIN_SIZE to 2^BOOTSTRAP_MAX_POWER
+                 * @param clean true if the region is known to be zero
+                 * @return the allocator, also available with getInstance()
+                 */
+                static BootstrapAllocator *setup(char *memory, uint32_t length, bool clean = false);
+
+                /**
+                 * Size of the arena of a bootstrap heap, the power of two
+                 * its region must be aligned on.
+                 * @param length the length of the region
+                 * @return the size of the arena
+                 */
+                static uint32_t arenaSize(uint32_t length);
+
                 /*
                  * Singleton implementation: retrieve the instance of the
-                 * allocator inside the singleton.
+                 * allocator inside the singleton, setup() must have been
+                 * called.
                  */
                 static BootstrapAllocator *getInstance(void);
 
                 /*
                  * Reset the allocator state. Beware, this will destroy memory
-                 * allocation mapping and data in the allocated chunks.
+                 * allocation mapping, data in the allocated chunks is garbage.
                  * For testing purpose essentially.
                  */
                 static void reset(void);
+
+                /**
+                 * Take the free pages of the heap out of the allocator, to
+                 * give them to the page frame allocator once it runs. The
+                 * chunks allocated so far stay valid, free blocks smaller
+                 * than a page stay with the allocator. Blocks are kept as
+                 * well as long as they are needed to leave keep bytes free,
+                 * for the allocations still made from the heap.
+                 * @param give called with every page aligned range taken
+                 *             out, as a virtual address and a length
+                 * @param keep the count of free bytes left to the allocator
+                 * @return the count of bytes handed over
+                 */
+                size_t handOver(void (*give)(void *start, size_t length), size_t keep = 0);
 };
 
 #endif /*_BOOTSTRAP_ALLOCATOR_H_ */
-
@@ -1,8 +1,14 @@
 /*
  * Copyright (C) 2012, the Simple Object Kernel project.
  *
- * BuddyAllocator.cpp: buddy allocator implementation.
+ * BuddyAllocator.cpp: buddy allocator of an arena sized at run time, and
+ * the allocation trace shared by all buddy allocators. The algorithm is in
+ * BasicBuddyAllocator.h.
  * by Damien Dejean <djod4556@yahoo.fr>
+ *
+ * Built with BUDDY_TRACE, allocations and frees of all allocators are
+ * recorded with a time stamp in a ring buffer, to be dumped and replayed
+ * off line by the allocator benchmark.
  */
 
 #include "stdint.h"
@@ -11,142 +17,82 @@
 #include "assert.h"
 #include "BuddyAllocator.h"
 
-BuddyAllocator::BuddyAllocator(struct freeblock *freeAreas,
-                               uint32_t capacities,
-                               char *heap,
-                               uint32_t heapSize):
-        mFreeAreas(freeAreas),
-        mCapacities(capacities),
-        mHeap(heap),
-        mHeapSize(heapSize)
-{
-        uint32_t i;
+#ifdef BUDDY_TRACE
 
-        /* Clear all chunk links */
-        for(i = 0; i < mCapacities - 1; i++) {
-                freeAreas[i].next = (struct freeblock*) NULL;
-        }
+/* Operations kept in the trace ring, the oldest ones are overwritten */
+#ifndef BUDDY_TRACE_ENTRIES
+#define BUDDY_TRACE_ENTRIES     8192
+#endif
 
-        /* Declare all heap memory as one BIG chunk */
-        memset(heap, 0, heapSize);
-        freeAreas[mCapacities - 1].next = (struct freeblock*) mHeap;
-        freeAreas[mCapacities - 1].next->next = (struct freeblock*) NULL;
+/* Trace record: the size is 0 for a free */
+struct trace_entry {
+        uint64_t timestamp;
+        uintptr_t address;
+        uint32_t size;
+};
 
-}
+/* Longest lines of a dump, their NUL included: the header and an allocation */
+#define TRACE_HEADER_LINE       sizeof("# buddy trace: 4294967295 operations, 4294967295 lost\n")
+#define TRACE_ALLOC_LINE        (sizeof("a 4294967295  ffffffffffffffff\n") + 2 * sizeof(uintptr_t))
+#define TRACE_LINE              ((TRACE_HEADER_LINE > TRACE_ALLOC_LINE) ? TRACE_HEADER_LINE : TRACE_ALLOC_LINE)
 
-uint32_t BuddyAllocator::heapSize(void)
-{
-    return mHeapSize;
-}
+static struct trace_entry traceRing[BUDDY_TRACE_ENTRIES];
+static uint32_t traceCount = 0;
 
-/**
- * Compute the upper power of two that contains an number.
- * @param n the number from which we compute the power
- */
-static uint32_t powerFromSize(uint32_t n)
+void buddy_trace_record(void *address, size_t size)
 {
-        uint32_t power;
-
-        n--;
-        for(power = 0; n != 0; power++, n >>= 1);
-
-        return (power < 2) ? 2 : power;
+        struct trace_entry *entry = &traceRing[traceCount % BUDDY_TRACE_ENTRIES];
+        uint32_t low, high;
+
+        __asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+        entry->timestamp = ((uint64_t) high << 32) | low;
+        entry->address = (uintptr_t) address;
+        entry->size = size;
+        traceCount++;
 }
 
+#endif
 
-void* BuddyAllocator::alloc(size_t size)
-{
-	uint32_t sizePower;
-        uint32_t power;
-	struct freeblock *freeArea;
-	struct freeblock *buddyArea;
-
-    if (size == 0) {
-        return NULL;
-    } else if (size < 4) {
-        size = 4;
-    }
-
-    sizePower = powerFromSize(size);
-    power = sizePower;
-
-	/* Heap is too small */
-	if (sizePower > mCapacities) {
-		return NULL;
-	}
-
-        /* Look for the first fitting area */
-	while (mFreeAreas[power-1].next == NULL){
-		power++;
-		if (power > mCapacities) {
-		        return NULL;
-		}
-	}
-
-	/* Get the free chunk */
-	freeArea = mFreeAreas[power-1].next;
-	mFreeAreas[power-1].next = mFreeAreas[power-1].next->next;
-
-    /* Split the chunk in buddies if needed */
-	while (power > sizePower) {
-		buddyArea = freeArea + ((1 << (power-1))/sizeof(struct freeblock));
-                assert(buddyArea != NULL);
-		buddyArea->next = mFreeAreas[power-2].next;
-		mFreeAreas[power-2].next = buddyArea;
-		power--;
-	}
-
-	return freeArea;
-
-}
 
-void *BuddyAllocator::myBuddyAddress(void *me, size_t mySize)
+BuddyAllocator::BuddyAllocator(struct freeblock *freeAreas,
+                               uint32_t capacities,
+                               uint8_t *blockMap,
+                               char *heap,
+                               uint32_t heapSize,
+                               bool clean)
 {
-        return (void*) ((((uint64_t)me - (uint64_t)mHeap)^(uint64_t)mySize) + (uint64_t)mHeap);
+        assert(freeAreas != NULL);
+        setup(freeAreas, capacities, blockMap, heap, heapSize, clean);
 }
 
-void BuddyAllocator::free(void *chunk, size_t size)
+#ifdef BUDDY_TRACE
+
+void BuddyAllocator::dumpTrace(void (*putbytes)(const char *str, int len))
 {
-	uint32_t power ;
-	struct freeblock *potentialBuddy;
-	struct freeblock *matchingBuddy;
-
-    if (chunk == NULL || size == 0) {
-        return;
-    }
-
-    if (size < 4) {
-        size = 4;
-    }
-
-    power = powerFromSize(size);
-    size = (size_t) 1 << power;
-
-	matchingBuddy = (struct freeblock *) myBuddyAddress(chunk, size);
-    assert(matchingBuddy != NULL);
-
-	potentialBuddy = &(mFreeAreas[power-1]);
-
-	while (potentialBuddy != NULL && potentialBuddy->next != NULL) {
-		if (potentialBuddy->next == matchingBuddy) {
-			potentialBuddy->next = potentialBuddy->next->next;
-			/* Is it the left or the right buddy ? */
-			chunk = (matchingBuddy < (struct freeblock*) chunk) ? (void*) matchingBuddy : chunk;
-
-			/* Look for a bigger buddy */
-            potentialBuddy = &(mFreeAreas[power]);
-			power++;
-
-			/* New buddy address */
-			size *= 2;
-			matchingBuddy = (struct freeblock *) myBuddyAddress(chunk, size);
-		} else {
-			potentialBuddy = potentialBuddy->next;
-		}
-	}
-
-	/* Finally chain the buddy */
-	((struct freeblock*) chunk)->next = mFreeAreas[power-1].next;
-	mFreeAreas[power-1].next = (struct freeblock*) chunk;
+        struct trace_entry *entry;
+        char line[TRACE_LINE];
+        uint32_t i, first;
+        int length;
+
+        assert(putbytes != NULL);
+
+        /* Only the last operations are left once the ring wrapped */
+        first = (traceCount > BUDDY_TRACE_ENTRIES) ? traceCount - BUDDY_TRACE_ENTRIES : 0;
+        length = snprintf(line, sizeof(line), "# buddy trace: %u operations, %u lost\n", traceCount, first);
+        putbytes(line, length);
+
+        for (i = first; i < traceCount; i++) {
+                entry = &traceRing[i % BUDDY_TRACE_ENTRIES];
+                if (entry->size != 0) {
+                        length = snprintf(line, sizeof(line), "a %u %lx %x%08x\n",
+                                          entry->size, (unsigned long) entry->address,
+                                          (uint32_t) (entry->timestamp >> 32), (uint32_t) entry->timestamp);
+                } else {
+                        length = snprintf(line, sizeof(line), "f %lx %x%08x\n", (unsigned long) entry->address,
+                                          (uint32_t) (entry->timestamp >> 32), (uint32_t) entry->timestamp);
+                }
+                putbytes(line, length);
+        }
 }
 
+#endif
@@ -10,38 +10,50 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "BasicBuddyAllocator.h"
 
-/* Free block: self contained link to the next one ! */
-struct freeblock {
-        struct freeblock *next;
-};
-
-class BuddyAllocator {
-        private:
-                /* Free area management */
-                struct freeblock *mFreeAreas;
-                uint32_t mCapacities;
+/*
+ * Smallest block managed by the allocator: 2^BUDDY_MIN_POWER bytes. A free
+ * block must be able to hold its own free block descriptor.
+ */
+#define BUDDY_MIN_POWER         4
+#define BUDDY_MIN_SIZE          (1 << BUDDY_MIN_POWER)
 
-                /*  Memory heap */
-                char *mHeap;
-                uint32_t mHeapSize;
+/*
+ * Size in bytes of the block map needed by a heap of 2^power bytes: one
+ * entry per minimum sized block.
+ */
+#define BUDDY_MAP_SIZE(power)   ((1u << (power)) >> BUDDY_MIN_POWER)
 
-                /* Find the address of my buddy chunk */
-                void *myBuddyAddress(void *me, size_t mySize);
+/*
+ * Buddy allocator of an arena whose size is only known at run time. Use
+ * BasicBuddyAllocator<BUDDY_MIN_POWER, power> when it is known at compile
+ * time.
+ */
+class BuddyAllocator: public BasicBuddyAllocator<BUDDY_MIN_POWER, BUDDY_RUNTIME_POWER> {
+        protected:
+                /* For derived classes that call setup() themselves */
+                BuddyAllocator(void) {}
 
         public:
                 BuddyAllocator(struct freeblock *freeAreas,    /* Free area table */
                                uint32_t capacities,             /* Number of free area sizes */
-                               char *heap,
-                               uint32_t heapSize);
-
-                /* Allocator implementation */
-                void *alloc(size_t size);
-                void free(void *chunk, size_t size);
-
-                /* Convenience */
-                uint32_t heapSize(void);
+                               uint8_t *blockMap,               /* BUDDY_MAP_SIZE(capacities) bytes */
+                               char *heap,                      /* Arena of 2^capacities bytes */
+                               uint32_t heapSize,               /* Usable size from heap, may be 0 */
+                               bool clean = false);             /* The heap is known to be zero */
+
+#ifdef BUDDY_TRACE
+                /**
+                 * Print the allocation trace of all buddy allocators, oldest
+                 * operation first, one operation per line: "a <size>
+                 * <address> <timestamp>" for an allocation, "f <address>
+                 * <timestamp>" for a free. A failed allocation has a null
+                 * address. Numbers are hexadecimal, but sizes.
+                 * @param putbytes the output, like qemu_putbytes
+                 */
+                static void dumpTrace(void (*putbytes)(const char *str, int len));
+#endif
 };
 
 #endif /*_BUDDY_ALLOCATOR_H_ */
-
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * HighMemory.cpp: kmap window implementation. The entries of the slots
+ * are consecutive entries of the same page table: with a self mapped
+ * address space, they are reached through the self map.
+ */
+
+#include "assert.h"
+#include "string.h"
+#include "new.h"
+#include "Boot/cpu.h"
+#include "HighMemory.h"
+
+/* False singleton implementation */
+HighMemory *HighMemory::mInstance = (HighMemory*) NULL;
+static void *instance[(sizeof(HighMemory) + sizeof(void*) - 1) / sizeof(void*)];
+
+
+HighMemory::HighMemory(AddressSpace *space, uint32_t start):
+    mSpace(space),
+    mStart(start),
+    mUsedSlots(0)
+{
+    assert(space != NULL && (start & (PAGE_LARGE_SIZE - 1)) == 0);
+
+    mEntries = space->fixedEntry(start);
+    assert(mEntries != NULL);
+    memset(mFreeSlots, 0xFF, sizeof(mFreeSlots));
+}
+
+
+void *HighMemory::map(uint64_t physical)
+{
+    uint32_t word, slot;
+
+    assert((physical & (PAGE_FRAME_SIZE - 1)) == 0 && physical < PAGE_FRAME_LIMIT);
+
+    if (physical + PAGE_FRAME_SIZE <= PAGE_ZONE_NORMAL_END) {
+        return mSpace->window() + physical;
+    }
+
+    for (word = 0; word < KMAP_SLOTS / 32 && mFreeSlots[word] == 0; word++) {
+        continue;
+    }
+    if (word == KMAP_SLOTS / 32) {
+        return NULL;
+    }
+    slot = word * 32 + bit_scan_forward(mFreeSlots[word]);
+    mFreeSlots[word] &= ~(1u << (slot % 32));
+    mUsedSlots++;
+
+    /* The slot was flushed when it was given back */
+    mEntries[slot] = (page_entry_t) physical | PAGE_PRESENT | PAGE_WRITE;
+    return (void*) (uintptr_t) (mStart + slot * PAGE_FRAME_SIZE);
+}
+
+void HighMemory::unmap(void *address)
+{
+    uint32_t slot;
+
+    if ((uintptr_t) address - mStart >= KMAP_SLOTS * PAGE_FRAME_SIZE) {
+        return;
+    }
+    slot = ((uintptr_t) address - mStart) >> PAGE_FRAME_POWER;
+    assert((mFreeSlots[slot / 32] & (1u << (slot % 32))) == 0);
+
+    mEntries[slot] = 0;
+    mSpace->invalidate(mStart + slot * PAGE_FRAME_SIZE);
+    mFreeSlots[slot / 32] |= 1u << (slot % 32);
+    mUsedSlots--;
+}
+
+uint32_t HighMemory::usedSlots(void)
+{
+    return mUsedSlots;
+}
+
+
+HighMemory *HighMemory::setup(void)
+{
+    mInstance = new (instance) HighMemory(AddressSpace::getInstance(), KMAP_START);
+    return mInstance;
+}
+
+HighMemory *HighMemory::getInstance(void)
+{
+    return mInstance;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * HighMemory.h: temporary mappings of page frames out of the normal zone,
+ * the frames the kernel has no address for until it maps them.
+ */
+
+#ifndef _HIGH_MEMORY_H_
+#define _HIGH_MEMORY_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "AddressSpace.h"
+
+/**
+ * kmap window: 2 MB of 4 kB slots right after the kernel virtual ranges,
+ * a single page table with or without PAE.
+ */
+#define KMAP_START          0xFF000000u
+#define KMAP_SLOTS          512
+
+/**
+ * Maps frames one at a time in the slots of the kmap window. The page
+ * table of the window is taken once, and its entries are written directly:
+ * mapping a frame costs an entry, unmapping it a TLB flush. Frames of the
+ * normal zone already have an address, they take no slot.
+ *
+ * Mappings are temporary: a slot should be given back as soon as the
+ * frame has been used.
+ */
+class HighMemory {
+    private:
+        /** Singleton implementation */
+        static HighMemory *mInstance;
+
+        /** Address space of the window */
+        AddressSpace *mSpace;
+
+        /** The window, and the entries of its slots */
+        uint32_t mStart;
+        page_entry_t *mEntries;
+
+        /** Bit set for a free slot */
+        uint32_t mFreeSlots[KMAP_SLOTS / 32];
+        uint32_t mUsedSlots;
+
+    public:
+        /**
+         * Create the window, taking its page table.
+         * @param space the address space of the window
+         * @param start the address of the window, aligned on
+         *              PAGE_LARGE_SIZE
+         */
+        HighMemory(AddressSpace *space, uint32_t start);
+
+        /**
+         * Get an address for a frame.
+         * @param physical the physical address of the frame, page aligned
+         * @return the address of the frame, NULL if no slot is free
+         */
+        void *map(uint64_t physical);
+
+        /**
+         * Give back an address obtained from map.
+         * @param address the address of the frame
+         */
+        void unmap(void *address);
+
+        /** Count of slots in use */
+        uint32_t usedSlots(void);
+
+        /**
+         * Build the kmap window at KMAP_START in the kernel address space.
+         * @return the window, also available with getInstance()
+         */
+        static HighMemory *setup(void);
+
+        /**
+         * Singleton implementation: the window built by setup(), NULL
+         * before.
+         */
+        static HighMemory *getInstance(void);
+};
+
+#endif /* _HIGH_MEMORY_H_ */
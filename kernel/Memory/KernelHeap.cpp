@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * KernelHeap.cpp: kernel heap implementation. A chunk that begins a buddy
+ * block is a large allocation. Any other chunk is an object inside a slab,
+ * and the slab knows its cache.
+ */
+
+#include "assert.h"
+#include "new.h"
+#include "BootstrapAllocator.h"
+#include "KernelHeap.h"
+#include "kmalloc.h"
+
+/** Object size of each size class */
+static const uint32_t classSizes[KHEAP_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+/** Cache names, for debug */
+static const char *classNames[KHEAP_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-48", "kmalloc-64",
+    "kmalloc-96", "kmalloc-128", "kmalloc-192", "kmalloc-256",
+    "kmalloc-384", "kmalloc-512", "kmalloc-768", "kmalloc-1024"
+};
+
+
+KernelHeap::KernelHeap(BuddyAllocator *allocator):
+    mAllocator(allocator)
+{
+    uint32_t i, c;
+
+    assert(allocator != NULL);
+    assert(classSizes[KHEAP_CLASSES - 1] == KHEAP_MAX_SMALL);
+
+    for (i = 0; i < KHEAP_CLASSES; i++) {
+        mCaches[i] = new (mCacheStorage[i]) SlabCache(allocator, classNames[i], classSizes[i]);
+    }
+
+    /* Smallest class holding each granule */
+    for (i = 0, c = 0; i < KHEAP_MAX_SMALL / KHEAP_GRANULE; i++) {
+        while (classSizes[c] < (i + 1) * KHEAP_GRANULE) {
+            c++;
+        }
+        mClassOfSize[i] = c;
+    }
+}
+
+KernelHeap::~KernelHeap(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < KHEAP_CLASSES; i++) {
+        mCaches[i]->~SlabCache();
+        mCaches[i] = NULL;
+    }
+    mAllocator = NULL;
+}
+
+
+void *KernelHeap::alloc(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    } else if (size > KHEAP_MAX_SMALL) {
+        return mAllocator->alloc(size);
+    }
+    return mCaches[mClassOfSize[(size - 1) / KHEAP_GRANULE]]->alloc();
+}
+
+void KernelHeap::free(void *chunk)
+{
+    void *block;
+
+    if (chunk == NULL) {
+        return;
+    }
+
+    block = mAllocator->chunkOf(chunk);
+    assert(block != NULL);
+    if (block == chunk) {
+        /* Slab objects never begin a block, it's a large chunk */
+        mAllocator->free(chunk);
+    } else {
+        SlabCache::cacheOf(block)->free(chunk);
+    }
+}
+
+size_t KernelHeap::chunkSize(void *chunk)
+{
+    void *block;
+
+    block = mAllocator->chunkOf(chunk);
+    assert(block != NULL);
+    if (block == chunk) {
+        return mAllocator->chunkSize(chunk);
+    }
+    return SlabCache::cacheOf(block)->objectSize();
+}
+
+void KernelHeap::reap(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < KHEAP_CLASSES; i++) {
+        mCaches[i]->reap();
+    }
+}
+
+
+/* False singleton implementation */
+static void *heap[(sizeof(KernelHeap) + sizeof(void*) - 1) / sizeof(void*)];
+
+KernelHeap *KernelHeap::mInstance = (KernelHeap*) NULL;
+
+KernelHeap *KernelHeap::getInstance(void)
+{
+    if (KernelHeap::mInstance == NULL) {
+        KernelHeap::mInstance = new (heap) KernelHeap(BootstrapAllocator::getInstance());
+    }
+    return KernelHeap::mInstance;
+}
+
+
+/*
+ * C interface.
+ * @see kmalloc.h
+ */
+
+void *kmalloc(size_t size)
+{
+    return KernelHeap::getInstance()->alloc(size);
+}
+
+void kfree(void *chunk)
+{
+    KernelHeap::getInstance()->free(chunk);
+}
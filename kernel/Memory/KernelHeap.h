@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * KernelHeap.h: general purpose kernel heap. Small requests are served by
+ * segregated size classes, each one backed by an object cache, large ones
+ * go straight to the buddy allocator.
+ */
+
+#ifndef _KERNEL_HEAP_H_
+#define _KERNEL_HEAP_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "BuddyAllocator.h"
+#include "SlabCache.h"
+
+/** Count of small size classes */
+#define KHEAP_CLASSES       12
+
+/** Largest request served by a size class */
+#define KHEAP_MAX_SMALL     1024
+
+/** Granularity of the size to class lookup table */
+#define KHEAP_GRANULE       16
+
+/** Free bootstrap heap kept for new slabs and large chunks after handOver() */
+#define KHEAP_RESERVE       (256 * 1024)
+
+class KernelHeap {
+    private:
+        /** Singleton implementation */
+        static KernelHeap *mInstance;
+
+        /** The allocator large chunks and slabs come from */
+        BuddyAllocator *mAllocator;
+
+        /** Size class caches, built in place */
+        SlabCache *mCaches[KHEAP_CLASSES];
+        void *mCacheStorage[KHEAP_CLASSES][(sizeof(SlabCache) + sizeof(void*) - 1) / sizeof(void*)];
+
+        /** Size class of each KHEAP_GRANULE of request size */
+        uint8_t mClassOfSize[KHEAP_MAX_SMALL / KHEAP_GRANULE];
+
+    public:
+        KernelHeap(BuddyAllocator *allocator);
+        ~KernelHeap(void);
+
+        /**
+         * Allocate a chunk of memory.
+         * @param size the size of the chunk
+         * @return a chunk aligned on pointers, NULL if size is null or if
+         *         the memory is exhausted
+         */
+        void *alloc(size_t size);
+
+        /**
+         * Give back a chunk obtained from alloc.
+         * @param chunk the chunk, may be NULL
+         */
+        void free(void *chunk);
+
+        /**
+         * Get the usable size of a chunk.
+         * @param chunk a chunk obtained from alloc
+         * @return the count of bytes available in the chunk
+         */
+        size_t chunkSize(void *chunk);
+
+        /**
+         * Give the empty slabs of all size classes back to the allocator.
+         */
+        void reap(void);
+
+        /**
+         * Singleton implementation: the kernel heap, built on the bootstrap
+         * allocator.
+         */
+        static KernelHeap *getInstance(void);
+};
+
+#endif /* _KERNEL_HEAP_H_ */
@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * PageFrameAllocator.cpp: page frame allocator implementation. Frames are
+ * not mapped, so everything the buddy system needs lives in the descriptor
+ * table: free areas are doubly linked lists of frame numbers, and the head
+ * frame of each block records its order and state. Finding out if a buddy
+ * is free and unlinking it is O(1).
+ *
+ * Ranges are added as the largest aligned blocks, not frame by frame: the
+ * cost of building the allocator is clearing the descriptor table.
+ *
+ * Each zone has its own free areas. Zone limits are aligned on the largest
+ * block, so buddies are always in the same zone and the zone of a block is
+ * found from its first frame.
+ *
+ * Zones are split in pageblocks, each serving one allocation lifetime. The
+ * free areas are per lifetime and a free block is in the areas of its
+ * pageblock, so allocations stay in the pageblocks of their lifetime as
+ * long as these have free frames. Pageblocks are blocks of the largest
+ * order: buddies never straddle two of them.
+ */
+
+#include "assert.h"
+#include "string.h"
+#include "new.h"
+#include "Boot/bootstrap.h"
+#include "Boot/cpu.h"
+#include "PageFrameAllocator.h"
+
+/** Memory below this address is left to the BIOS and real mode code */
+#define LOW_MEMORY_END      0x100000ull
+
+/** Count of ranges setup() keeps out of the allocator */
+#define SETUP_HOLES         3
+
+/** Zone limits, as frame numbers */
+#define DMA_ZONE_END        ((uint32_t) (PAGE_ZONE_DMA_END >> PAGE_FRAME_POWER))
+#define NORMAL_ZONE_END     ((uint32_t) (PAGE_ZONE_NORMAL_END >> PAGE_FRAME_POWER))
+
+/** Default min watermark: 1/MIN_RATIO of the zone */
+#define MIN_RATIO           1024
+
+/** Default reserves: 1/RESERVE_RATIO of the frames of the higher zones */
+#define DMA_RESERVE_RATIO       256
+#define NORMAL_RESERVE_RATIO    32
+
+/**
+ * Lifetimes a lifetime with no free block takes blocks from, in order:
+ * pinned and reclaimable pageblocks are mixed first, movable ones last.
+ */
+static const uint8_t lifetimeFallbacks[PAGE_LIFETIMES][PAGE_LIFETIMES - 1] = {
+    { PAGE_LIFETIME_RECLAIMABLE, PAGE_LIFETIME_MOVABLE },   /* Pinned */
+    { PAGE_LIFETIME_PINNED, PAGE_LIFETIME_MOVABLE },        /* Reclaimable */
+    { PAGE_LIFETIME_RECLAIMABLE, PAGE_LIFETIME_PINNED }     /* Movable */
+};
+
+/* False singleton implementation */
+PageFrameAllocator *PageFrameAllocator::mInstance = (PageFrameAllocator*) NULL;
+static void *instance[(sizeof(PageFrameAllocator) + sizeof(void*) - 1) / sizeof(void*)];
+
+
+PageFrameAllocator::PageFrameAllocator(struct page_frame *frames, uint32_t frameCount):
+    mFrames(frames),
+    mFrameCount(frameCount),
+    mFreeFrames(0)
+{
+    uint32_t i, lifetime, zone;
+
+    assert(frames != NULL);
+
+    memset(mZones, 0, sizeof(mZones));
+    for (zone = 0; zone < PAGE_ZONES; zone++) {
+        for (lifetime = 0; lifetime < PAGE_LIFETIMES; lifetime++) {
+            for (i = 0; i <= PAGE_MAX_ORDER; i++) {
+                mZones[zone].freeAreas[lifetime][i] = PAGE_FRAME_NONE;
+            }
+        }
+    }
+    memset(frames, 0, frameCount * sizeof(struct page_frame));
+
+    /* Pageblocks start movable, the other lifetimes claim them on demand */
+    for (i = 0; i < frameCount; i += PAGE_BLOCK_FRAMES) {
+        frames[i].lifetime = PAGE_LIFETIME_MOVABLE;
+    }
+}
+
+
+struct frame_zone *PageFrameAllocator::zoneOf(uint32_t frame)
+{
+    if (frame < DMA_ZONE_END) {
+        return &mZones[PAGE_ZONE_DMA];
+    } else if (frame < NORMAL_ZONE_END) {
+        return &mZones[PAGE_ZONE_NORMAL];
+    }
+    return &mZones[PAGE_ZONE_HIGH];
+}
+
+bool PageFrameAllocator::zoneFits(struct frame_zone *zone, uint32_t order, uint32_t mark)
+{
+    uint32_t orders = 0;
+    int lifetime;
+
+    for (lifetime = 0; lifetime < PAGE_LIFETIMES; lifetime++) {
+        orders |= zone->freeOrders[lifetime];
+    }
+    return (orders & ~((1u << order) - 1)) != 0
+           && zone->freeFrames >= (1u << order) + mark;
+}
+
+uint32_t PageFrameAllocator::lifetimeOf(uint32_t frame)
+{
+    return mFrames[frame & ~(PAGE_BLOCK_FRAMES - 1)].lifetime;
+}
+
+
+bool PageFrameAllocator::isFreeBlock(uint32_t frame, uint32_t order)
+{
+    return frame < mFrameCount
+           && mFrames[frame].flags == (PAGE_FRAME_HEAD | PAGE_FRAME_FREE)
+           && mFrames[frame].order == order;
+}
+
+void PageFrameAllocator::insertBlock(uint32_t frame, uint32_t order, uint32_t lifetime)
+{
+    struct page_frame *pf = &mFrames[frame];
+    struct frame_zone *zone = zoneOf(frame);
+
+    pf->prev = PAGE_FRAME_NONE;
+    pf->next = zone->freeAreas[lifetime][order];
+    if (pf->next != PAGE_FRAME_NONE) {
+        mFrames[pf->next].prev = frame;
+    }
+    zone->freeAreas[lifetime][order] = frame;
+
+    pf->order = order;
+    pf->flags = PAGE_FRAME_HEAD | PAGE_FRAME_FREE;
+    zone->freeOrders[lifetime] |= (1u << order);
+    zone->freeFrames += (1u << order);
+    mFreeFrames += (1u << order);
+}
+
+void PageFrameAllocator::removeBlock(uint32_t frame, uint32_t lifetime)
+{
+    struct page_frame *pf = &mFrames[frame];
+    struct frame_zone *zone = zoneOf(frame);
+
+    if (pf->prev != PAGE_FRAME_NONE) {
+        mFrames[pf->prev].next = pf->next;
+    } else {
+        zone->freeAreas[lifetime][pf->order] = pf->next;
+        if (pf->next == PAGE_FRAME_NONE) {
+            zone->freeOrders[lifetime] &= ~(1u << pf->order);
+        }
+    }
+    if (pf->next != PAGE_FRAME_NONE) {
+        mFrames[pf->next].prev = pf->prev;
+    }
+
+    pf->flags = 0;
+    zone->freeFrames -= (1u << pf->order);
+    mFreeFrames -= (1u << pf->order);
+}
+
+void PageFrameAllocator::freeBlock(uint32_t frame, uint32_t order)
+{
+    uint32_t lifetime = lifetimeOf(frame);
+    uint32_t buddy;
+
+    /* The frame no longer heads a block, a merge may make it a tail frame */
+    mFrames[frame].flags = 0;
+    mFrames[frame].order = 0;
+
+    /* Merge with the buddy as long as it is free, in the same pageblock */
+    while (order < PAGE_MAX_ORDER) {
+        buddy = frame ^ (1u << order);
+        if (!isFreeBlock(buddy, order)) {
+            break;
+        }
+        removeBlock(buddy, lifetime);
+        frame = (buddy < frame) ? buddy : frame;
+        order++;
+    }
+
+    insertBlock(frame, order, lifetime);
+}
+
+
+uint32_t PageFrameAllocator::pageBlockFreeFrames(uint32_t frame)
+{
+    uint32_t first = frame & ~(PAGE_BLOCK_FRAMES - 1);
+    uint32_t end = first + PAGE_BLOCK_FRAMES;
+    uint32_t count = 0;
+    uint32_t order;
+
+    end = (end > mFrameCount) ? mFrameCount : end;
+    for (frame = first; frame < end; frame += (1u << order)) {
+        order = 0;
+        if (mFrames[frame].flags & PAGE_FRAME_HEAD) {
+            order = mFrames[frame].order;
+            if (mFrames[frame].flags & PAGE_FRAME_FREE) {
+                count += (1u << order);
+            }
+        }
+    }
+    return count;
+}
+
+void PageFrameAllocator::claimPageBlock(uint32_t frame, enum page_lifetime lifetime)
+{
+    uint32_t first = frame & ~(PAGE_BLOCK_FRAMES - 1);
+    uint32_t end = first + PAGE_BLOCK_FRAMES;
+    uint32_t previous = lifetimeOf(first);
+    uint32_t order;
+
+    end = (end > mFrameCount) ? mFrameCount : end;
+
+    /* Walk the pageblock block by block, moving the free ones */
+    for (frame = first; frame < end; frame += (1u << order)) {
+        order = 0;
+        if (mFrames[frame].flags & PAGE_FRAME_HEAD) {
+            order = mFrames[frame].order;
+            if (mFrames[frame].flags & PAGE_FRAME_FREE) {
+                removeBlock(frame, previous);
+                insertBlock(frame, order, lifetime);
+            }
+        }
+    }
+    mFrames[first].lifetime = lifetime;
+}
+
+uint32_t PageFrameAllocator::stealBlock(struct frame_zone *zone, uint32_t order,
+                                        enum page_lifetime lifetime)
+{
+    uint32_t frame = PAGE_FRAME_NONE;
+    uint32_t power = 0;
+    uint32_t orders, largest;
+    int i, other;
+
+    /* The largest block, the fewer pageblocks get mixed */
+    for (i = 0; i < PAGE_LIFETIMES - 1; i++) {
+        other = lifetimeFallbacks[lifetime][i];
+        orders = zone->freeOrders[other] & ~((1u << order) - 1);
+        if (orders != 0) {
+            largest = bit_scan_reverse(orders);
+            if (frame == PAGE_FRAME_NONE || largest > power) {
+                power = largest;
+                frame = zone->freeAreas[other][power];
+            }
+        }
+    }
+    assert(frame != PAGE_FRAME_NONE);
+
+    /*
+     * Take the whole pageblock, or pinned frames would spread over as many
+     * pageblocks as there are requests. Movable requests only take it when
+     * at least half of it is free: their frames come back soon, and the
+     * frames still allocated would be left in a movable pageblock.
+     */
+    if (lifetime != PAGE_LIFETIME_MOVABLE
+        || pageBlockFreeFrames(frame) >= PAGE_BLOCK_FRAMES / 2) {
+        claimPageBlock(frame, lifetime);
+    }
+    return frame;
+}
+
+
+void PageFrameAllocator::addRange(uint64_t address, uint64_t length)
+{
+    uint64_t first, end;
+    uint32_t frame, order, sizeOrder;
+
+    /* Whole frames only, frame 0 is never handed out */
+    first = (address + PAGE_FRAME_SIZE - 1) >> PAGE_FRAME_POWER;
+    end = (address + length) >> PAGE_FRAME_POWER;
+    first = (first == 0) ? 1 : first;
+    end = (end > mFrameCount) ? mFrameCount : end;
+
+    for (frame = first; frame < end; frame += (1u << order)) {
+        /* Largest block aligned here that fits in the range */
+        order = bit_scan_forward(frame);
+        sizeOrder = bit_scan_reverse(end - frame);
+        order = (order < sizeOrder) ? order : sizeOrder;
+        order = (order < PAGE_MAX_ORDER) ? order : PAGE_MAX_ORDER;
+
+        assert(mFrames[frame].flags == 0);
+        zoneOf(frame)->presentFrames += (1u << order);
+        freeBlock(frame, order);
+    }
+}
+
+
+uint64_t PageFrameAllocator::allocPages(uint32_t order, enum page_zone zone,
+                                        enum page_lifetime lifetime)
+{
+    struct frame_zone *from = NULL;
+    uint32_t orders, power;
+    uint32_t frame, blockLifetime;
+    uint32_t mark;
+    int pass, z;
+
+    if (order > PAGE_MAX_ORDER) {
+        return 0;
+    }
+    assert((uint32_t) zone < PAGE_ZONES && (uint32_t) lifetime < PAGE_LIFETIMES);
+
+    /* Zones above their low watermark first, then above their min one */
+    for (pass = 0; pass < 2 && from == NULL; pass++) {
+        for (z = zone; z >= PAGE_ZONE_DMA && from == NULL; z--) {
+            mark = (pass == 0) ? mZones[z].lowFrames : mZones[z].minFrames;
+            mark += (z != zone) ? mZones[z].reserveFrames : 0;
+            if (zoneFits(&mZones[z], order, mark)) {
+                from = &mZones[z];
+            }
+        }
+    }
+    if (from == NULL) {
+        return 0;
+    }
+
+    /* Take the first fitting block of the lifetime, or one from another */
+    orders = from->freeOrders[lifetime] & ~((1u << order) - 1);
+    if (orders != 0) {
+        power = bit_scan_forward(orders);
+        frame = from->freeAreas[lifetime][power];
+    } else {
+        frame = stealBlock(from, order, lifetime);
+        power = mFrames[frame].order;
+    }
+
+    /* Split it in buddies if needed, they stay with their pageblock */
+    blockLifetime = lifetimeOf(frame);
+    removeBlock(frame, blockLifetime);
+    while (power > order) {
+        power--;
+        insertBlock(frame + (1u << power), power, blockLifetime);
+    }
+    mFrames[frame].order = order;
+    mFrames[frame].flags = PAGE_FRAME_HEAD;
+
+    return (uint64_t) frame << PAGE_FRAME_POWER;
+}
+
+void PageFrameAllocator::freePages(uint64_t address)
+{
+    uint32_t frame;
+
+    if (address == 0) {
+        return;
+    }
+
+    frame = (uint32_t) (address >> PAGE_FRAME_POWER);
+    assert((address & (PAGE_FRAME_SIZE - 1)) == 0 && frame < mFrameCount);
+    assert(mFrames[frame].flags == PAGE_FRAME_HEAD);
+    freeBlock(frame, mFrames[frame].order);
+}
+
+void PageFrameAllocator::freePages(uint64_t address, uint32_t order)
+{
+    if (address == 0) {
+        return;
+    }
+
+    assert(mFrames[address >> PAGE_FRAME_POWER].order == order);
+    freePages(address);
+}
+
+
+void PageFrameAllocator::setWatermarks(enum page_zone zone, uint32_t minFrames,
+                                       uint32_t lowFrames, uint32_t reserveFrames)
+{
+    assert((uint32_t) zone < PAGE_ZONES && minFrames <= lowFrames);
+
+    mZones[zone].minFrames = minFrames;
+    mZones[zone].lowFrames = lowFrames;
+    mZones[zone].reserveFrames = reserveFrames;
+}
+
+void PageFrameAllocator::setDefaultWatermarks(void)
+{
+    uint32_t normal = mZones[PAGE_ZONE_NORMAL].presentFrames;
+    uint32_t high = mZones[PAGE_ZONE_HIGH].presentFrames;
+    uint32_t min;
+    int zone;
+
+    for (zone = PAGE_ZONE_DMA; zone < PAGE_ZONES; zone++) {
+        min = mZones[zone].presentFrames / MIN_RATIO;
+        setWatermarks((enum page_zone) zone, min, min + min / 4,
+                      (zone == PAGE_ZONE_DMA) ? (normal + high) / DMA_RESERVE_RATIO
+                      : (zone == PAGE_ZONE_NORMAL) ? high / NORMAL_RESERVE_RATIO : 0);
+    }
+}
+
+
+uint32_t PageFrameAllocator::frameCount(void)
+{
+    return mFrameCount;
+}
+
+uint32_t PageFrameAllocator::freeFrames(void)
+{
+    return mFreeFrames;
+}
+
+uint32_t PageFrameAllocator::freeFrames(enum page_zone zone)
+{
+    assert((uint32_t) zone < PAGE_ZONES);
+    return mZones[zone].freeFrames;
+}
+
+uint32_t PageFrameAllocator::presentFrames(enum page_zone zone)
+{
+    assert((uint32_t) zone < PAGE_ZONES);
+    return mZones[zone].presentFrames;
+}
+
+
+uint32_t PageFrameAllocator::freeBlocks(uint32_t order)
+{
+    uint32_t count = 0;
+    uint32_t frame;
+    int zone, lifetime;
+
+    assert(order <= PAGE_MAX_ORDER);
+    for (zone = 0; zone < PAGE_ZONES; zone++) {
+        for (lifetime = 0; lifetime < PAGE_LIFETIMES; lifetime++) {
+            frame = mZones[zone].freeAreas[lifetime][order];
+            for (; frame != PAGE_FRAME_NONE; frame = mFrames[frame].next) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+enum page_lifetime PageFrameAllocator::pageBlockLifetime(uint64_t address)
+{
+    uint32_t frame = (uint32_t) (address >> PAGE_FRAME_POWER);
+
+    assert(frame < mFrameCount);
+    return (enum page_lifetime) lifetimeOf(frame);
+}
+
+
+/**
+ * Give a range to the allocator, except the parts covered by holes.
+ */
+static void addRangeExcept(PageFrameAllocator *allocator,
+                           uint64_t start, uint64_t end,
+                           const uint64_t (*holes)[2], uint32_t count)
+{
+    if (start >= end) {
+        return;
+    }
+
+    if (count == 0) {
+        allocator->addRange(start, end - start);
+    } else if (holes[0][1] <= start || holes[0][0] >= end) {
+        addRangeExcept(allocator, start, end, holes + 1, count - 1);
+    } else {
+        addRangeExcept(allocator, start, holes[0][0], holes + 1, count - 1);
+        addRangeExcept(allocator, holes[0][1], end, holes + 1, count - 1);
+    }
+}
+
+PageFrameAllocator *PageFrameAllocator::setup(PhysicalMemoryMap *map,
+                                              uint64_t imageStart,
+                                              uint64_t imageEnd,
+                                              uint64_t limit)
+{
+    PhysicalMemoryMap::iterator chunk;
+    uint64_t highest, start, end;
+    uint64_t table, tableSize;
+    uint64_t holes[SETUP_HOLES][2];
+    uint32_t frameCount;
+
+    assert(map != NULL);
+    assert(limit <= PAGE_FRAME_LIMIT);
+
+    /* Describe frames up to the end of the highest free chunk */
+    highest = 0;
+    for (chunk = map->begin(); chunk != map->end(); chunk++) {
+        end = chunk->address + chunk->length;
+        if (chunk->status == FREE_MEMORY && end > highest) {
+            highest = end;
+        }
+    }
+    highest = (highest > limit) ? limit : highest;
+    frameCount = (uint32_t) (highest >> PAGE_FRAME_POWER);
+    tableSize = ((uint64_t) frameCount * sizeof(struct page_frame) + PAGE_FRAME_SIZE - 1)
+                & ~(uint64_t) (PAGE_FRAME_SIZE - 1);
+
+    /* The descriptor table goes in the first free chunk above the image, in the normal zone */
+    table = 0;
+    imageEnd = (imageEnd + PAGE_FRAME_SIZE - 1) & ~(uint64_t) (PAGE_FRAME_SIZE - 1);
+    for (chunk = map->begin(); chunk != map->end(); chunk++) {
+        start = (chunk->address + PAGE_FRAME_SIZE - 1) & ~(uint64_t) (PAGE_FRAME_SIZE - 1);
+        start = (start < imageEnd) ? imageEnd : start;
+        end = chunk->address + chunk->length;
+        if (chunk->status == FREE_MEMORY && start + tableSize <= end
+            && start + tableSize <= highest && start + tableSize <= PAGE_ZONE_NORMAL_END
+            && (table == 0 || start < table)) {
+            table = start;
+        }
+    }
+    assert(table != 0);
+
+    mInstance = new (instance) PageFrameAllocator((struct page_frame*) (uintptr_t) (table + KERNEL_BASE),
+                                                  frameCount);
+
+    /* Give all free memory, except what we use */
+    holes[0][0] = 0;
+    holes[0][1] = LOW_MEMORY_END;
+    holes[1][0] = imageStart;
+    holes[1][1] = imageEnd;
+    holes[2][0] = table;
+    holes[2][1] = table + tableSize;
+    for (chunk = map->begin(); chunk != map->end(); chunk++) {
+        if (chunk->status == FREE_MEMORY) {
+            addRangeExcept(mInstance, chunk->address, chunk->address + chunk->length,
+                           holes, SETUP_HOLES);
+        }
+    }
+    mInstance->setDefaultWatermarks();
+
+    return mInstance;
+}
+
+PageFrameAllocator *PageFrameAllocator::getInstance(void)
+{
+    return mInstance;
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * PageFrameAllocator.h: physical page frame allocator, a buddy system at
+ * page granularity built from the physical memory map. Memory is split in
+ * zones by what can reach it, each zone has its own free areas. Inside a
+ * zone, frames are grouped in pageblocks by the lifetime of what they hold.
+ */
+
+#ifndef _PAGE_FRAME_ALLOCATOR_H_
+#define _PAGE_FRAME_ALLOCATOR_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "PhysicalMemoryMap.h"
+
+/** Size of a page frame: 2^PAGE_FRAME_POWER bytes */
+#define PAGE_FRAME_POWER    12
+#define PAGE_FRAME_SIZE     (1u << PAGE_FRAME_POWER)
+
+/** Largest block: 2^PAGE_MAX_ORDER frames, a 4 MB page */
+#define PAGE_MAX_ORDER      10
+
+/** Highest physical address the frames can describe: 64 GB with PAE */
+#ifdef PAGING_PAE
+#define PAGE_FRAME_LIMIT    0x1000000000ull
+#else
+#define PAGE_FRAME_LIMIT    0x100000000ull
+#endif
+
+/** No frame, end of a free area */
+#define PAGE_FRAME_NONE     0xFFFFFFFFu
+
+/**
+ * Memory zones. A request names the highest zone it can use, and falls back
+ * to the lower zones in order: high, normal, then DMA.
+ */
+enum page_zone {
+    PAGE_ZONE_DMA,      /* Below 16 MB, reachable by ISA DMA */
+    PAGE_ZONE_NORMAL,   /* Mapped at KERNEL_BASE for good */
+    PAGE_ZONE_HIGH      /* Only reachable once mapped */
+};
+#define PAGE_ZONES          3
+
+/**
+ * Zone limits. The last 128 MB of the kernel address space are left for
+ * other mappings. Both are 4 MB aligned: blocks never straddle two zones.
+ */
+#define PAGE_ZONE_DMA_END       0x1000000ull
+#define PAGE_ZONE_NORMAL_END    0x38000000ull
+
+/**
+ * Lifetime of an allocation. Each pageblock serves one lifetime, so that
+ * pinned frames are packed in a few pageblocks instead of being scattered
+ * between short lived ones: once those are freed, large blocks merge again.
+ */
+enum page_lifetime {
+    PAGE_LIFETIME_PINNED,       /* Kernel objects, held until freed */
+    PAGE_LIFETIME_RECLAIMABLE,  /* Caches, given back under memory pressure */
+    PAGE_LIFETIME_MOVABLE       /* Short lived data, or data that can move */
+};
+#define PAGE_LIFETIMES      3
+
+/** Pageblock: the grouping unit, a block of the largest order */
+#define PAGE_BLOCK_ORDER    PAGE_MAX_ORDER
+#define PAGE_BLOCK_FRAMES   (1u << PAGE_BLOCK_ORDER)
+
+/** Frame descriptor flags */
+#define PAGE_FRAME_HEAD     0x01    /* A block begins at this frame */
+#define PAGE_FRAME_FREE     0x02    /* The block is in a free area */
+
+/**
+ * Page frame descriptor: 12 bytes per 4 kB frame. Free areas are chained
+ * through the descriptors, free frames are never written.
+ */
+struct page_frame {
+    uint32_t next;      /* Free area links, as frame numbers */
+    uint32_t prev;
+    uint8_t order;      /* Order of the block beginning at this frame */
+    uint8_t flags;
+    uint8_t lifetime;   /* Lifetime served by the pageblock, in its first frame */
+};
+
+/**
+ * Zone state. Watermarks are in frames: a zone under its low watermark is
+ * only used once the other zones are too, no allocation takes it under its
+ * min watermark. Allocations falling back from a higher zone also have to
+ * leave the reserve free.
+ */
+struct frame_zone {
+    uint32_t freeAreas[PAGE_LIFETIMES][PAGE_MAX_ORDER + 1]; /* Free areas heads */
+    uint32_t freeOrders[PAGE_LIFETIMES];    /* Bit order set for a non empty area */
+    uint32_t freeFrames;
+    uint32_t presentFrames;                 /* Frames given to the zone */
+    uint32_t minFrames;
+    uint32_t lowFrames;
+    uint32_t reserveFrames;
+};
+
+/**
+ * Buddy allocator of physical frames. Blocks are 2^order contiguous frames
+ * aligned on their size. Only frames given with addRange() are handed out,
+ * frame 0 never is: a null address means the allocation failed.
+ *
+ * Free blocks are kept in the free areas of the lifetime of their
+ * pageblock. Pageblocks start movable. When a lifetime has no free block
+ * left, it takes the largest block of another lifetime, and the whole
+ * pageblock with it. Movable requests only take pageblocks half free.
+ */
+class PageFrameAllocator {
+    private:
+        /** Singleton implementation */
+        static PageFrameAllocator *mInstance;
+
+        /** One descriptor per frame */
+        struct page_frame *mFrames;
+        uint32_t mFrameCount;
+
+        /** Free areas and watermarks of each zone */
+        struct frame_zone mZones[PAGE_ZONES];
+
+        /** Count of free frames, in all zones */
+        uint32_t mFreeFrames;
+
+        /** Zone a frame belongs to */
+        struct frame_zone *zoneOf(uint32_t frame);
+
+        /** Tell if a zone can serve a block and keep a free frames count */
+        bool zoneFits(struct frame_zone *zone, uint32_t order, uint32_t mark);
+
+        /** Lifetime served by the pageblock of a frame */
+        uint32_t lifetimeOf(uint32_t frame);
+
+        /** Free areas maintenance, in the areas of a lifetime */
+        bool isFreeBlock(uint32_t frame, uint32_t order);
+        void insertBlock(uint32_t frame, uint32_t order, uint32_t lifetime);
+        void removeBlock(uint32_t frame, uint32_t lifetime);
+
+        /**
+         * Find the free block a lifetime with no block of its own takes:
+         * the largest one of the other lifetimes. Its pageblock is given
+         * to the lifetime, unless it is movable and less than half of the
+         * pageblock is free.
+         * @return the first frame of the block
+         */
+        uint32_t stealBlock(struct frame_zone *zone, uint32_t order,
+                            enum page_lifetime lifetime);
+
+        /** Count the free frames of the pageblock of a frame */
+        uint32_t pageBlockFreeFrames(uint32_t frame);
+
+        /** Give a pageblock and its free blocks to a lifetime */
+        void claimPageBlock(uint32_t frame, enum page_lifetime lifetime);
+
+        /** Give back a block, merging it with its free buddies */
+        void freeBlock(uint32_t frame, uint32_t order);
+
+    public:
+        /**
+         * Create an allocator with no free frame.
+         * @param frames the descriptor table, frameCount entries
+         * @param frameCount the count of frames from physical address 0
+         */
+        PageFrameAllocator(struct page_frame *frames, uint32_t frameCount);
+
+        /**
+         * Give a physical memory range to the allocator. Only the whole
+         * frames inside the range are used.
+         * @param address the physical address of the range
+         * @param length the length of the range
+         */
+        void addRange(uint64_t address, uint64_t length);
+
+        /**
+         * Allocate 2^order contiguous frames. Zones above their low
+         * watermark are tried first, from the highest usable one down,
+         * then zones above their min watermark.
+         * @param order the order of the block, up to PAGE_MAX_ORDER
+         * @param zone the highest zone the frames can be taken from
+         * @param lifetime the expected lifetime of the frames, picking the
+         *                 pageblocks they are taken from
+         * @return the physical address of the first frame, 0 if there is
+         *         no free block big enough
+         */
+        uint64_t allocPages(uint32_t order, enum page_zone zone = PAGE_ZONE_NORMAL,
+                            enum page_lifetime lifetime = PAGE_LIFETIME_PINNED);
+
+        /**
+         * Give back frames obtained from allocPages.
+         * @param address the address returned by allocPages
+         */
+        void freePages(uint64_t address);
+
+        /**
+         * Give back frames, checking the order matches the allocated one.
+         */
+        void freePages(uint64_t address, uint32_t order);
+
+        /**
+         * Set the watermarks of a zone up, all counts in frames.
+         * @param zone the zone
+         * @param minFrames the free frames no allocation takes
+         * @param lowFrames the free frames under which other zones are
+         *                  used first, at least minFrames
+         * @param reserveFrames the free frames allocations from higher
+         *                      zones leave on top of the watermarks
+         */
+        void setWatermarks(enum page_zone zone, uint32_t minFrames,
+                           uint32_t lowFrames, uint32_t reserveFrames);
+
+        /**
+         * Set the watermarks of all zones from their size: a small min
+         * watermark, and a reserve of the low zones against the higher
+         * ones proportional to their size.
+         */
+        void setDefaultWatermarks(void);
+
+        /** Accessors */
+        uint32_t frameCount(void);
+        uint32_t freeFrames(void);
+        uint32_t freeFrames(enum page_zone zone);
+        uint32_t presentFrames(enum page_zone zone);
+
+        /**
+         * Count the free blocks of an order in all zones and lifetimes.
+         * Walks the free areas: for statistics only.
+         */
+        uint32_t freeBlocks(uint32_t order);
+
+        /**
+         * Get the lifetime a pageblock serves.
+         * @param address a physical address in the pageblock
+         */
+        enum page_lifetime pageBlockLifetime(uint64_t address);
+
+        /**
+         * Build the allocator from the free memory of the physical memory
+         * map. The descriptor table is taken from free memory of the
+         * normal zone, the first megabyte and the kernel image are left
+         * alone. Zones get their
+         * default watermarks.
+         * @param map the physical memory map
+         * @param imageStart the physical address of the kernel image
+         * @param imageEnd the physical end of the kernel image
+         * @param limit the physical address frames stop at, for kernels
+         *              that can't reach memory up to PAGE_FRAME_LIMIT
+         * @return the allocator, also available with getInstance()
+         */
+        static PageFrameAllocator *setup(PhysicalMemoryMap *map,
+                                         uint64_t imageStart,
+                                         uint64_t imageEnd,
+                                         uint64_t limit = PAGE_FRAME_LIMIT);
+
+        /**
+         * Singleton implementation: the allocator built by setup(), NULL
+         * before.
+         */
+        static PageFrameAllocator *getInstance(void);
+};
+
+#endif /* _PAGE_FRAME_ALLOCATOR_H_ */
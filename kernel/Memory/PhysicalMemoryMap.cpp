@@ -2,127 +2,266 @@
  * Copyright (C) 2012, the Simple Object Kernel project.
  * by Damien Dejean <djod4556@yahoo.fr>
  *
- * PhysicalMemoryMap.cpp: Implementation of a list that describes the 
- * physical memory map of a computer. This list is made of memory chunk
- * descriptors that are chained together. Internally they are bigger than
- * the structure described in the header file. There's a chain field and
- * a magic value to ensure that the chunk have not been corrupted by
- * bad manipulation.
- *
- * Chunks are allocated into the bootstrap allocator by us, and freed by
- * us too. If a memory corruption is detected an assertion is raised.
+ * PhysicalMemoryMap.cpp: Implementation of the array that describes the
+ * physical memory map of a computer. Chunks are kept sorted by address and
+ * never overlap, so the chunk of an address is found by a binary search.
+ * A map holds a few tens of chunks at most: inserting by moving the tail
+ * of the array is cheap, and the array is contiguous for lookups.
  */
 
 #include "assert.h"
 #include "string.h"
-#include "stdio.h"
 #include "PhysicalMemoryMap.h"
 
-/** Internal struct to be able to chain chunks between them */
-struct chained_memory_chunk {
-    struct memory_chunk base;
-    uint32_t magic;
-    struct chained_memory_chunk *next;
-};
 
-/** Magic to control integrity */
-#define     CHUNK_MAGIC     0xCAFEBABEu
+/**
+ * Rank statuses by restriction: where chunks overlap, the most restrictive
+ * one tells what the memory is.
+ */
+static int restriction(enum chunk_status status)
+{
+    switch (status) {
+        case FREE_MEMORY:
+            return 0;
+        case UNKNOWN_MEMORY:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+/**
+ * Pick the most restrictive of two statuses.
+ */
+static enum chunk_status moreRestrictive(enum chunk_status a, enum chunk_status b)
+{
+    return (restriction(b) > restriction(a)) ? b : a;
+}
 
 
-PhysicalMemoryMap::PhysicalMemoryMap()
+PhysicalMemoryMap::PhysicalMemoryMap():
+    mCount(0)
 {
-    mAllocator = BootstrapAllocator::getInstance();
-    mList = (struct chained_memory_chunk*) NULL;
-    mCurrent = (struct chained_memory_chunk*) NULL;
-    mCount = 0;
 }
 
 PhysicalMemoryMap::~PhysicalMemoryMap()
 {
     clear();
-    mAllocator = NULL;
 }
 
 
-struct memory_chunk* PhysicalMemoryMap::getFreeChunk(void)
+int PhysicalMemoryMap::floor(uint64_t address) const
+{
+    int low, high, middle;
+
+    /* Invariant: chunks before low begin at or before the address */
+    low = 0;
+    high = mCount;
+    while (low < high) {
+        middle = (low + high) / 2;
+        if (mChunks[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low - 1;
+}
+
+
+void PhysicalMemoryMap::addChunk(const struct memory_chunk *chunk)
 {
-    struct chained_memory_chunk *cmc;
+    int index;
+
+    assert(chunk != NULL);
+    assert(mCount < MEMORY_MAP_CAPACITY);
 
-    /* Prepare chunk */
-    cmc = (struct chained_memory_chunk*) mAllocator->alloc(sizeof(*cmc));
-    assert(cmc != NULL);
-    memset(cmc, 0, sizeof(*cmc));
-    cmc->magic = CHUNK_MAGIC;
-    cmc->base.status = UNKNOWN_MEMORY;
+    /* Insert after the last chunk beginning before it */
+    index = floor(chunk->address) + 1;
+    assert(index == 0 || mChunks[index - 1].address + mChunks[index - 1].length <= chunk->address);
+    assert(index == mCount || chunk->address + chunk->length <= mChunks[index].address);
 
-    /* Count one more */
+    memmove(&mChunks[index + 1], &mChunks[index], (mCount - index) * sizeof(struct memory_chunk));
+    mChunks[index] = *chunk;
     mCount++;
+}
+
 
-    return (struct memory_chunk*)cmc;
+void PhysicalMemoryMap::clear(void)
+{
+    mCount = 0;
 }
 
 
-void PhysicalMemoryMap::addChunk(struct memory_chunk *chunk)
+void PhysicalMemoryMap::build(const struct memory_chunk *chunks, int count)
 {
-    struct chained_memory_chunk *cmc;
+    uint64_t bounds[2 * MEMORY_MAP_MAX_CHUNKS];
+    uint64_t bound, start, end;
+    struct memory_chunk *tail;
+    enum chunk_status status;
+    int boundCount;
+    int covered;
+    int i, j;
 
-    /* Check chunk */
-    assert(chunk != NULL);
-    cmc = (struct chained_memory_chunk*) chunk;
-    assert(cmc->magic == CHUNK_MAGIC);
+    assert(count >= 0 && count <= MEMORY_MAP_MAX_CHUNKS);
+    clear();
+
+    /* Sorted list of all chunk limits */
+    boundCount = 0;
+    for (i = 0; i < count; i++) {
+        if (chunks[i].length == 0) {
+            continue;
+        }
+        bounds[boundCount++] = chunks[i].address;
+        bounds[boundCount++] = chunks[i].address + chunks[i].length;
+    }
+    for (i = 1; i < boundCount; i++) {
+        bound = bounds[i];
+        for (j = i; j > 0 && bounds[j - 1] > bound; j--) {
+            bounds[j] = bounds[j - 1];
+        }
+        bounds[j] = bound;
+    }
 
-    /* Chain it as head of the list */
-    cmc->next = mList;
-    mList = cmc;
-    mCurrent = mList;
+    /* Between two limits, memory has one status: append it, or merge it */
+    tail = NULL;
+    for (i = 0; i + 1 < boundCount; i++) {
+        start = bounds[i];
+        end = bounds[i + 1];
+        if (start == end) {
+            continue;
+        }
+
+        covered = 0;
+        status = FREE_MEMORY;
+        for (j = 0; j < count; j++) {
+            if (chunks[j].address <= start && chunks[j].address + chunks[j].length >= end) {
+                status = covered ? moreRestrictive(status, chunks[j].status) : chunks[j].status;
+                covered = 1;
+            }
+        }
+        if (!covered) {
+            continue;
+        }
+
+        if (tail != NULL && tail->status == status && tail->address + tail->length == start) {
+            tail->length = end - tail->address;
+            continue;
+        }
+
+        assert(mCount < MEMORY_MAP_CAPACITY);
+        tail = &mChunks[mCount++];
+        tail->address = start;
+        tail->length = end - start;
+        tail->status = status;
+    }
 }
 
 
-void PhysicalMemoryMap::clear(void)
+const struct memory_chunk *PhysicalMemoryMap::lookup(uint64_t address) const
 {
-    /* Empty the list */
-    for (mCurrent = mList; 
-         mList != NULL; 
-         mCurrent = mList->next, mList = mList->next)
-    {
-        assert(mCurrent->magic == CHUNK_MAGIC);
-        mAllocator->free(mCurrent, sizeof(*mCurrent));
-        mCount--;
+    int index = floor(address);
+
+    if (index < 0 || address - mChunks[index].address >= mChunks[index].length) {
+        return NULL;
     }
-    mList = NULL;
-    mCurrent = NULL;
-    /* Check there's no memory leak */
-    assert(mCount == 0);
+    return &mChunks[index];
 }
 
 
-struct memory_chunk* PhysicalMemoryMap::current(void)
+enum chunk_status PhysicalMemoryMap::rangeStatus(uint64_t address, uint64_t length) const
 {
-   if (mCurrent != NULL) {
-       assert(mCurrent->magic == CHUNK_MAGIC);
-   }
-   return (struct memory_chunk*) mCurrent;
+    enum chunk_status status;
+    uint64_t end, reach;
+    int index;
+
+    assert(length > 0);
+
+    /* Status of the beginning of the range, holes are unknown memory */
+    index = floor(address);
+    if (index >= 0 && address - mChunks[index].address < mChunks[index].length) {
+        status = mChunks[index].status;
+        reach = mChunks[index].address + mChunks[index].length;
+    } else {
+        status = UNKNOWN_MEMORY;
+        reach = address;
+    }
+
+    /* Walk the chunks up to the end of the range */
+    end = address + length;
+    while (reach < end) {
+        index++;
+        if (index == mCount || mChunks[index].address >= end) {
+            status = moreRestrictive(status, UNKNOWN_MEMORY);
+            break;
+        }
+        if (mChunks[index].address != reach) {
+            status = moreRestrictive(status, UNKNOWN_MEMORY);
+        }
+        status = moreRestrictive(status, mChunks[index].status);
+        reach = mChunks[index].address + mChunks[index].length;
+    }
+    return status;
 }
 
 
-bool PhysicalMemoryMap::next(void)
+uint64_t PhysicalMemoryMap::carve(uint64_t length, uint64_t align, uint64_t above, uint64_t below)
 {
-    if (mCurrent != NULL) {
-        assert(mCurrent->magic == CHUNK_MAGIC);
-        mCurrent = mCurrent->next;
-        if (mCurrent == NULL) {
-            return false;
-        } else {
-            return true;
+    struct memory_chunk *chunk;
+    uint64_t start, end, head, tail;
+    int pieces;
+    int i;
+
+    assert(length > 0 && align != 0 && (align & (align - 1)) == 0);
+
+    for (i = 0; i < mCount; i++) {
+        chunk = &mChunks[i];
+        start = (chunk->address > above) ? chunk->address : above;
+        start = (start + align - 1) & ~(align - 1);
+        start = (start == 0) ? align : start;
+        end = chunk->address + chunk->length;
+        end = (end < below) ? end : below;
+        if (chunk->status != FREE_MEMORY || start >= end || end - start < length) {
+            continue;
         }
-    } else {
-        return false;
+
+        /* Cut the chunk in up to three: free, reserved, free */
+        head = start - chunk->address;
+        tail = chunk->address + chunk->length - (start + length);
+        pieces = 1 + (head > 0) + (tail > 0);
+        assert(mCount + pieces - 1 <= MEMORY_MAP_CAPACITY);
+        memmove(chunk + pieces, chunk + 1, (mCount - i - 1) * sizeof(struct memory_chunk));
+        mCount += pieces - 1;
+
+        if (head > 0) {
+            chunk->length = head;
+            chunk++;
+        }
+        chunk->address = start;
+        chunk->length = length;
+        chunk->status = RESERVED_MEMORY;
+        if (tail > 0) {
+            chunk[1].address = start + length;
+            chunk[1].length = tail;
+            chunk[1].status = FREE_MEMORY;
+        }
+        return start;
     }
+    return 0;
 }
 
 
-void PhysicalMemoryMap::rewind(void)
+int PhysicalMemoryMap::count(void) const
 {
-    mCurrent = mList;
+    return mCount;
 }
 
+PhysicalMemoryMap::iterator PhysicalMemoryMap::begin(void) const
+{
+    return &mChunks[0];
+}
+
+PhysicalMemoryMap::iterator PhysicalMemoryMap::end(void) const
+{
+    return &mChunks[mCount];
+}
@@ -10,7 +10,6 @@
 #define _PHYSICAL_MEMORY_MAP_H_
 
 #include "stdint.h"
-#include "BootstrapAllocator.h"
 
 /** Status of a physical memory chunk */
 enum chunk_status {
@@ -19,6 +18,12 @@ enum chunk_status {
     UNKNOWN_MEMORY
 };
 
+/** Most chunks a memory map can be built from at once */
+#define MEMORY_MAP_MAX_CHUNKS   64
+
+/** Most chunks a memory map holds: built chunks can be cut by overlaps */
+#define MEMORY_MAP_CAPACITY     (2 * MEMORY_MAP_MAX_CHUNKS)
+
 /** Descriptor of a physical memory chunk */
 struct memory_chunk {
     uint64_t            address;
@@ -26,70 +31,87 @@ struct memory_chunk {
     enum chunk_status   status;
 };
 
-/** Forward declaration for chained chunks */
-struct chained_memory_chunk;
-
 /**
- * Provides a list of physical memory chunks. The class implements two
- * interfaces. One designed for the factory which will build the object,
- * the second one designed for the user of the memory map, presented as
- * an iterator.
+ * Provides a sorted array of physical memory chunks that don't overlap.
+ * The map is built once at boot, then queried: what the status of an
+ * address or a range is, in O(log n). Chunks are walked with begin() and
+ * end(), which leave the map untouched and fit C++11 range-for loops.
  */
 class PhysicalMemoryMap {
     private:
-        /** The allocator we'll get the descriptors */
-        BootstrapAllocator *mAllocator;
-
-        /** Head of the descriptor list */
-        struct chained_memory_chunk *mList;
-
-        /** Cursor to the current analyzed chunk */
-        struct chained_memory_chunk *mCurrent;
-
-        /** Count of the number off allocated descriptors */
+        /** Chunks, sorted by address */
+        struct memory_chunk mChunks[MEMORY_MAP_CAPACITY];
         int mCount;
 
+        /**
+         * Find the last chunk beginning at or before an address.
+         * @return its index, -1 if all chunks begin after the address
+         */
+        int floor(uint64_t address) const;
+
     public:
+        /** Chunk iterator */
+        typedef const struct memory_chunk *iterator;
+
         PhysicalMemoryMap(void);
         ~PhysicalMemoryMap(void);
 
         /**
-         * Obtain a chunk descriptor.
-         * @return an empty memory chunk descriptor.
+         * Add a chunk to the map, at its place in the address order.
+         * @param chunk the chunk to copy, must not overlap the chunks of
+         *              the map: use build() for firmware provided chunks.
          */
-        struct memory_chunk *getFreeChunk(void);
-        
+        void addChunk(const struct memory_chunk *chunk);
+
         /**
-         * Add a filled chunk descriptor to the descriptor list.
-         * @param chunk the chunk to add.
+         * Empty the map.
          */
-        void addChunk(struct memory_chunk *chunk);
+        void clear(void);
 
         /**
-         * Empty the descriptor list.
+         * Replace the content of the map with chunks as a firmware reports
+         * them: unsorted, overlapping or adjacent. The map is then sorted by
+         * address, overlapping parts take the most restrictive status and
+         * adjacent chunks of the same status are merged.
+         * @param chunks the chunks, empty ones are ignored
+         * @param count the count of chunks, up to MEMORY_MAP_MAX_CHUNKS
          */
-        void clear(void);
+        void build(const struct memory_chunk *chunks, int count);
 
         /**
-         * Get the current chunk descriptor of the iterator.
-         * @return a memory chunk descriptor pointed by the iterator,
-         *         NULL if we are at the end of the list or if the list
-         *         is empty.
+         * Find the chunk holding an address.
+         * @param address a physical address
+         * @return the chunk, NULL if the address is in no chunk.
          */
-        struct memory_chunk *current(void);
+        const struct memory_chunk *lookup(uint64_t address) const;
 
         /**
-         * Move the iterator cursor forward, to the next chunk descriptor.
-         * @return true if the referenced descriptor is valid, false if we are
-         *         at the end of the list (corollary: a call to current() will
-         *         return NULL). 
+         * Get the status of a range of memory.
+         * @param address the beginning of the range
+         * @param length the length of the range, not null
+         * @return the most restrictive status of the chunks in the range,
+         *         UNKNOWN_MEMORY if a part of the range is in no chunk.
          */
-        bool next(void);
+        enum chunk_status rangeStatus(uint64_t address, uint64_t length) const;
 
         /**
-         * Reset the iterator reinding the cursor at the head of the list.
+         * Take a range of free memory for the kernel before any allocator
+         * runs: the lowest fitting range becomes reserved memory.
+         * @param length the length of the range
+         * @param align the alignment of the range, a power of two
+         * @param above the lowest address the range may begin at
+         * @param below the address the range must end at or below
+         * @return the address of the range, 0 if no free chunk fits:
+         *         memory at address 0 is never carved
          */
-        void rewind(void);
+        uint64_t carve(uint64_t length, uint64_t align, uint64_t above, uint64_t below);
+
+        /** Count of chunks in the map */
+        int count(void) const;
+
+        /** Chunk iteration, in address order */
+        iterator begin(void) const;
+        iterator end(void) const;
 };
 
 #endif /*_PHYSICAL_MEMORY_MAP_ */
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * SlabCache.cpp: object cache implementation. A slab is a buddy block
+ * starting with its descriptor, followed by a stack of free object indexes
+ * and the objects themselves:
+ *
+ *  +------------+-------------------------+--------+--------+-----+
+ *  | struct slab| free indexes (uint16_t) | obj 0  | obj 1  | ... |
+ *  +------------+-------------------------+--------+--------+-----+
+ *
+ * Free objects are tracked out of the objects, so their constructed state
+ * is kept between a free and the next allocation. Slabs are aligned on their
+ * size inside the allocator heap, the slab of an object is found by masking
+ * its offset in the heap.
+ */
+
+#include "assert.h"
+#include "SlabCache.h"
+
+/** Slab descriptor, at the beginning of each slab */
+struct slab {
+    struct slab *next;
+    struct slab *prev;
+    SlabCache *cache;
+    uint32_t freeCount;
+};
+
+/** Stack of free object indexes of a slab */
+#define SLAB_FREE_STACK(s)      ((uint16_t*) ((s) + 1))
+
+/** Round a size up to an alignment, a power of two */
+#define SLAB_ALIGN(n, align)    (((n) + (align) - 1) & ~((size_t) (align) - 1))
+
+/**
+ * Chain a slab as head of a list.
+ */
+static void slabLink(struct slab **list, struct slab *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+/**
+ * Take a slab out of a list.
+ */
+static void slabUnlink(struct slab **list, struct slab *slab)
+{
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+/**
+ * Fit as many objects as possible in a slab, after its descriptor and its
+ * stack of free indexes.
+ * @param slabSize the size of the slab
+ * @param objectSize the size of the objects, a multiple of align
+ * @param align the alignment of the objects
+ * @param offset returns the offset of the first object in the slab
+ * @return the count of objects
+ */
+static uint32_t slabGeometry(size_t slabSize, size_t objectSize, size_t align, uint32_t *offset)
+{
+    uint32_t objects;
+
+    objects = (slabSize - sizeof(struct slab)) / (objectSize + sizeof(uint16_t));
+    if (objects > 0xFFFF) {
+        objects = 0xFFFF;
+    }
+    do {
+        *offset = SLAB_ALIGN(sizeof(struct slab) + objects * sizeof(uint16_t), align);
+        if (*offset + objects * objectSize <= slabSize) {
+            break;
+        }
+        objects--;
+    } while (1);
+    return objects;
+}
+
+
+SlabCache::SlabCache(BuddyAllocator *allocator,
+                     const char *name,
+                     size_t objectSize,
+                     void (*constructor)(void *object)):
+    mAllocator(allocator),
+    mName(name),
+    mConstructor(constructor),
+    mPartial(NULL),
+    mFull(NULL),
+    mEmpty(NULL),
+    mEmptyCount(0),
+    mSlabCount(0),
+    mObjectsInUse(0)
+{
+    uint32_t power, last, objects, offset;
+    size_t align, size, left, leftBest;
+
+    assert(allocator != NULL);
+    assert(objectSize > 0);
+
+    /*
+     * The alignment of an object divides its size: objects are aligned on
+     * the largest power of two dividing their size, up to a pointer, and
+     * need no padding.
+     */
+    align = objectSize & -objectSize;
+    align = (align > sizeof(void*)) ? sizeof(void*) : align;
+    mObjectSize = objectSize;
+
+    /* Smallest slab big enough to hold some objects, with their free index */
+    power = BuddyAllocator::powerFromSize(sizeof(struct slab)
+                                          + SLAB_MIN_OBJECTS * (mObjectSize + sizeof(uint16_t)));
+    power = (power < SLAB_MIN_POWER) ? SLAB_MIN_POWER : power;
+    mSlabSize = (size_t) 1 << power;
+    mObjectsPerSlab = slabGeometry(mSlabSize, mObjectSize, align, &mObjectsOffset);
+    leftBest = mSlabSize - mObjectsOffset - mObjectsPerSlab * mObjectSize;
+
+    /* A larger slab is taken if it leaves a smaller part of itself unused */
+    for (last = power + SLAB_EXTRA_ORDERS, power++; power <= last; power++) {
+        size = (size_t) 1 << power;
+        objects = slabGeometry(size, mObjectSize, align, &offset);
+        left = size - offset - objects * mObjectSize;
+        if (left * mSlabSize < leftBest * size) {
+            mSlabSize = size;
+            mObjectsPerSlab = objects;
+            mObjectsOffset = offset;
+            leftBest = left;
+        }
+    }
+    assert(mObjectsPerSlab >= SLAB_MIN_OBJECTS);
+}
+
+SlabCache::~SlabCache(void)
+{
+    /* Check there's no memory leak */
+    assert(mObjectsInUse == 0);
+    reap();
+    assert(mSlabCount == 0);
+    mAllocator = NULL;
+}
+
+
+struct slab *SlabCache::grow(void)
+{
+    struct slab *slab;
+    uint16_t *stack;
+    char *objects;
+    uint32_t i;
+
+    slab = (struct slab*) mAllocator->alloc(mSlabSize);
+    if (slab == NULL) {
+        return NULL;
+    }
+    mSlabCount++;
+
+    /* First objects are on top of the stack */
+    slab->cache = this;
+    stack = SLAB_FREE_STACK(slab);
+    slab->freeCount = mObjectsPerSlab;
+    for (i = 0; i < mObjectsPerSlab; i++) {
+        stack[i] = (uint16_t) (mObjectsPerSlab - 1 - i);
+    }
+
+    /* Construct all objects */
+    if (mConstructor != NULL) {
+        objects = (char*) slab + mObjectsOffset;
+        for (i = 0; i < mObjectsPerSlab; i++) {
+            mConstructor(objects + i * mObjectSize);
+        }
+    }
+
+    return slab;
+}
+
+void SlabCache::release(struct slab *slab)
+{
+    mAllocator->free(slab);
+    mSlabCount--;
+}
+
+struct slab *SlabCache::slabOf(void *object)
+{
+    char *heap = mAllocator->heapBase();
+
+    return (struct slab*) (heap + (((char*) object - heap) & ~(mSlabSize - 1)));
+}
+
+
+void *SlabCache::alloc(void)
+{
+    struct slab *slab;
+    uint16_t index;
+
+    /* Fill partial slabs first, then reuse an empty one */
+    slab = mPartial;
+    if (slab == NULL) {
+        if (mEmpty != NULL) {
+            slab = mEmpty;
+            slabUnlink(&mEmpty, slab);
+            mEmptyCount--;
+        } else {
+            slab = grow();
+            if (slab == NULL) {
+                return NULL;
+            }
+        }
+        slabLink(&mPartial, slab);
+    }
+
+    index = SLAB_FREE_STACK(slab)[--slab->freeCount];
+    if (slab->freeCount == 0) {
+        slabUnlink(&mPartial, slab);
+        slabLink(&mFull, slab);
+    }
+    mObjectsInUse++;
+
+    return (char*) slab + mObjectsOffset + index * mObjectSize;
+}
+
+void SlabCache::free(void *object)
+{
+    struct slab *slab;
+    uint32_t offset;
+
+    if (object == NULL) {
+        return;
+    }
+
+    /* Check the object belongs to one of our slabs */
+    slab = slabOf(object);
+    offset = (char*) object - ((char*) slab + mObjectsOffset);
+    assert((char*) object >= (char*) slab + mObjectsOffset);
+    assert(offset % mObjectSize == 0 && offset / mObjectSize < mObjectsPerSlab);
+    assert(slab->cache == this);
+    assert(slab->freeCount < mObjectsPerSlab);
+
+    if (slab->freeCount == 0) {
+        slabUnlink(&mFull, slab);
+        slabLink(&mPartial, slab);
+    }
+    SLAB_FREE_STACK(slab)[slab->freeCount++] = (uint16_t) (offset / mObjectSize);
+    mObjectsInUse--;
+
+    /* Keep a few empty slabs, give the others back */
+    if (slab->freeCount == mObjectsPerSlab) {
+        slabUnlink(&mPartial, slab);
+        if (mEmptyCount < SLAB_MAX_EMPTY) {
+            slabLink(&mEmpty, slab);
+            mEmptyCount++;
+        } else {
+            release(slab);
+        }
+    }
+}
+
+void SlabCache::reap(void)
+{
+    struct slab *slab;
+
+    while (mEmpty != NULL) {
+        slab = mEmpty;
+        slabUnlink(&mEmpty, slab);
+        release(slab);
+    }
+    mEmptyCount = 0;
+}
+
+
+SlabCache *SlabCache::cacheOf(void *slab)
+{
+    return ((struct slab*) slab)->cache;
+}
+
+
+const char *SlabCache::name(void)
+{
+    return mName;
+}
+
+size_t SlabCache::objectSize(void)
+{
+    return mObjectSize;
+}
+
+size_t SlabCache::slabSize(void)
+{
+    return mSlabSize;
+}
+
+uint32_t SlabCache::objectsPerSlab(void)
+{
+    return mObjectsPerSlab;
+}
+
+uint32_t SlabCache::slabCount(void)
+{
+    return mSlabCount;
+}
+
+uint32_t SlabCache::objectsInUse(void)
+{
+    return mObjectsInUse;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * SlabCache.h: object cache for small fixed-size objects, built on slabs
+ * carved from a buddy allocator.
+ */
+
+#ifndef _SLAB_CACHE_H_
+#define _SLAB_CACHE_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "BuddyAllocator.h"
+
+/** Smallest slab: 2^SLAB_MIN_POWER bytes */
+#define SLAB_MIN_POWER      12
+
+/** Larger slab orders tried when the smallest one leaves space unused */
+#define SLAB_EXTRA_ORDERS   2
+
+/** Minimum count of objects a slab must hold */
+#define SLAB_MIN_OBJECTS    8
+
+/** Count of empty slabs a cache keeps before giving them back */
+#define SLAB_MAX_EMPTY      1
+
+/** Forward declaration of the slab descriptor */
+struct slab;
+
+/**
+ * Cache of same-size objects. Slabs are buddy blocks split into objects,
+ * kept in three lists depending on their usage: partial, full and empty.
+ * Objects are handed out from partial slabs first, so that empty slabs can
+ * be given back to the allocator.
+ *
+ * An optional constructor is applied to every object when its slab is
+ * created. A freed object must be returned in its constructed state, the
+ * cache never writes into objects.
+ */
+class SlabCache {
+    private:
+        /** The allocator we get the slabs from */
+        BuddyAllocator *mAllocator;
+
+        /** Name of the cache, for debug */
+        const char *mName;
+
+        /** Object constructor, may be NULL */
+        void (*mConstructor)(void *object);
+
+        /** Geometry of the slabs */
+        size_t mObjectSize;
+        size_t mSlabSize;
+        uint32_t mObjectsPerSlab;
+        uint32_t mObjectsOffset;
+
+        /** Slab lists */
+        struct slab *mPartial;
+        struct slab *mFull;
+        struct slab *mEmpty;
+        uint32_t mEmptyCount;
+
+        /** Usage counters */
+        uint32_t mSlabCount;
+        uint32_t mObjectsInUse;
+
+        /** Slab life cycle */
+        struct slab *grow(void);
+        void release(struct slab *slab);
+
+        /** Find the slab holding an object */
+        struct slab *slabOf(void *object);
+
+    public:
+        /**
+         * Create an object cache. No memory is taken until the first
+         * allocation.
+         * @param allocator the allocator slabs are taken from
+         * @param name the name of the cache
+         * @param objectSize the size of the objects
+         * @param constructor a function called on each object when its slab
+         *                    is created, may be NULL
+         */
+        SlabCache(BuddyAllocator *allocator,
+                  const char *name,
+                  size_t objectSize,
+                  void (*constructor)(void *object) = NULL);
+        ~SlabCache(void);
+
+        /**
+         * Get an object from the cache.
+         * @return a constructed object, NULL if the allocator is exhausted.
+         */
+        void *alloc(void);
+
+        /**
+         * Give back an object to the cache.
+         * @param object an object obtained from this cache.
+         */
+        void free(void *object);
+
+        /**
+         * Give all empty slabs back to the allocator.
+         */
+        void reap(void);
+
+        /**
+         * Find the cache owning a slab.
+         * @param slab the allocator chunk of a slab, as found by
+         *             BuddyAllocator::chunkOf() from one of its objects
+         * @return the cache the slab belongs to
+         */
+        static SlabCache *cacheOf(void *slab);
+
+        /** Accessors */
+        const char *name(void);
+        size_t objectSize(void);
+        size_t slabSize(void);
+        uint32_t objectsPerSlab(void);
+        uint32_t slabCount(void);
+        uint32_t objectsInUse(void);
+};
+
+#endif /* _SLAB_CACHE_H_ */
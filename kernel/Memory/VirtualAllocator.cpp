@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * VirtualAllocator.cpp: kernel virtual ranges implementation. Ranges are
+ * taken first fit in the gaps of the sorted array, each gap holding a range
+ * and its guard page. Reserving and releasing move the end of the array,
+ * like building a physical memory map; a fault only looks a range up.
+ *
+ * Demand frames are pinned frames, from the high zone when there is a kmap
+ * window to reach them. They are cleared before being mapped, so that a
+ * range never shows what its frames held before.
+ */
+
+#include "assert.h"
+#include "string.h"
+#include "new.h"
+#include "VirtualAllocator.h"
+
+/** Page of an address */
+#define PAGE_OF(address)    ((address) & PAGE_ADDRESS_MASK)
+
+/* False singleton implementation */
+VirtualAllocator *VirtualAllocator::mInstance = (VirtualAllocator*) NULL;
+static void *instance[(sizeof(VirtualAllocator) + sizeof(void*) - 1) / sizeof(void*)];
+
+
+VirtualAllocator::VirtualAllocator(AddressSpace *space, PageFrameAllocator *frames, HighMemory *high,
+                                   uint32_t start, uint32_t end):
+    mSpace(space),
+    mFrames(frames),
+    mHigh(high),
+    mStart(start),
+    mEnd(end),
+    mCount(0),
+    mReservedPages(0),
+    mBackedPages(0)
+{
+    assert(space != NULL && frames != NULL);
+    assert(((start | end) & ~PAGE_ADDRESS_MASK) == 0 && start != 0 && start < end);
+}
+
+
+int VirtualAllocator::floor(uint32_t address) const
+{
+    int low = 0;
+    int high = mCount - 1;
+    int middle;
+
+    while (low <= high) {
+        middle = low + (high - low) / 2;
+        if (mAreas[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return high;
+}
+
+
+uint32_t VirtualAllocator::reserve(uint32_t length, uint32_t flags)
+{
+    uint32_t address, needed;
+    int i;
+
+    if (length == 0 || length > mEnd - mStart || mCount == VIRTUAL_MAX_AREAS) {
+        return 0;
+    }
+    length = (length + PAGE_FRAME_SIZE - 1) & PAGE_ADDRESS_MASK;
+    needed = length + PAGE_FRAME_SIZE;
+
+    /* The lowest gap holding the range and its guard page */
+    address = mStart;
+    for (i = 0; i < mCount; i++) {
+        if (mAreas[i].address - address >= needed) {
+            break;
+        }
+        address = mAreas[i].address + mAreas[i].length + PAGE_FRAME_SIZE;
+    }
+    if (i == mCount && (address > mEnd || mEnd - address < needed)) {
+        return 0;
+    }
+
+    memmove(&mAreas[i + 1], &mAreas[i], (mCount - i) * sizeof(struct virtual_area));
+    mAreas[i].address = address;
+    mAreas[i].length = length;
+    mAreas[i].flags = flags & (PAGE_WRITE | PAGE_GLOBAL | VIRTUAL_DEMAND);
+    mCount++;
+    mReservedPages += length >> PAGE_FRAME_POWER;
+    return address;
+}
+
+void VirtualAllocator::release(uint32_t address)
+{
+    struct virtual_area *area;
+    uint64_t physical;
+    uint32_t page;
+    int i = floor(address);
+
+    assert(i >= 0 && mAreas[i].address == address);
+    area = &mAreas[i];
+
+    if (area->flags & VIRTUAL_DEMAND) {
+        for (page = area->address; page < area->address + area->length; page += PAGE_FRAME_SIZE) {
+            if (mSpace->translate(page, &physical)) {
+                mFrames->freePages(physical, 0);
+                mBackedPages--;
+            }
+        }
+        mSpace->unmap(area->address, area->length);
+    }
+
+    mReservedPages -= area->length >> PAGE_FRAME_POWER;
+    mCount--;
+    memmove(area, area + 1, (mCount - i) * sizeof(struct virtual_area));
+}
+
+const struct virtual_area *VirtualAllocator::lookup(uint32_t address) const
+{
+    int i = floor(address);
+
+    if (i < 0 || address - mAreas[i].address >= mAreas[i].length) {
+        return NULL;
+    }
+    return &mAreas[i];
+}
+
+
+bool VirtualAllocator::fault(uint32_t address, uint32_t error)
+{
+    const struct virtual_area *area = lookup(address);
+    uint64_t frame, physical;
+    void *page;
+
+    if (area == NULL || (area->flags & VIRTUAL_DEMAND) == 0 || (error & FAULT_PRESENT)) {
+        return false;
+    }
+    if ((error & FAULT_WRITE) && (area->flags & PAGE_WRITE) == 0) {
+        return false;
+    }
+
+    /* Already backed, another access got there first */
+    if (mSpace->translate(PAGE_OF(address), &physical)) {
+        return true;
+    }
+
+    frame = mFrames->allocPages(0, (mHigh != NULL) ? PAGE_ZONE_HIGH : PAGE_ZONE_NORMAL,
+                                PAGE_LIFETIME_PINNED);
+    if (frame == 0) {
+        return false;
+    }
+    page = (mHigh != NULL) ? mHigh->map(frame) : mSpace->window() + frame;
+    if (page == NULL) {
+        mFrames->freePages(frame, 0);
+        return false;
+    }
+    memset(page, 0, PAGE_FRAME_SIZE);
+    if (mHigh != NULL) {
+        mHigh->unmap(page);
+    }
+
+    if (mSpace->map(PAGE_OF(address), frame, PAGE_FRAME_SIZE, area->flags) != 0) {
+        mFrames->freePages(frame, 0);
+        return false;
+    }
+    mBackedPages++;
+    return true;
+}
+
+
+uint32_t VirtualAllocator::areaCount(void)
+{
+    return mCount;
+}
+
+uint32_t VirtualAllocator::reservedPages(void)
+{
+    return mReservedPages;
+}
+
+uint32_t VirtualAllocator::backedPages(void)
+{
+    return mBackedPages;
+}
+
+
+VirtualAllocator *VirtualAllocator::setup(void)
+{
+    mInstance = new (instance) VirtualAllocator(AddressSpace::getInstance(),
+                                                PageFrameAllocator::getInstance(),
+                                                HighMemory::getInstance(),
+                                                VIRTUAL_START, VIRTUAL_END);
+    return mInstance;
+}
+
+VirtualAllocator *VirtualAllocator::getInstance(void)
+{
+    return mInstance;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * VirtualAllocator.h: allocator of kernel virtual ranges, above the
+ * mapping of the normal zone. Ranges are reserved without memory, demand
+ * ranges get their frames on the first access to each page.
+ */
+
+#ifndef _VIRTUAL_ALLOCATOR_H_
+#define _VIRTUAL_ALLOCATOR_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "AddressSpace.h"
+#include "PageFrameAllocator.h"
+#include "HighMemory.h"
+
+/**
+ * Kernel virtual ranges: from the end of the normal zone mapping to the
+ * last 16 MB of the address space, kept for fixed mappings and the self
+ * map of the page directory.
+ */
+#define VIRTUAL_START       0xF8000000u
+#define VIRTUAL_END         0xFF000000u
+
+/** Most ranges reserved at once */
+#define VIRTUAL_MAX_AREAS   256
+
+/** Pages of a range are backed by the page fault handler */
+#define VIRTUAL_DEMAND      0x1000
+
+/** Page fault error code bits */
+#define FAULT_PRESENT       0x1     /* Protection violation, not a missing page */
+#define FAULT_WRITE         0x2
+
+/** Descriptor of a reserved range */
+struct virtual_area {
+    uint32_t address;
+    uint32_t length;    /* Whole pages, without the guard page */
+    uint32_t flags;     /* PAGE_WRITE, PAGE_GLOBAL and VIRTUAL_DEMAND */
+};
+
+/**
+ * Reserves page aligned ranges of kernel virtual addresses. Reserved
+ * ranges don't overlap: they are kept in a sorted array, a range is found
+ * from any of its addresses in O(log n). Each range is followed by an
+ * unmapped guard page, so that overflows fault instead of running into the
+ * next range.
+ *
+ * Nothing is mapped when a range is reserved. Demand ranges are backed
+ * page by page by fault(), with cleared frames: large tables only cost the
+ * pages that are used. Other ranges are mapped by their owner.
+ */
+class VirtualAllocator {
+    private:
+        /** Singleton implementation */
+        static VirtualAllocator *mInstance;
+
+        /** Where ranges are mapped, and where demand frames come from */
+        AddressSpace *mSpace;
+        PageFrameAllocator *mFrames;
+
+        /** Where demand frames are cleared, NULL to use the normal zone only */
+        HighMemory *mHigh;
+
+        /** Managed addresses */
+        uint32_t mStart;
+        uint32_t mEnd;
+
+        /** Reserved ranges, sorted by address */
+        struct virtual_area mAreas[VIRTUAL_MAX_AREAS];
+        int mCount;
+
+        /** Usage counters, in pages */
+        uint32_t mReservedPages;
+        uint32_t mBackedPages;
+
+        /**
+         * Find the last range beginning at or before an address.
+         * @return its index, -1 if all ranges begin after the address
+         */
+        int floor(uint32_t address) const;
+
+    public:
+        /**
+         * Create an allocator with no reserved range.
+         * @param space the address space ranges are mapped in
+         * @param frames the allocator of the demand frames
+         * @param high the kmap window demand frames are cleared through,
+         *             NULL to take them from the normal zone
+         * @param start the first managed address, page aligned
+         * @param end the end of the managed addresses, page aligned
+         */
+        VirtualAllocator(AddressSpace *space, PageFrameAllocator *frames, HighMemory *high,
+                         uint32_t start, uint32_t end);
+
+        /**
+         * Reserve a range, the lowest one that fits.
+         * @param length the length of the range, rounded up to whole pages
+         * @param flags the rights of the demand pages, PAGE_WRITE and
+         *              PAGE_GLOBAL, and VIRTUAL_DEMAND
+         * @return the address of the range, 0 if length is null, if there
+         *         is no room left or no descriptor left
+         */
+        uint32_t reserve(uint32_t length, uint32_t flags);
+
+        /**
+         * Give a range back. The frames backing a demand range are freed,
+         * the owner of another range must have unmapped it.
+         * @param address the address returned by reserve
+         */
+        void release(uint32_t address);
+
+        /**
+         * Find the range holding an address.
+         * @param address a virtual address
+         * @return the range, NULL if the address is in no range or in
+         *         the guard page of a range.
+         */
+        const struct virtual_area *lookup(uint32_t address) const;
+
+        /**
+         * Handle a page fault: back the page of a demand range with a
+         * cleared frame.
+         * @param address the faulting address
+         * @param error the error code of the fault, FAULT_PRESENT and
+         *              FAULT_WRITE
+         * @return true if the access can be retried, false if it is not in
+         *         a demand range, breaks the range rights, or if there is
+         *         no frame left.
+         */
+        bool fault(uint32_t address, uint32_t error);
+
+        /** Accessors */
+        uint32_t areaCount(void);
+        uint32_t reservedPages(void);
+        uint32_t backedPages(void);
+
+        /**
+         * Build the allocator of the kernel ranges, between VIRTUAL_START
+         * and VIRTUAL_END, on the kernel address space, page frame
+         * allocator and kmap window.
+         * @return the allocator, also available with getInstance()
+         */
+        static VirtualAllocator *setup(void);
+
+        /**
+         * Singleton implementation: the allocator built by setup(), NULL
+         * before.
+         */
+        static VirtualAllocator *getInstance(void);
+};
+
+#endif /* _VIRTUAL_ALLOCATOR_H_ */
@@ -0,0 +1,537 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * AllocatorBench.cpp: allocator benchmark workloads. Operations are timed
+ * with the time stamp counter, calibrated against the monotonic clock; the
+ * cost of reading the counter is measured and taken out of each sample.
+ *
+ * Workloads are driven by a seeded pseudo random generator: every
+ * allocator sees the same sequence of requests.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "AllocatorBench.h"
+
+/** Operations of each synthetic workload */
+#define BENCH_OPS           (1 << 20)
+
+/** Chunks alive at once in the synthetic workloads */
+#define BENCH_LIVE          128
+
+/** Message sizes of the producer/consumer workload */
+#define BENCH_SMALL_MESSAGE 64
+#define BENCH_LARGE_MESSAGE 1500
+
+/** Longest producer or consumer burst */
+#define BENCH_BURST         32
+
+/** Buckets of the trace loader address table */
+#define TRACE_HASH_SIZE     4096
+
+/** No slot, end of an address table chain */
+#define TRACE_NO_SLOT       0xFFFFFFFFu
+
+
+/* Timer characteristics, from calibrate() */
+static double nsPerTick = 0;
+static uint64_t timerOverhead = 0;
+
+static inline uint64_t readTsc(void)
+{
+    uint32_t low, high;
+
+    __asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t) high << 32) | low;
+}
+
+double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+uint32_t bench_random(uint32_t *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+/**
+ * Measure the time stamp counter rate and the cost of two reads.
+ */
+static void calibrate(void)
+{
+    uint64_t ticks, elapsed;
+    double start;
+    int i;
+
+    start = bench_now();
+    ticks = readTsc();
+    while (bench_now() - start < 50e6) {
+        continue;
+    }
+    nsPerTick = (bench_now() - start) / (readTsc() - ticks);
+
+    timerOverhead = ~0ull;
+    for (i = 0; i < 1000; i++) {
+        ticks = readTsc();
+        elapsed = readTsc() - ticks;
+        timerOverhead = (elapsed < timerOverhead) ? elapsed : timerOverhead;
+    }
+}
+
+
+LatencyHistogram::LatencyHistogram(void)
+{
+    clear();
+}
+
+void LatencyHistogram::clear(void)
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mMax = 0;
+}
+
+void LatencyHistogram::record(uint32_t latency)
+{
+    uint32_t shift;
+
+    if (latency < (1u << HISTOGRAM_SUB_BITS)) {
+        mBuckets[latency]++;
+    } else {
+        shift = (31 - __builtin_clz(latency)) - HISTOGRAM_SUB_BITS;
+        mBuckets[((shift + 1) << HISTOGRAM_SUB_BITS)
+                 + ((latency >> shift) & ((1u << HISTOGRAM_SUB_BITS) - 1))]++;
+    }
+    mCount++;
+    mMax = (latency > mMax) ? latency : mMax;
+}
+
+uint32_t LatencyHistogram::percentile(uint32_t perMillion)
+{
+    uint64_t rank, seen;
+    uint32_t bucket, shift, bound;
+
+    if (mCount == 0) {
+        return 0;
+    }
+
+    /* First bucket where the rank is reached */
+    rank = ((uint64_t) mCount * perMillion + 999999) / 1000000;
+    seen = 0;
+    for (bucket = 0; bucket < HISTOGRAM_BUCKETS - 1; bucket++) {
+        seen += mBuckets[bucket];
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    if (bucket < (1u << HISTOGRAM_SUB_BITS)) {
+        return bucket;
+    }
+    shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    bound = (((1u << HISTOGRAM_SUB_BITS) + (bucket & ((1u << HISTOGRAM_SUB_BITS) - 1))) << shift)
+            + (1u << shift) - 1;
+    return (bound < mMax) ? bound : mMax;
+}
+
+uint32_t LatencyHistogram::count(void)
+{
+    return mCount;
+}
+
+uint32_t LatencyHistogram::max(void)
+{
+    return mMax;
+}
+
+
+/**
+ * State of a workload run.
+ */
+struct bench_context {
+    BenchedAllocator *allocator;
+    LatencyHistogram allocs;
+    LatencyHistogram frees;
+    uint32_t failed;
+    uint32_t seed;
+    void *live[BENCH_LIVE];
+};
+
+/* Sizes from 1 to 2048 bytes, small ones more likely */
+static size_t randomSize(struct bench_context *ctx)
+{
+    return 1 + bench_random(&ctx->seed) % (16u << (bench_random(&ctx->seed) % 8));
+}
+
+static uint32_t elapsedNs(uint64_t start)
+{
+    uint64_t ticks = readTsc() - start;
+
+    ticks = (ticks > timerOverhead) ? ticks - timerOverhead : 0;
+    return (uint32_t) (ticks * nsPerTick);
+}
+
+static void *timedAlloc(struct bench_context *ctx, size_t size)
+{
+    uint64_t start;
+    void *chunk;
+
+    start = readTsc();
+    chunk = ctx->allocator->alloc(size);
+    ctx->allocs.record(elapsedNs(start));
+
+    if (chunk == NULL) {
+        ctx->failed++;
+    }
+    return chunk;
+}
+
+static void timedFree(struct bench_context *ctx, void *chunk)
+{
+    uint64_t start;
+
+    /* Failed allocations have nothing to give back */
+    if (chunk == NULL) {
+        return;
+    }
+
+    start = readTsc();
+    ctx->allocator->free(chunk);
+    ctx->frees.record(elapsedNs(start));
+}
+
+
+/** Allocate a batch, free it in reverse order */
+static void workloadLifo(struct bench_context *ctx, struct trace *)
+{
+    uint32_t done;
+    int i;
+
+    for (done = 0; done < BENCH_OPS; done += 2 * BENCH_LIVE) {
+        for (i = 0; i < BENCH_LIVE; i++) {
+            ctx->live[i] = timedAlloc(ctx, randomSize(ctx));
+        }
+        for (i = BENCH_LIVE - 1; i >= 0; i--) {
+            timedFree(ctx, ctx->live[i]);
+        }
+    }
+}
+
+/** Allocate a batch, free it in allocation order */
+static void workloadFifo(struct bench_context *ctx, struct trace *)
+{
+    uint32_t done;
+    int i;
+
+    for (done = 0; done < BENCH_OPS; done += 2 * BENCH_LIVE) {
+        for (i = 0; i < BENCH_LIVE; i++) {
+            ctx->live[i] = timedAlloc(ctx, randomSize(ctx));
+        }
+        for (i = 0; i < BENCH_LIVE; i++) {
+            timedFree(ctx, ctx->live[i]);
+        }
+    }
+}
+
+/** Random sizes and lifetimes: a random slot is freed if used, filled if not */
+static void workloadRandom(struct bench_context *ctx, struct trace *)
+{
+    uint32_t done, slot;
+
+    memset(ctx->live, 0, sizeof(ctx->live));
+    for (done = 0; done < BENCH_OPS; done++) {
+        slot = bench_random(&ctx->seed) % BENCH_LIVE;
+        if (ctx->live[slot] != NULL) {
+            timedFree(ctx, ctx->live[slot]);
+            ctx->live[slot] = NULL;
+        } else {
+            ctx->live[slot] = timedAlloc(ctx, randomSize(ctx));
+        }
+    }
+    for (slot = 0; slot < BENCH_LIVE; slot++) {
+        timedFree(ctx, ctx->live[slot]);
+    }
+}
+
+/**
+ * A producer queues small and large messages in bursts, a consumer frees
+ * the oldest ones in bursts of another length.
+ */
+static void workloadProducerConsumer(struct bench_context *ctx, struct trace *)
+{
+    uint32_t done, head, queued, burst;
+    size_t size;
+
+    done = 0;
+    head = 0;
+    queued = 0;
+    while (done < BENCH_OPS) {
+        burst = 1 + bench_random(&ctx->seed) % BENCH_BURST;
+        if (bench_random(&ctx->seed) & 1) {
+            for (; burst > 0 && queued < BENCH_LIVE; burst--, queued++, done++) {
+                size = (bench_random(&ctx->seed) % 4 == 0) ? BENCH_LARGE_MESSAGE : BENCH_SMALL_MESSAGE;
+                ctx->live[(head + queued) % BENCH_LIVE] = timedAlloc(ctx, size);
+            }
+        } else {
+            for (; burst > 0 && queued > 0; burst--, queued--, done++) {
+                timedFree(ctx, ctx->live[head]);
+                head = (head + 1) % BENCH_LIVE;
+            }
+        }
+    }
+    for (; queued > 0; queued--) {
+        timedFree(ctx, ctx->live[head]);
+        head = (head + 1) % BENCH_LIVE;
+    }
+}
+
+/** Replay a recorded trace */
+static void workloadTrace(struct bench_context *ctx, struct trace *trace)
+{
+    void **chunks;
+    uint32_t i;
+
+    chunks = (void**) calloc(trace->slots + 1, sizeof(void*));
+    for (i = 0; i < trace->count; i++) {
+        if (trace->ops[i].size != 0) {
+            chunks[trace->ops[i].slot] = timedAlloc(ctx, trace->ops[i].size);
+        } else {
+            timedFree(ctx, chunks[trace->ops[i].slot]);
+            chunks[trace->ops[i].slot] = NULL;
+        }
+    }
+    for (i = 0; i < trace->slots; i++) {
+        timedFree(ctx, chunks[i]);
+    }
+    free(chunks);
+}
+
+
+/** Workload table */
+static const struct {
+    const char *name;
+    void (*run)(struct bench_context *ctx, struct trace *trace);
+    bool needsTrace;
+} workloads[] = {
+    { "lifo", workloadLifo, false },
+    { "fifo", workloadFifo, false },
+    { "random", workloadRandom, false },
+    { "producer-consumer", workloadProducerConsumer, false },
+    { "trace", workloadTrace, true },
+};
+
+void bench_header(FILE *out)
+{
+    calibrate();
+    fprintf(out, "# timer: %.3f ns per tick, %.1f ns read overhead removed from samples\n",
+            nsPerTick, timerOverhead * nsPerTick);
+    fprintf(out, "allocator,workload,ops,ops_per_sec,failed,"
+            "alloc_p50_ns,alloc_p99_ns,alloc_p999_ns,alloc_max_ns,"
+            "free_p50_ns,free_p99_ns,free_p999_ns,free_max_ns,splits_merges\n");
+}
+
+void bench_run(BenchedAllocator *allocator, struct trace *trace, FILE *out)
+{
+    struct bench_context *ctx;
+    double start, elapsed;
+    uint32_t ops;
+    size_t i;
+
+    ctx = new bench_context;
+    for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        if (workloads[i].needsTrace && trace == NULL) {
+            continue;
+        }
+
+        allocator->reset();
+        ctx->allocator = allocator;
+        ctx->allocs.clear();
+        ctx->frees.clear();
+        ctx->failed = 0;
+        ctx->seed = BENCH_SEED;
+
+        start = bench_now();
+        workloads[i].run(ctx, trace);
+        elapsed = bench_now() - start;
+
+        ops = ctx->allocs.count() + ctx->frees.count();
+        fprintf(out, "%s,%s,%u,%.0f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d\n",
+                allocator->name(), workloads[i].name, ops, ops / elapsed * 1e9, ctx->failed,
+                ctx->allocs.percentile(500000), ctx->allocs.percentile(990000),
+                ctx->allocs.percentile(999000), ctx->allocs.max(),
+                ctx->frees.percentile(500000), ctx->frees.percentile(990000),
+                ctx->frees.percentile(999000), ctx->frees.max(), allocator->churn());
+    }
+    delete ctx;
+}
+
+
+void trace_replay(BenchedAllocator **allocators, int count, struct trace *trace, FILE *out)
+{
+    struct bench_context *ctx;
+    BenchedAllocator *allocator;
+    void **chunks;
+    uint32_t *sizes;
+    uint32_t i, largest, live, peakLive, peakOp;
+    double start, elapsed;
+    int a, index, peak;
+
+    /* Fragmentation is measured for the largest request of the trace */
+    largest = 0;
+    for (i = 0; i < trace->count; i++) {
+        largest = (trace->ops[i].size > largest) ? trace->ops[i].size : largest;
+    }
+
+    fprintf(out, "allocator,trace_ops,replay_us,failed,peak_live_bytes,"
+            "largest_request,peak_frag_per_mille,peak_frag_op\n");
+
+    ctx = new bench_context;
+    chunks = (void**) malloc((trace->slots + 1) * sizeof(void*));
+    sizes = (uint32_t*) malloc((trace->slots + 1) * sizeof(uint32_t));
+    for (a = 0; a < count; a++) {
+        allocator = allocators[a];
+
+        /* Timed replay */
+        allocator->reset();
+        ctx->allocator = allocator;
+        ctx->failed = 0;
+        start = bench_now();
+        workloadTrace(ctx, trace);
+        elapsed = bench_now() - start;
+
+        /* Replay again, sampling after each operation */
+        allocator->reset();
+        memset(chunks, 0, (trace->slots + 1) * sizeof(void*));
+        live = 0;
+        peakLive = 0;
+        peak = -1;
+        peakOp = 0;
+        for (i = 0; i < trace->count; i++) {
+            if (trace->ops[i].size != 0) {
+                chunks[trace->ops[i].slot] = allocator->alloc(trace->ops[i].size);
+                sizes[trace->ops[i].slot] = trace->ops[i].size;
+                live += (chunks[trace->ops[i].slot] != NULL) ? trace->ops[i].size : 0;
+            } else if (chunks[trace->ops[i].slot] != NULL) {
+                allocator->free(chunks[trace->ops[i].slot]);
+                chunks[trace->ops[i].slot] = NULL;
+                live -= sizes[trace->ops[i].slot];
+            }
+            peakLive = (live > peakLive) ? live : peakLive;
+
+            index = allocator->fragmentation(largest);
+            if (index > peak) {
+                peak = index;
+                peakOp = i;
+            }
+        }
+        for (i = 0; i < trace->slots; i++) {
+            if (chunks[i] != NULL) {
+                allocator->free(chunks[i]);
+            }
+        }
+
+        fprintf(out, "%s,%u,%.1f,%u,%u,%u,%d,%u\n",
+                allocator->name(), trace->count, elapsed / 1e3, ctx->failed,
+                peakLive, largest, peak, peakOp);
+    }
+    delete ctx;
+    free(chunks);
+    free(sizes);
+}
+
+
+/**
+ * Find the live chunk table entry of an address.
+ * @return its slot, TRACE_NO_SLOT if the address is not alive
+ */
+static uint32_t traceFind(uint32_t *heads, uint32_t *next, uint32_t *addresses,
+                          uint32_t address, bool unlink)
+{
+    uint32_t *link;
+    uint32_t slot;
+
+    for (link = &heads[address % TRACE_HASH_SIZE]; *link != TRACE_NO_SLOT; link = &next[*link]) {
+        slot = *link;
+        if (addresses[slot] == address) {
+            if (unlink) {
+                *link = next[slot];
+            }
+            return slot;
+        }
+    }
+    return TRACE_NO_SLOT;
+}
+
+int trace_load(const char *file, struct trace *trace)
+{
+    uint32_t heads[TRACE_HASH_SIZE];
+    uint32_t *next, *addresses, *freeSlots;
+    uint32_t lines, freeCount, size, address, slot;
+    char line[128];
+    FILE *in;
+
+    in = fopen(file, "r");
+    if (in == NULL) {
+        return -1;
+    }
+
+    /* One operation per line at most */
+    lines = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lines++;
+    }
+    rewind(in);
+
+    trace->ops = (struct trace_op*) malloc((lines + 1) * sizeof(struct trace_op));
+    trace->count = 0;
+    trace->slots = 0;
+    trace->skipped = 0;
+
+    /* Live addresses are chained by hash, a slot is reused once freed */
+    next = (uint32_t*) malloc((lines + 1) * sizeof(uint32_t));
+    addresses = (uint32_t*) malloc((lines + 1) * sizeof(uint32_t));
+    freeSlots = (uint32_t*) malloc((lines + 1) * sizeof(uint32_t));
+    memset(heads, 0xFF, sizeof(heads));
+    freeCount = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (sscanf(line, "a %u %x", &size, &address) == 2) {
+            /* Failed allocations and unknown addresses can't be matched */
+            if (address == 0 || size == 0
+                || traceFind(heads, next, addresses, address, false) != TRACE_NO_SLOT) {
+                trace->skipped++;
+                continue;
+            }
+            slot = (freeCount > 0) ? freeSlots[--freeCount] : trace->slots++;
+            addresses[slot] = address;
+            next[slot] = heads[address % TRACE_HASH_SIZE];
+            heads[address % TRACE_HASH_SIZE] = slot;
+        } else if (sscanf(line, "f %x", &address) == 1) {
+            slot = traceFind(heads, next, addresses, address, true);
+            if (slot == TRACE_NO_SLOT) {
+                trace->skipped++;
+                continue;
+            }
+            freeSlots[freeCount++] = slot;
+            size = 0;
+        } else {
+            continue;
+        }
+
+        trace->ops[trace->count].size = size;
+        trace->ops[trace->count].slot = slot;
+        trace->count++;
+    }
+
+    free(next);
+    free(addresses);
+    free(freeSlots);
+    fclose(in);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * AllocatorBench.h: allocator benchmark harness. Allocators are driven
+ * through the same workloads, every operation is timed and reported as a
+ * throughput and latency percentiles, one CSV line per allocator and
+ * workload so that runs can be diffed between commits.
+ */
+
+#ifndef _ALLOCATOR_BENCH_H_
+#define _ALLOCATOR_BENCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** Seed of bench_random(): every run sees the same sequence */
+#define BENCH_SEED          0x2545F491u
+
+/**
+ * Read the monotonic clock, to time a whole loop.
+ * @return the time in nanoseconds
+ */
+double bench_now(void);
+
+/**
+ * Deterministic pseudo random generator, so that runs can be compared.
+ * @param seed the state of the generator, BENCH_SEED to start a sequence
+ * @return a 24 bits pseudo random number
+ */
+uint32_t bench_random(uint32_t *seed);
+
+/**
+ * Interface of a benchmarked allocator.
+ */
+class BenchedAllocator {
+    public:
+        virtual ~BenchedAllocator(void) {}
+
+        /** Name of the allocator in the reports */
+        virtual const char *name(void) = 0;
+
+        /** Start again with all memory free */
+        virtual void reset(void) = 0;
+
+        /** Allocator implementation */
+        virtual void *alloc(size_t size) = 0;
+        virtual void free(void *chunk) = 0;
+
+        /**
+         * Tell how much of the free memory can't serve a request.
+         * @param size the size of the request
+         * @return a per mille index, -1 if the allocator can't tell
+         */
+        virtual int fragmentation(size_t size) { (void) size; return -1; }
+
+        /**
+         * Tell how many blocks were split or merged since the last reset.
+         * @return the count, -1 if the allocator can't tell
+         */
+        virtual int churn(void) { return -1; }
+};
+
+
+/** Histogram buckets: 2^HISTOGRAM_SUB_BITS linear buckets per power of two */
+#define HISTOGRAM_SUB_BITS  4
+#define HISTOGRAM_BUCKETS   ((32 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+/**
+ * Latency histogram, in nanoseconds. Buckets are linear up to
+ * 2^HISTOGRAM_SUB_BITS, then 2^HISTOGRAM_SUB_BITS per power of two: the
+ * error on a percentile is below 1/2^HISTOGRAM_SUB_BITS of its value.
+ */
+class LatencyHistogram {
+    private:
+        uint32_t mBuckets[HISTOGRAM_BUCKETS];
+        uint32_t mCount;
+        uint32_t mMax;
+
+    public:
+        LatencyHistogram(void);
+
+        void clear(void);
+        void record(uint32_t latency);
+
+        /**
+         * Get a latency percentile.
+         * @param perMillion the rank, 990000 for p99
+         * @return the upper bound of the bucket holding the rank, 0 if
+         *         nothing was recorded
+         */
+        uint32_t percentile(uint32_t perMillion);
+
+        uint32_t count(void);
+        uint32_t max(void);
+};
+
+
+/**
+ * Allocation trace, as BuddyAllocator::dumpTrace() prints it: one operation
+ * per line, "a <size> <address>" for an allocation that returned an
+ * address, 0 if it failed, "f <address>" for a free, each followed by an
+ * optional time stamp. Other lines are ignored. Addresses are hexadecimal,
+ * sizes decimal.
+ */
+struct trace_op {
+    uint32_t size;          /* Allocation size, 0 for a free */
+    uint32_t slot;          /* Live chunk table entry of the chunk */
+};
+
+struct trace {
+    struct trace_op *ops;
+    uint32_t count;
+    uint32_t slots;         /* Most chunks alive at once */
+    uint32_t skipped;       /* Failed allocations and frees of unknown chunks */
+};
+
+/**
+ * Load a trace, addresses are turned into live chunk table entries.
+ * @param file the trace file
+ * @param trace the trace to fill, ops is allocated with malloc
+ * @return 0, -1 if the file could not be read
+ */
+int trace_load(const char *file, struct trace *trace);
+
+
+/**
+ * Run all workloads on an allocator, print one CSV line per workload.
+ * @param allocator the allocator, reset before each workload
+ * @param trace the trace to replay, NULL to skip the replay
+ * @param out where to print the results
+ */
+void bench_run(BenchedAllocator *allocator, struct trace *trace, FILE *out);
+
+/**
+ * Replay a trace on each allocator, once timed, once looking at the
+ * fragmentation after every operation. Prints a CSV header and one line
+ * per allocator.
+ * @param allocators the allocators, reset before the replay
+ * @param count the count of allocators
+ * @param trace the trace to replay
+ * @param out where to print the results
+ */
+void trace_replay(BenchedAllocator **allocators, int count, struct trace *trace, FILE *out);
+
+/**
+ * Print the CSV header, and the timer characteristics as a comment.
+ */
+void bench_header(FILE *out);
+
+
+/**
+ * Time free/alloc pairs of minimum sized blocks on a fragmented heap, as
+ * it fills up. Prints a CSV header and one line per fill level.
+ */
+void bench_buddy_free_latency(FILE *out);
+
+/**
+ * Compare the order computation of the buddy allocator with the shift loop
+ * it replaced. Prints a CSV header and one line per method.
+ */
+void bench_buddy_power_from_size(FILE *out);
+
+/**
+ * Time alloc()/free() pairs of minimum sized blocks when the only free
+ * block is 1 to 2^16 times larger: the free area is found with a bit scan
+ * of the non empty orders, the time left grows with the splits and merges.
+ * Prints a CSV header and one line per distance between the orders.
+ */
+void bench_buddy_order_search(FILE *out);
+
+/**
+ * Compare a heap zeroed up front with a heap known to be clean, zeroed
+ * lazily: time to set the allocator up and get the whole heap from
+ * allocZeroed(). Prints a CSV header and one line per setup, with the
+ * bytes zeroed.
+ */
+void bench_buddy_setup(FILE *out);
+
+/**
+ * Compare the object cache with raw buddy allocations of the same objects.
+ * Prints a CSV header and one line per object size: throughput and bytes
+ * wasted by each.
+ */
+void bench_slab(FILE *out);
+
+/**
+ * Time the setup of the page frame allocator for a 4 GB machine: clearing
+ * the descriptor table and adding the usable ranges. Prints a CSV header
+ * and one line.
+ */
+void bench_page_frame_setup(FILE *out);
+
+/**
+ * Time the allocation of every frame of a 4 GB machine one by one, then
+ * their release. Prints a CSV header and one line.
+ */
+void bench_page_frame_throughput(FILE *out);
+
+/**
+ * Simulate hours of allocations of mixed lifetimes on a 256 MB machine,
+ * the same requests with and without their lifetime: grouped, pinned frames
+ * fill a few pageblocks and the others merge back into 4 MB blocks once
+ * short lived frames are freed. Prints a CSV header and one line per
+ * report, for both runs.
+ */
+void bench_page_frame_churn(FILE *out);
+
+#endif /* _ALLOCATOR_BENCH_H_ */
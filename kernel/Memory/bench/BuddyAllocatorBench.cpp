@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * BuddyAllocatorBench.cpp: benchmarks of the buddy allocator internals,
+ * on a heap of their own. Each one times a loop of operations and prints
+ * the mean cost of one.
+ */
+
+#include <string.h>
+#include "Memory/BuddyAllocator.h"
+#include "AllocatorBench.h"
+
+/** Heap of the benchmarks: 2^BUDDY_BENCH_POWER bytes */
+#define BUDDY_BENCH_POWER   20
+#define BUDDY_BENCH_HEAP    (1 << BUDDY_BENCH_POWER)
+#define BUDDY_BENCH_BLOCKS  (BUDDY_BENCH_HEAP / BUDDY_MIN_SIZE)
+
+/** Pairs of free/alloc operations measured for each fill level or search distance */
+#define BUDDY_BENCH_ROUNDS  (1 << 16)
+
+/** Order computations measured */
+#define BUDDY_BENCH_LOOKUPS (1 << 22)
+
+static struct freeblock buddyBenchFreeAreas[BUDDY_BENCH_POWER];
+static uint8_t buddyBenchBlockMap[BUDDY_MAP_SIZE(BUDDY_BENCH_POWER)];
+static char buddyBenchHeap[BUDDY_BENCH_HEAP];
+static void *buddyBenchBlocks[BUDDY_BENCH_BLOCKS];
+
+
+/**
+ * Measure the mean time of a free/alloc pair of minimum sized blocks,
+ * picked at random among the first live blocks.
+ * @return the mean time of a pair in nanoseconds
+ */
+static double freeLatency(BuddyAllocator *allocator, int live, uint32_t *seed)
+{
+    double start;
+    int victim, i;
+
+    start = bench_now();
+    for (i = 0; i < BUDDY_BENCH_ROUNDS; i++) {
+        victim = bench_random(seed) % live;
+        allocator->free(buddyBenchBlocks[victim]);
+        buddyBenchBlocks[victim] = allocator->alloc(BUDDY_MIN_SIZE);
+    }
+    return (bench_now() - start) / BUDDY_BENCH_ROUNDS;
+}
+
+void bench_buddy_free_latency(FILE *out)
+{
+    BuddyAllocator allocator(buddyBenchFreeAreas, BUDDY_BENCH_POWER, buddyBenchBlockMap,
+                             buddyBenchHeap, BUDDY_BENCH_HEAP);
+    uint32_t seed = BENCH_SEED;
+    void *block;
+    int live, fill, i, j;
+
+    /* Fill the whole heap, then free nine blocks in ten at random: fragmented heap */
+    for (i = 0; i < BUDDY_BENCH_BLOCKS; i++) {
+        buddyBenchBlocks[i] = allocator.alloc(BUDDY_MIN_SIZE);
+    }
+    for (i = BUDDY_BENCH_BLOCKS - 1; i > 0; i--) {
+        j = bench_random(&seed) % (i + 1);
+        block = buddyBenchBlocks[i];
+        buddyBenchBlocks[i] = buddyBenchBlocks[j];
+        buddyBenchBlocks[j] = block;
+    }
+    live = BUDDY_BENCH_BLOCKS / 10;
+    for (i = live; i < BUDDY_BENCH_BLOCKS; i++) {
+        allocator.free(buddyBenchBlocks[i]);
+    }
+
+    /* Fill it back from 10% to 90%, a linear free would slow down on the way */
+    fprintf(out, "block_size,heap_fill_percent,free_alloc_ns\n");
+    for (fill = 10; fill <= 90; fill += 10) {
+        for (; live < BUDDY_BENCH_BLOCKS / 100 * fill; live++) {
+            buddyBenchBlocks[live] = allocator.alloc(BUDDY_MIN_SIZE);
+        }
+        fprintf(out, "%u,%d,%.1f\n", BUDDY_MIN_SIZE, fill, freeLatency(&allocator, live, &seed));
+    }
+}
+
+
+/**
+ * Order computation as it was done before bit scan: one shift per bit.
+ */
+static uint32_t legacyPowerFromSize(uint32_t n)
+{
+    uint32_t power;
+
+    n--;
+    for (power = 0; n != 0; power++, n >>= 1);
+
+    return (power < BUDDY_MIN_POWER) ? BUDDY_MIN_POWER : power;
+}
+
+void bench_buddy_power_from_size(FILE *out)
+{
+    volatile uint32_t sink = 0;
+    uint32_t seed;
+    double start, legacy, scan;
+    int i;
+
+    seed = BENCH_SEED;
+    start = bench_now();
+    for (i = 0; i < BUDDY_BENCH_LOOKUPS; i++) {
+        sink = sink + legacyPowerFromSize((bench_random(&seed) % BUDDY_BENCH_HEAP) + 1);
+    }
+    legacy = (bench_now() - start) / BUDDY_BENCH_LOOKUPS;
+
+    seed = BENCH_SEED;
+    start = bench_now();
+    for (i = 0; i < BUDDY_BENCH_LOOKUPS; i++) {
+        sink = sink + BuddyAllocator::powerFromSize((bench_random(&seed) % BUDDY_BENCH_HEAP) + 1);
+    }
+    scan = (bench_now() - start) / BUDDY_BENCH_LOOKUPS;
+
+    fprintf(out, "power_from_size,ns_per_lookup\n");
+    fprintf(out, "shift-loop,%.2f\n", legacy);
+    fprintf(out, "bsr,%.2f\n", scan);
+}
+
+void bench_buddy_order_search(FILE *out)
+{
+    BuddyAllocator *allocator;
+    struct buddy_stats stats;
+    uint32_t distance, splits, power;
+    double start, elapsed;
+    void *block;
+    int i;
+
+    /*
+     * The heap is a single block, 2^distance times the requested size:
+     * alloc() finds it above distance empty free areas, splits it
+     * distance times, and free() merges it back.
+     */
+    fprintf(out, "free_order_distance,alloc_free_ns,splits_per_alloc\n");
+    for (distance = 0; distance <= BUDDY_BENCH_POWER - BUDDY_MIN_POWER; distance++) {
+        allocator = new BuddyAllocator(buddyBenchFreeAreas, BUDDY_BENCH_POWER, buddyBenchBlockMap,
+                                       buddyBenchHeap, 0);
+        allocator->addRegion(buddyBenchHeap, BUDDY_MIN_SIZE << distance);
+
+        start = bench_now();
+        for (i = 0; i < BUDDY_BENCH_ROUNDS; i++) {
+            block = allocator->alloc(BUDDY_MIN_SIZE);
+            allocator->free(block);
+        }
+        elapsed = bench_now() - start;
+
+        allocator->getStats(&stats);
+        splits = 0;
+        for (power = BUDDY_MIN_POWER; power <= BUDDY_BENCH_POWER; power++) {
+            splits += stats.splits[power];
+        }
+        fprintf(out, "%u,%.1f,%u\n", distance, elapsed / BUDDY_BENCH_ROUNDS,
+                splits / BUDDY_BENCH_ROUNDS);
+        delete allocator;
+    }
+}
+
+
+void bench_buddy_setup(FILE *out)
+{
+    BuddyAllocator *allocator;
+    struct buddy_stats eagerStats, lazyStats;
+    double start, eager, lazy;
+
+    /* Zeroing the whole heap up front, as the allocator used to */
+    start = bench_now();
+    memset(buddyBenchHeap, 0, BUDDY_BENCH_HEAP);
+    allocator = new BuddyAllocator(buddyBenchFreeAreas, BUDDY_BENCH_POWER, buddyBenchBlockMap,
+                                   buddyBenchHeap, BUDDY_BENCH_HEAP, true);
+    allocator->allocZeroed(BUDDY_BENCH_HEAP);
+    eager = bench_now() - start;
+    allocator->getStats(&eagerStats);
+    delete allocator;
+
+    /* Lazy zeroing of a heap known to be clean */
+    start = bench_now();
+    allocator = new BuddyAllocator(buddyBenchFreeAreas, BUDDY_BENCH_POWER, buddyBenchBlockMap,
+                                   buddyBenchHeap, BUDDY_BENCH_HEAP, true);
+    allocator->allocZeroed(BUDDY_BENCH_HEAP);
+    lazy = bench_now() - start;
+    allocator->getStats(&lazyStats);
+    delete allocator;
+
+    fprintf(out, "heap_setup,heap_bytes,setup_and_alloc_zeroed_us,zeroed_bytes\n");
+    fprintf(out, "eager,%u,%.1f,%u\n", BUDDY_BENCH_HEAP, eager / 1e3,
+            BUDDY_BENCH_HEAP + eagerStats.zeroedBytes);
+    fprintf(out, "lazy,%u,%.1f,%u\n", BUDDY_BENCH_HEAP, lazy / 1e3, lazyStats.zeroedBytes);
+}
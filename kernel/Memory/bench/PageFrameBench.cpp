@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * PageFrameBench.cpp: benchmarks of the page frame allocator: time on a
+ * 4 GB machine with a PC like memory map, and fragmentation over hours of
+ * mixed lifetimes allocations on a smaller one.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Memory/PageFrameAllocator.h"
+#include "AllocatorBench.h"
+
+/** Frames of the machine: 4 GB, whatever PAGE_FRAME_LIMIT is */
+#define PAGE_BENCH_FRAMES   (1u << 20)
+
+/** Usable memory: low memory up to 0x9FC00, then 1 MB to the PCI hole */
+#define PAGE_BENCH_LOW      0x9FC00ull
+#define PAGE_BENCH_HIGH     0x100000ull
+#define PAGE_BENCH_TOP      0xBFF00000ull
+
+/** Churn simulation: a 256 MB machine, one step per simulated second */
+#define CHURN_FRAMES        65536
+#define CHURN_PAGE_BLOCKS   (CHURN_FRAMES / PAGE_BLOCK_FRAMES)
+#define CHURN_HOURS         3
+#define CHURN_REPORT        1800
+#define CHURN_LIVE          32768
+
+/**
+ * Churn workload, per lifetime: allocations per second, mean lifetime in
+ * seconds and largest order. About 80 % of the memory ends up allocated:
+ * kernel objects living an hour, caches living ten minutes and short lived
+ * buffers.
+ */
+static const struct {
+    enum page_lifetime lifetime;
+    uint32_t arrivals;
+    uint32_t meanLife;
+    uint32_t maxOrder;
+} churnWorkload[PAGE_LIFETIMES] = {
+    { PAGE_LIFETIME_PINNED, 2, 3600, 1 },
+    { PAGE_LIFETIME_RECLAIMABLE, 10, 600, 0 },
+    { PAGE_LIFETIME_MOVABLE, 150, 100, 2 }
+};
+
+static struct page_frame churnFrames[CHURN_FRAMES];
+
+/* Live chunks of the churn simulation, per lifetime */
+static uint64_t churnChunks[PAGE_LIFETIMES][CHURN_LIVE];
+static uint8_t churnOrders[PAGE_LIFETIMES][CHURN_LIVE];
+
+
+/**
+ * Build an allocator for the machine.
+ * @param frames the descriptor table, PAGE_BENCH_FRAMES entries
+ */
+static PageFrameAllocator *buildAllocator(struct page_frame *frames)
+{
+    PageFrameAllocator *allocator = new PageFrameAllocator(frames, PAGE_BENCH_FRAMES);
+
+    allocator->addRange(0, PAGE_BENCH_LOW);
+    allocator->addRange(PAGE_BENCH_HIGH, PAGE_BENCH_TOP - PAGE_BENCH_HIGH);
+    return allocator;
+}
+
+void bench_page_frame_setup(FILE *out)
+{
+    struct page_frame *frames;
+    PageFrameAllocator *allocator;
+    double start, elapsed;
+
+    frames = (struct page_frame *) malloc(PAGE_BENCH_FRAMES * sizeof(struct page_frame));
+
+    /* Touch the table once, the kernel finds it in RAM */
+    delete buildAllocator(frames);
+
+    start = bench_now();
+    allocator = buildAllocator(frames);
+    elapsed = bench_now() - start;
+
+    fprintf(out, "page_frames,descriptor_kb,free_frames,build_ms\n");
+    fprintf(out, "%u,%u,%u,%.2f\n", allocator->frameCount(),
+            (uint32_t) (PAGE_BENCH_FRAMES * sizeof(struct page_frame) / 1024),
+            allocator->freeFrames(), elapsed / 1e6);
+
+    delete allocator;
+    free(frames);
+}
+
+void bench_page_frame_throughput(FILE *out)
+{
+    struct page_frame *frames;
+    PageFrameAllocator *allocator;
+    uint64_t *addresses;
+    uint32_t count, i;
+    double start, elapsed;
+
+    frames = (struct page_frame *) malloc(PAGE_BENCH_FRAMES * sizeof(struct page_frame));
+    addresses = (uint64_t *) malloc(PAGE_BENCH_FRAMES * sizeof(uint64_t));
+    allocator = buildAllocator(frames);
+    count = allocator->freeFrames();
+
+    /* Take all the frames one by one, then give them back */
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        addresses[i] = allocator->allocPages(0);
+    }
+    for (i = 0; i < count; i++) {
+        allocator->freePages(addresses[i]);
+    }
+    elapsed = bench_now() - start;
+
+    fprintf(out, "page_frames,alloc_free_mframes_per_sec,free_frames_after\n");
+    fprintf(out, "%u,%.1f,%u\n", count, 2.0 * count / (elapsed / 1e3),
+            allocator->freeFrames());
+
+    delete allocator;
+    free(addresses);
+    free(frames);
+}
+
+
+/**
+ * Print the state of memory during a churn simulation: the longest run of
+ * free frames, which is not bounded by the largest order, the free
+ * pageblocks, and the pageblocks without pinned frames, the ones a pinned
+ * 4 MB request could get once their movable frames are moved.
+ * @param pinned frames of each pageblock that are not movable
+ */
+static void churnReport(PageFrameAllocator *allocator, const uint32_t *pinned,
+                        const char *grouping, const char *phase,
+                        uint32_t failed, FILE *out)
+{
+    uint32_t clean, block, frame, size, run, longest;
+
+    clean = 0;
+    for (block = 0; block < CHURN_PAGE_BLOCKS; block++) {
+        clean += (pinned[block] == 0) ? 1 : 0;
+    }
+
+    /* Walk the descriptors block by block, free blocks extend the run */
+    run = 0;
+    longest = 0;
+    for (frame = 0; frame < CHURN_FRAMES; frame += size) {
+        size = (churnFrames[frame].flags & PAGE_FRAME_HEAD) ? 1u << churnFrames[frame].order : 1;
+        run = (churnFrames[frame].flags & PAGE_FRAME_FREE) ? run + size : 0;
+        longest = (run > longest) ? run : longest;
+    }
+
+    fprintf(out, "%s,%s,%u,%u,%u,%u,%u\n", grouping, phase, allocator->freeFrames(),
+            longest, allocator->freeBlocks(PAGE_MAX_ORDER), clean, failed);
+}
+
+/**
+ * Run the churn simulation, report every CHURN_REPORT simulated seconds,
+ * then once the movable frames are freed.
+ * @param grouped give the allocator the lifetime of each request, else all
+ *                requests are pinned
+ */
+static void churn(bool grouped, FILE *out)
+{
+    PageFrameAllocator *allocator = new PageFrameAllocator(churnFrames, CHURN_FRAMES);
+    const char *grouping = grouped ? "grouped" : "mixed";
+    uint32_t live[PAGE_LIFETIMES] = { 0, 0, 0 };
+    uint32_t pinned[CHURN_PAGE_BLOCKS];
+    uint32_t second, lifetime, count, victim, order, failed, i;
+    uint32_t seed = BENCH_SEED;
+    uint64_t address;
+    char phase[16];
+
+    allocator->addRange(0, (uint64_t) CHURN_FRAMES * PAGE_FRAME_SIZE);
+    memset(pinned, 0, sizeof(pinned));
+    failed = 0;
+
+    for (second = 1; second <= CHURN_HOURS * 3600; second++) {
+        for (lifetime = 0; lifetime < PAGE_LIFETIMES; lifetime++) {
+            /* Each chunk dies with a 1/meanLife probability */
+            count = live[lifetime] / churnWorkload[lifetime].meanLife;
+            count += (bench_random(&seed) % churnWorkload[lifetime].meanLife
+                      < live[lifetime] % churnWorkload[lifetime].meanLife) ? 1 : 0;
+            for (i = 0; i < count; i++) {
+                victim = bench_random(&seed) % live[lifetime];
+                address = churnChunks[lifetime][victim];
+                order = churnOrders[lifetime][victim];
+                if (lifetime != PAGE_LIFETIME_MOVABLE) {
+                    pinned[address / (PAGE_FRAME_SIZE * PAGE_BLOCK_FRAMES)] -= (1u << order);
+                }
+                allocator->freePages(address, order);
+                live[lifetime]--;
+                churnChunks[lifetime][victim] = churnChunks[lifetime][live[lifetime]];
+                churnOrders[lifetime][victim] = churnOrders[lifetime][live[lifetime]];
+            }
+
+            for (i = 0; i < churnWorkload[lifetime].arrivals && live[lifetime] < CHURN_LIVE; i++) {
+                order = bench_random(&seed) % (churnWorkload[lifetime].maxOrder + 1);
+                address = allocator->allocPages(order, PAGE_ZONE_NORMAL,
+                                                grouped ? churnWorkload[lifetime].lifetime
+                                                : PAGE_LIFETIME_PINNED);
+                if (address == 0) {
+                    failed++;
+                    continue;
+                }
+                if (lifetime != PAGE_LIFETIME_MOVABLE) {
+                    pinned[address / (PAGE_FRAME_SIZE * PAGE_BLOCK_FRAMES)] += (1u << order);
+                }
+                churnChunks[lifetime][live[lifetime]] = address;
+                churnOrders[lifetime][live[lifetime]] = order;
+                live[lifetime]++;
+            }
+        }
+
+        if (second % CHURN_REPORT == 0) {
+            snprintf(phase, sizeof(phase), "%uh%02u", second / 3600, second % 3600 / 60);
+            churnReport(allocator, pinned, grouping, phase, failed, out);
+        }
+    }
+
+    /* Short lived buffers drain, only long lived frames split memory */
+    for (i = 0; i < live[PAGE_LIFETIME_MOVABLE]; i++) {
+        allocator->freePages(churnChunks[PAGE_LIFETIME_MOVABLE][i]);
+    }
+    churnReport(allocator, pinned, grouping, "drained", failed, out);
+    delete allocator;
+}
+
+void bench_page_frame_churn(FILE *out)
+{
+    fprintf(out, "lifetimes,time,free_frames,longest_free_run,free_pageblocks,"
+            "unpinned_pageblocks,failed_allocs\n");
+    churn(false, out);
+    churn(true, out);
+}
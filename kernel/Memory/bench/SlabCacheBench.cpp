@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * SlabCacheBench.cpp: the object cache against raw buddy allocations of
+ * the same objects. Both allocate and free a batch of objects in rounds
+ * on the same arena; waste is measured on the first round.
+ */
+
+#include "Memory/SlabCache.h"
+#include "AllocatorBench.h"
+
+/** Arena of the benchmark: 2^SLAB_BENCH_POWER bytes */
+#define SLAB_BENCH_POWER    20
+#define SLAB_BENCH_HEAP     (1 << SLAB_BENCH_POWER)
+
+/** Objects alive at once, and rounds of allocations and frees */
+#define SLAB_BENCH_OBJECTS  8192
+#define SLAB_BENCH_ROUNDS   32
+
+static struct freeblock slabBenchFreeAreas[SLAB_BENCH_POWER];
+static uint8_t slabBenchBlockMap[BUDDY_MAP_SIZE(SLAB_BENCH_POWER)];
+static char slabBenchHeap[SLAB_BENCH_HEAP];
+static void *slabBenchObjects[SLAB_BENCH_OBJECTS];
+
+/**
+ * Run the benchmark for one object size.
+ * @param allocator the allocator of the objects and the slabs
+ * @param size the size of the objects
+ * @param out where to print the results
+ */
+static void compare(BuddyAllocator *allocator, size_t size, FILE *out)
+{
+    SlabCache cache(allocator, "bench", size);
+    double start, buddyTime, slabTime;
+    size_t buddyWaste, slabWaste;
+    int r, i;
+
+    /* Raw buddy */
+    buddyWaste = 0;
+    start = bench_now();
+    for (r = 0; r < SLAB_BENCH_ROUNDS; r++) {
+        for (i = 0; i < SLAB_BENCH_OBJECTS; i++) {
+            slabBenchObjects[i] = allocator->alloc(size);
+        }
+        if (r == 0) {
+            for (i = 0; i < SLAB_BENCH_OBJECTS; i++) {
+                buddyWaste += allocator->chunkSize(slabBenchObjects[i]) - size;
+            }
+        }
+        for (i = 0; i < SLAB_BENCH_OBJECTS; i++) {
+            allocator->free(slabBenchObjects[i]);
+        }
+    }
+    buddyTime = bench_now() - start;
+
+    /* Object cache */
+    slabWaste = 0;
+    start = bench_now();
+    for (r = 0; r < SLAB_BENCH_ROUNDS; r++) {
+        for (i = 0; i < SLAB_BENCH_OBJECTS; i++) {
+            slabBenchObjects[i] = cache.alloc();
+        }
+        if (r == 0) {
+            slabWaste = cache.slabCount() * cache.slabSize() - SLAB_BENCH_OBJECTS * size;
+        }
+        for (i = 0; i < SLAB_BENCH_OBJECTS; i++) {
+            cache.free(slabBenchObjects[i]);
+        }
+    }
+    slabTime = bench_now() - start;
+
+    fprintf(out, "%u,%u,%.0f,%u,%.0f,%u\n",
+            (unsigned) size, SLAB_BENCH_OBJECTS,
+            1e9 * SLAB_BENCH_ROUNDS * SLAB_BENCH_OBJECTS / buddyTime, (unsigned) buddyWaste,
+            1e9 * SLAB_BENCH_ROUNDS * SLAB_BENCH_OBJECTS / slabTime, (unsigned) slabWaste);
+}
+
+void bench_slab(FILE *out)
+{
+    BuddyAllocator allocator(slabBenchFreeAreas, SLAB_BENCH_POWER, slabBenchBlockMap,
+                             slabBenchHeap, SLAB_BENCH_HEAP);
+
+    fprintf(out, "object_size,objects,buddy_allocs_per_sec,buddy_wasted_bytes,"
+            "slab_allocs_per_sec,slab_wasted_bytes\n");
+    compare(&allocator, 28, out);
+    compare(&allocator, 40, out);
+    compare(&allocator, 72, out);
+    compare(&allocator, 100, out);
+}
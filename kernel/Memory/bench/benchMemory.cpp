@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * benchMemory.cpp: runs the memory allocators through the benchmark
+ * workloads.
+ *
+ * Usage: benchMemory [trace]
+ * Results are printed on the standard output as CSV. If a trace file is
+ * given, it is replayed as a workload, then a second CSV table tells the
+ * replay time and the peak fragmentation of each allocator. The benchmarks
+ * of single allocator features follow, one CSV table each.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Memory/BuddyAllocator.h"
+#include "Memory/BootstrapAllocator.h"
+#include "AllocatorBench.h"
+
+/** Arena of the buddy allocator under benchmark: 2^BENCH_POWER bytes */
+#define BENCH_POWER         24
+
+/** Unmerged blocks per power in lazy coalescing mode */
+#define BENCH_LAZY_BLOCKS   32
+
+static struct freeblock benchFreeAreas[BENCH_POWER];
+static uint8_t benchBlockMap[BUDDY_MAP_SIZE(BENCH_POWER)];
+static char benchHeap[1 << BENCH_POWER];
+
+/* Region of the bootstrap allocator: a 1 MB heap and the map of its arena */
+#define BENCH_BOOTSTRAP_REGION  ((1 << 20) + BUDDY_MAP_SIZE(21))
+static char benchBootstrapRegion[BENCH_BOOTSTRAP_REGION] __attribute__((aligned(1 << 21)));
+
+
+/* Count of blocks split or merged */
+static int buddyChurn(const struct buddy_stats *stats)
+{
+    int churn = 0;
+    int power;
+
+    for (power = 0; power < BUDDY_MAX_POWER; power++) {
+        churn += stats->splits[power] + stats->merges[power];
+    }
+    return churn;
+}
+
+
+/**
+ * A buddy allocator of its own arena, merging blocks on each free or lazily.
+ */
+class BenchedBuddyAllocator: public BenchedAllocator {
+    private:
+        BuddyAllocator *mAllocator;
+        bool mLazy;
+
+    public:
+        BenchedBuddyAllocator(bool lazy): mAllocator(NULL), mLazy(lazy) {}
+        ~BenchedBuddyAllocator(void) { delete mAllocator; }
+
+        const char *name(void) { return mLazy ? "buddy-lazy" : "buddy"; }
+
+        void reset(void)
+        {
+            delete mAllocator;
+            mAllocator = new BuddyAllocator(benchFreeAreas, BENCH_POWER, benchBlockMap,
+                                            benchHeap, 1 << BENCH_POWER);
+            if (mLazy) {
+                mAllocator->setLazyCoalescing(BENCH_LAZY_BLOCKS, (1 << BENCH_POWER) / 8);
+            }
+        }
+
+        void *alloc(size_t size) { return mAllocator->alloc(size); }
+        void free(void *chunk) { mAllocator->free(chunk); }
+
+        int fragmentation(size_t size)
+        {
+            return mAllocator->fragmentationIndex(BuddyAllocator::powerFromSize(size));
+        }
+
+        int churn(void)
+        {
+            struct buddy_stats stats;
+
+            mAllocator->getStats(&stats);
+            return buddyChurn(&stats);
+        }
+};
+
+/**
+ * The same buddy allocator, with its arena size known at compile time.
+ */
+class BenchedStaticBuddyAllocator: public BenchedAllocator {
+    private:
+        typedef BasicBuddyAllocator<BUDDY_MIN_POWER, BENCH_POWER> StaticBuddyAllocator;
+        StaticBuddyAllocator *mAllocator;
+
+    public:
+        BenchedStaticBuddyAllocator(void): mAllocator(NULL) {}
+        ~BenchedStaticBuddyAllocator(void) { delete mAllocator; }
+
+        const char *name(void) { return "buddy-static"; }
+
+        void reset(void)
+        {
+            delete mAllocator;
+            mAllocator = new StaticBuddyAllocator(benchBlockMap, benchHeap, 1 << BENCH_POWER);
+        }
+
+        void *alloc(size_t size) { return mAllocator->alloc(size); }
+        void free(void *chunk) { mAllocator->free(chunk); }
+
+        int fragmentation(size_t size)
+        {
+            return mAllocator->fragmentationIndex(StaticBuddyAllocator::powerFromSize(size));
+        }
+
+        int churn(void)
+        {
+            struct buddy_stats stats;
+
+            mAllocator->getStats(&stats);
+            return buddyChurn(&stats);
+        }
+};
+
+/**
+ * The kernel bootstrap allocator, on a 1 MB heap.
+ */
+class BenchedBootstrapAllocator: public BenchedAllocator {
+    public:
+        const char *name(void) { return "bootstrap"; }
+        void reset(void) { BootstrapAllocator::setup(benchBootstrapRegion, BENCH_BOOTSTRAP_REGION); }
+        void *alloc(size_t size) { return BootstrapAllocator::getInstance()->alloc(size); }
+        void free(void *chunk) { BootstrapAllocator::getInstance()->free(chunk); }
+
+        int fragmentation(size_t size)
+        {
+            return BootstrapAllocator::getInstance()->fragmentationIndex(BuddyAllocator::powerFromSize(size));
+        }
+
+        int churn(void)
+        {
+            struct buddy_stats stats;
+
+            BootstrapAllocator::getInstance()->getStats(&stats);
+            return buddyChurn(&stats);
+        }
+};
+
+
+/* Allocators are built with the kernel flags: failed assertions end here */
+extern "C" void panic(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    abort();
+}
+
+int main(int argc, char **argv)
+{
+    BenchedBuddyAllocator buddy(false);
+    BenchedBuddyAllocator lazyBuddy(true);
+    BenchedStaticBuddyAllocator staticBuddy;
+    BenchedBootstrapAllocator bootstrap;
+    struct trace trace;
+    struct trace *replay = NULL;
+    BenchedAllocator *allocators[] = { &buddy, &lazyBuddy, &staticBuddy, &bootstrap };
+    int count = sizeof(allocators) / sizeof(allocators[0]);
+    int i;
+
+    if (argc > 1) {
+        if (trace_load(argv[1], &trace) != 0) {
+            fprintf(stderr, "benchMemory: can't read trace %s\n", argv[1]);
+            return 1;
+        }
+        printf("# trace %s: %u operations, %u chunks alive at most, %u skipped\n",
+               argv[1], trace.count, trace.slots, trace.skipped);
+        replay = &trace;
+    }
+
+    bench_header(stdout);
+    for (i = 0; i < count; i++) {
+        bench_run(allocators[i], replay, stdout);
+    }
+
+    if (replay != NULL) {
+        printf("\n");
+        trace_replay(allocators, count, replay, stdout);
+        free(trace.ops);
+    }
+
+    printf("\n");
+    bench_buddy_free_latency(stdout);
+    printf("\n");
+    bench_buddy_power_from_size(stdout);
+    printf("\n");
+    bench_buddy_order_search(stdout);
+    printf("\n");
+    bench_buddy_setup(stdout);
+    printf("\n");
+    bench_slab(stdout);
+    printf("\n");
+    bench_page_frame_setup(stdout);
+    printf("\n");
+    bench_page_frame_throughput(stdout);
+    printf("\n");
+    bench_page_frame_churn(stdout);
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2012, the Simple Object Kernel project.
+ *
+ * kmalloc.h: C interface of the kernel heap.
+ */
+
+#ifndef _KMALLOC_H_
+#define _KMALLOC_H_
+
+#include "stddef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocate a chunk of memory from the kernel heap.
+ * @param size the size of the chunk
+ * @return the chunk, NULL if the heap is exhausted
+ */
+void *kmalloc(size_t size);
+
+/**
+ * Give back a chunk to the kernel heap.
+ * @param chunk a chunk obtained from kmalloc, may be NULL
+ */
+void kfree(void *chunk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _KMALLOC_H_ */
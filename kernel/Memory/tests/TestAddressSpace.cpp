@@ -0,0 +1,231 @@
+#include "TestAddressSpace.h"
+#include <string.h>
+#include <stdint.h>
+
+#define MB      (1024 * 1024)
+#define LARGE   PAGE_LARGE_SIZE
+
+/* Directory entry of an address */
+#define DIR(address)    ((address) >> PAGE_LARGE_POWER)
+
+/* Order of the block holding the directories */
+#define DIRECTORY_ORDER ((PAGE_DIRECTORIES == 4) ? 2 : 0)
+
+/* Physical memory of the tests, the window of the address spaces */
+static char memory[TEST_SPACE_FRAMES * PAGE_FRAME_SIZE] __attribute__((aligned(PAGE_FRAME_SIZE)));
+
+void TestAddressSpace::setUp(void)
+{
+    uint64_t directory;
+
+    mAllocator = new PageFrameAllocator(mFrames, TEST_SPACE_FRAMES);
+    mAllocator->addRange(0, sizeof(memory));
+    directory = mAllocator->allocPages(DIRECTORY_ORDER);
+    mDirectory = (page_entry_t*) (memory + directory);
+    memset(mDirectory, 0, PAGE_DIRECTORIES * PAGE_FRAME_SIZE);
+    mSpace = new AddressSpace(mDirectory, (uint32_t) directory, memory, mAllocator,
+                              PAGE_LARGE | PAGE_GLOBAL);
+}
+
+
+void TestAddressSpace::tearDown(void)
+{
+    delete mSpace;
+    delete mAllocator;
+}
+
+
+void TestAddressSpace::testLargePages(void)
+{
+    uint32_t frames = mAllocator->freeFrames();
+    uint64_t physical;
+
+    /* Aligned ranges take directory entries, no page table */
+    TS_ASSERT_EQUALS(mSpace->map(0xC0000000u, 0, 2 * LARGE, PAGE_WRITE | PAGE_GLOBAL), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+    TS_ASSERT_EQUALS(mDirectory[DIR(0xC0000000u)], (page_entry_t)(PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | PAGE_GLOBAL));
+    TS_ASSERT_EQUALS(mDirectory[DIR(0xC0000000u) + 1], (page_entry_t)(LARGE | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | PAGE_GLOBAL));
+
+    TS_ASSERT(mSpace->translate(0xC0000000u + LARGE + 0x12345, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)LARGE + 0x12345);
+    TS_ASSERT(!mSpace->translate(0xC0000000u + 2 * LARGE, &physical));
+
+    mSpace->unmap(0xC0000000u, 2 * LARGE);
+    TS_ASSERT_EQUALS(mDirectory[DIR(0xC0000000u)], (page_entry_t)0);
+    TS_ASSERT(!mSpace->translate(0xC0000000u, &physical));
+}
+
+
+void TestAddressSpace::testSmallPages(void)
+{
+    uint32_t frames = mAllocator->freeFrames();
+    uint64_t physical;
+
+    /* Unaligned ranges take a page table */
+    TS_ASSERT_EQUALS(mSpace->map(LARGE, 0x1235000, 3 * PAGE_FRAME_SIZE, PAGE_USER), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+    TS_ASSERT_EQUALS(mDirectory[1] & ~PAGE_ADDRESS_MASK, (page_entry_t)(PAGE_PRESENT | PAGE_WRITE | PAGE_USER));
+
+    TS_ASSERT(mSpace->translate(LARGE + 0x1abc, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)0x1236abc);
+    TS_ASSERT(!mSpace->translate(LARGE + 0x3000, &physical));
+
+    /* Another range in the same table */
+    TS_ASSERT_EQUALS(mSpace->map(2 * LARGE - PAGE_FRAME_SIZE, 0x2000000, PAGE_FRAME_SIZE, PAGE_WRITE), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+    TS_ASSERT(mSpace->translate(2 * LARGE - PAGE_FRAME_SIZE, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)0x2000000);
+}
+
+
+void TestAddressSpace::testMixedRange(void)
+{
+    uint32_t start = LARGE - PAGE_FRAME_SIZE;
+    uint32_t frames = mAllocator->freeFrames();
+    uint64_t physical;
+
+    /* Small pages up to the first large page boundary, then large pages, then small pages */
+    TS_ASSERT_EQUALS(mSpace->map(start, start, 2 * LARGE + 2 * PAGE_FRAME_SIZE, PAGE_WRITE), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 2);
+    TS_ASSERT_EQUALS(mDirectory[1] & PAGE_LARGE, (page_entry_t)PAGE_LARGE);
+    TS_ASSERT_EQUALS(mDirectory[2] & PAGE_LARGE, (page_entry_t)PAGE_LARGE);
+    TS_ASSERT_EQUALS(mDirectory[3] & PAGE_LARGE, (page_entry_t)0);
+
+    TS_ASSERT(mSpace->translate(start, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)start);
+    TS_ASSERT(mSpace->translate(3 * LARGE, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)3 * LARGE);
+
+    mSpace->unmap(start, 2 * LARGE + 2 * PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+}
+
+
+void TestAddressSpace::testUnmapReleasesTables(void)
+{
+    uint32_t frames = mAllocator->freeFrames();
+    uint64_t physical;
+
+    TS_ASSERT_EQUALS(mSpace->map(0x10000000, 0x100000, 16 * PAGE_FRAME_SIZE, PAGE_WRITE), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+
+    /* The table stays as long as a page is mapped */
+    mSpace->unmap(0x10000000, 8 * PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+    TS_ASSERT(!mSpace->translate(0x10007000, &physical));
+    TS_ASSERT(mSpace->translate(0x10008000, &physical));
+
+    /* Unmapping holes is fine */
+    mSpace->unmap(0x10000000 - LARGE, 3 * LARGE);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+    TS_ASSERT_EQUALS(mDirectory[DIR(0x10000000)], (page_entry_t)0);
+}
+
+
+void TestAddressSpace::testNoFrameForTables(void)
+{
+    uint64_t physical;
+    int i;
+
+    /* Take all frames but two: two page tables */
+    while (mAllocator->freeFrames() > 2) {
+        mAllocator->allocPages(0);
+    }
+
+    /* Misaligned sides: four tables, the third is missing, nothing stays mapped */
+    TS_ASSERT_EQUALS(mSpace->map(0x1000, 0x2000, 3 * LARGE, PAGE_WRITE), -1);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)2);
+    for (i = 0; i < 4; i++) {
+        TS_ASSERT_EQUALS(mDirectory[i], (page_entry_t)0);
+    }
+    TS_ASSERT(!mSpace->translate(0x1000, &physical));
+}
+
+
+void TestAddressSpace::testFeatures(void)
+{
+    AddressSpace space(mDirectory, 0, memory, mAllocator, 0);
+    uint32_t frames = mAllocator->freeFrames();
+
+    /* Without large pages nor global pages */
+    TS_ASSERT_EQUALS(space.map(0, 0, LARGE, PAGE_WRITE | PAGE_GLOBAL), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+    TS_ASSERT_EQUALS(mDirectory[0] & PAGE_LARGE, (page_entry_t)0);
+    TS_ASSERT_EQUALS(((page_entry_t*) (memory + (mDirectory[0] & PAGE_ADDRESS_MASK)))[5],
+                     (page_entry_t)(5 * PAGE_FRAME_SIZE | PAGE_PRESENT | PAGE_WRITE));
+}
+
+
+void TestAddressSpace::testSelfMap(void)
+{
+    uint32_t directory = (uint32_t) ((char*) mDirectory - memory);
+    uint32_t frames;
+    uint64_t physical, table;
+    int i;
+
+    TS_ASSERT_EQUALS(mSpace->map(LARGE, 0x1235000, 2 * PAGE_FRAME_SIZE, PAGE_WRITE), 0);
+    table = mDirectory[1] & PAGE_ADDRESS_MASK;
+
+    /* The last entries map the directories, as page tables */
+    mSpace->selfMap();
+    for (i = 0; i < PAGE_DIRECTORIES; i++) {
+        TS_ASSERT_EQUALS(mDirectory[PAGE_SELF_MAP_INDEX + i],
+                         (page_entry_t)((directory + i * PAGE_FRAME_SIZE) | PAGE_PRESENT | PAGE_WRITE));
+    }
+    TS_ASSERT(mSpace->translate(PAGE_SELF_DIRECTORY, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)directory);
+
+    /* Entries of any address are at computed addresses */
+    TS_ASSERT(mSpace->translate((uint32_t) (uintptr_t) PAGE_TABLE_ENTRY(LARGE + 0x1000), &physical));
+    TS_ASSERT_EQUALS(physical, table + sizeof(page_entry_t));
+    TS_ASSERT(mSpace->translate((uint32_t) (uintptr_t) PAGE_DIRECTORY_ENTRY(LARGE + 0x1000), &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)directory + sizeof(page_entry_t));
+    TS_ASSERT(!mSpace->translate((uint32_t) (uintptr_t) PAGE_TABLE_ENTRY(2 * LARGE), &physical));
+
+    /* Not the current address space: tables are still changed through the window */
+    frames = mAllocator->freeFrames();
+    TS_ASSERT_EQUALS(mSpace->map(2 * LARGE, 0x2000000, PAGE_FRAME_SIZE, PAGE_WRITE), 0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+    TS_ASSERT(mSpace->translate((uint32_t) (uintptr_t) PAGE_TABLE_ENTRY(2 * LARGE), &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)(mDirectory[2] & PAGE_ADDRESS_MASK));
+    mSpace->unmap(2 * LARGE, PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+}
+
+
+void TestAddressSpace::testFixedEntry(void)
+{
+    uint32_t frames = mAllocator->freeFrames();
+    page_entry_t *entry;
+    uint64_t physical;
+
+    /* The table is created, the entries are left to the caller */
+    entry = mSpace->fixedEntry(0x5000);
+    TS_ASSERT(entry != NULL);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 1);
+    TS_ASSERT_EQUALS(*entry, (page_entry_t)0);
+    TS_ASSERT_EQUALS(mSpace->fixedEntry(0x6000), entry + 1);
+
+    *entry = 0x7000 | PAGE_PRESENT | PAGE_WRITE;
+    TS_ASSERT(mSpace->translate(0x5123, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t)0x7123);
+}
+
+
+void TestAddressSpace::testHighPhysicalMemory(void)
+{
+#ifdef PAGING_PAE
+    uint64_t physical;
+
+    /* Frames above 4 GB, with small and large pages */
+    TS_ASSERT_EQUALS(mSpace->map(0x1000, 0x123456000ull, PAGE_FRAME_SIZE, PAGE_WRITE), 0);
+    TS_ASSERT(mSpace->translate(0x1abc, &physical));
+    TS_ASSERT_EQUALS(physical, 0x123456abcull);
+
+    TS_ASSERT_EQUALS(mSpace->map(0xC0000000u, 0xFC0000000ull, LARGE, PAGE_WRITE), 0);
+    TS_ASSERT(mSpace->translate(0xC0012345u, &physical));
+    TS_ASSERT_EQUALS(physical, 0xFC0012345ull);
+#else
+    TS_ASSERT_EQUALS(PAGE_FRAME_LIMIT, 0x100000000ull);
+#endif
+}
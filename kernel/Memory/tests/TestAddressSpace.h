@@ -0,0 +1,32 @@
+#ifndef _TEST_ADDRESS_SPACE_H_
+#define _TEST_ADDRESS_SPACE_H_
+
+#include "CxxTest/TestSuite.h"
+#include "Memory/AddressSpace.h"
+
+/* 256 kB of physical memory: page tables and the directories */
+#define TEST_SPACE_FRAMES   64
+
+class TestAddressSpace: public CxxTest::TestSuite {
+    private:
+        struct page_frame mFrames[TEST_SPACE_FRAMES];
+        PageFrameAllocator *mAllocator;
+        AddressSpace *mSpace;
+        page_entry_t *mDirectory;
+
+    public:
+        void setUp(void);
+        void tearDown(void);
+
+        void testLargePages(void);
+        void testSmallPages(void);
+        void testMixedRange(void);
+        void testUnmapReleasesTables(void);
+        void testNoFrameForTables(void);
+        void testFeatures(void);
+        void testSelfMap(void);
+        void testFixedEntry(void);
+        void testHighPhysicalMemory(void);
+};
+
+#endif /* _TEST_ADDRESS_SPACE_H_ */
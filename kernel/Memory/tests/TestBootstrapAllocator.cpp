@@ -2,9 +2,14 @@
 #include <string.h>
 #include <stdint.h>
 
+/* A 1 MB heap and the block map of its 2 MB arena */
+#define TEST_REGION     ((1 << 20) + BUDDY_MAP_SIZE(21))
+
+static char region[TEST_REGION] __attribute__((aligned(1 << 21)));
+
 void TestBootstrapAllocator::setUp(void)
 {
-    BootstrapAllocator::reset();
+    BootstrapAllocator::setup(region, TEST_REGION);
 }
 
 void TestBootstrapAllocator::tearDown(void)
@@ -24,6 +29,25 @@ void TestBootstrapAllocator::testSingleton(void)
     TS_ASSERT_EQUALS(a1, a2);
 }
 
+void TestBootstrapAllocator::testSetup(void)
+{
+    BootstrapAllocator *ba;
+    void *chunk;
+
+    /* The block map is taken from the end of the region */
+    ba = BootstrapAllocator::setup(region, TEST_REGION);
+    TS_ASSERT_EQUALS(ba, BootstrapAllocator::getInstance());
+    TS_ASSERT_EQUALS(ba->heapBase(), region);
+    TS_ASSERT_EQUALS(ba->heapSize(), (uint32_t)(1 << 20));
+
+    /* Any size: the heap is what the map leaves */
+    ba = BootstrapAllocator::setup(region, BOOTSTRAP_MIN_SIZE);
+    TS_ASSERT_EQUALS(ba->heapSize(), (uint32_t)(BOOTSTRAP_MIN_SIZE - BUDDY_MAP_SIZE(16)));
+    chunk = ba->alloc(ba->heapSize() / 2);
+    TS_ASSERT_EQUALS(chunk, (void*)region);
+    TS_ASSERT_EQUALS(ba->alloc(ba->heapSize() / 2), (void*)NULL);
+}
+
 void TestBootstrapAllocator::testReset(void)
 {
     uint32_t *chunk;
@@ -43,3 +67,37 @@ void TestBootstrapAllocator::testReset(void)
     TS_ASSERT_DIFFERS(chunk, (void*)NULL);
 }
 
+
+static size_t handedBytes;
+static bool handedAligned;
+
+static void countHandedOver(void *start, size_t length)
+{
+    handedBytes += length;
+    handedAligned = handedAligned && ((uintptr_t) start % PAGE_FRAME_SIZE) == 0;
+}
+
+void TestBootstrapAllocator::testHandOver(void)
+{
+    BootstrapAllocator *ba;
+    uint32_t *chunk;
+    size_t heapSize;
+
+    ba = BootstrapAllocator::getInstance();
+    heapSize = ba->heapSize();
+    chunk = (uint32_t*) ba->alloc(32);
+    *chunk = 0xDEADBEEFu;
+
+    /* Every free page but the one of the chunk is handed over */
+    handedBytes = 0;
+    handedAligned = true;
+    TS_ASSERT_EQUALS(ba->handOver(countHandedOver), heapSize - PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(handedBytes, heapSize - PAGE_FRAME_SIZE);
+    TS_ASSERT(handedAligned);
+
+    /* The chunk is untouched, small blocks are still served */
+    TS_ASSERT_EQUALS(*chunk, 0xDEADBEEFu);
+    TS_ASSERT_DIFFERS(ba->alloc(64), (void*)NULL);
+    TS_ASSERT_EQUALS(ba->alloc(PAGE_FRAME_SIZE), (void*)NULL);
+    TS_ASSERT_EQUALS(ba->handOver(countHandedOver), (size_t)0);
+}
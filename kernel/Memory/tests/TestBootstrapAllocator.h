@@ -10,7 +10,9 @@ class TestBootstrapAllocator: public CxxTest::TestSuite {
         void tearDown(void);
 
         void testSingleton(void);
+        void testSetup(void);
         void testReset(void);
+        void testHandOver(void);
 };
 
 #endif /* TESTBUDDYALLOCATOR_H_ */
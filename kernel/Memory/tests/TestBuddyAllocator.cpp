@@ -1,12 +1,22 @@
 #include "TestBuddyAllocator.h"
 #include <string.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include <signal.h>
+
+/* A failed assertion aborts: tests expecting one jump back from SIGABRT */
+static sigjmp_buf abortCatch;
+
+static void catchAbort(int)
+{
+   siglongjmp(abortCatch, 1);
+}
 
 void TestBuddyAllocator::setUp(void)
 {
    memset(mTZL, 0, sizeof(struct freeblock) * MAX_INDEX);
-   memset(mMemHeap, 0, 1 << MAX_INDEX);
-   mAllocator = new BuddyAllocator(mTZL, MAX_INDEX, mMemHeap, HEAP_SIZE);
+   mAllocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, HEAP_SIZE);
 }
 
 
@@ -23,12 +33,43 @@ void TestBuddyAllocator::testHeapSize(void)
     TS_ASSERT_EQUALS(heapSize, (uint32_t)HEAP_SIZE);
 }
 
+void TestBuddyAllocator::testPowerFromSize(void)
+{
+    uint32_t size, power;
+
+    /* Each size is served by the smallest block holding it */
+    power = BUDDY_MIN_POWER;
+    for (size = 1; size <= HEAP_SIZE; size++) {
+        if (size > (1u << power)) {
+            power++;
+        }
+        TS_ASSERT_EQUALS(BuddyAllocator::powerFromSize(size), power);
+    }
+}
+
+void TestBuddyAllocator::testSizesPastFourGigabytes(void)
+{
+    /* 4 GB + 16 wraps to 16 with a 32 bits size_t: only for 64 bits */
+    size_t huge = (size_t) 0xFFFFFFFFu + 17;
+
+    if (sizeof(size_t) <= sizeof(uint32_t)) {
+        return;
+    }
+
+    /* Never truncated to the low 32 bits, never handed out */
+    TS_ASSERT(BuddyAllocator::powerFromSize(huge) > BUDDY_MAX_POWER);
+    TS_ASSERT_EQUALS(mAllocator->alloc(huge), (void*)NULL);
+    TS_ASSERT_EQUALS(mAllocator->allocZeroed(huge), (void*)NULL);
+    TS_ASSERT_EQUALS(mAllocator->allocAligned(huge, 16), (void*)NULL);
+    TS_ASSERT_EQUALS(mAllocator->allocAligned(16, (size_t) 0xFFFFFFFFu + 1), (void*)NULL);
+}
+
 void TestBuddyAllocator::testSimpleAllocations(void)
 {
    void *m1 = NULL;
    void *m2 = NULL;
    void *mref = NULL;
-   uint32_t i1, i2, iref;
+   uintptr_t i1, i2, iref;
 
    mref = mAllocator->alloc(HEAP_SIZE);
    TS_ASSERT_DIFFERS(mref, (void*)NULL); 
@@ -44,10 +85,10 @@ void TestBuddyAllocator::testSimpleAllocations(void)
    TS_ASSERT_DIFFERS(m2, (void*)NULL); 
    memset(m2, 0, 1);
 
-   i1 = (uint32_t)m1;
-   i2 = (uint32_t)m2;
-   iref = (uint32_t)mref;
-   TS_ASSERT_EQUALS((i1 - iref) ^ (i2 - iref), (uint32_t)64);
+   i1 = (uintptr_t)m1;
+   i2 = (uintptr_t)m2;
+   iref = (uintptr_t)mref;
+   TS_ASSERT_EQUALS((i1 - iref) ^ (i2 - iref), (uintptr_t)64);
 
    mAllocator->free(m1, 64);
    mAllocator->free(m2, 64);
@@ -74,7 +115,7 @@ void TestBuddyAllocator::testCheckAddresses(void)
    void *m1 = NULL;
    void *m2 = NULL;
    void *mref = NULL;
-   uint32_t i1, i2, iref;
+   uintptr_t i1, i2, iref;
 
    mref = mAllocator->alloc(HEAP_SIZE);
    TS_ASSERT_DIFFERS(mref, (void*)NULL); 
@@ -90,36 +131,42 @@ void TestBuddyAllocator::testCheckAddresses(void)
    TS_ASSERT_DIFFERS(m2, (void*)NULL); 
    memset(m2, 0, 1);
 
-   i1 = (uint32_t)m1;
-   i2 = (uint32_t)m2;
-   iref = (uint32_t)mref;
-   TS_ASSERT_EQUALS((i1 - iref) ^ (i2 - iref), (uint32_t)64);
+   i1 = (uintptr_t)m1;
+   i2 = (uintptr_t)m2;
+   iref = (uintptr_t)mref;
+   TS_ASSERT_EQUALS((i1 - iref) ^ (i2 - iref), (uintptr_t)64);
 
    mAllocator->free(m1, 64);
    mAllocator->free(m2, 64);
 
-   TS_ASSERT((int)m1 >= (int)mref);
-   TS_ASSERT((int)m1 < ((int)mref + HEAP_SIZE));
-   TS_ASSERT((int)m2 >= (int)mref);
-   TS_ASSERT((int)m2 < ((int)mref + HEAP_SIZE));
+   TS_ASSERT(i1 >= iref);
+   TS_ASSERT(i1 < iref + HEAP_SIZE);
+   TS_ASSERT(i2 >= iref);
+   TS_ASSERT(i2 < iref + HEAP_SIZE);
 }
 
 void TestBuddyAllocator::testFullAllocationsBySizes(void)
 {
    void *chunk;
-   void *areas[HEAP_SIZE / 4];
+   static void *areas[HEAP_SIZE / BUDDY_MIN_SIZE];
 
    for (int allocSize = 4; allocSize <= HEAP_SIZE; allocSize <<= 1) {
+      /* Small requests are served with minimum sized blocks */
+      int count = HEAP_SIZE / ((allocSize < BUDDY_MIN_SIZE) ? BUDDY_MIN_SIZE : allocSize);
+
       /* Allocate all the memory in small chunks */
-      for (int i = 0; i < HEAP_SIZE / allocSize; i++) {
+      for (int i = 0; i < count; i++) {
          chunk = mAllocator->alloc(allocSize);
          TS_ASSERT_DIFFERS(chunk, (void*)NULL);
          areas[i] = chunk;
          chunk = NULL;
       }
 
+      /* Check the heap is exhausted */
+      TS_ASSERT_EQUALS(mAllocator->alloc(allocSize), (void*)NULL);
+
       /* Free it */
-      for (int i = 0; i < HEAP_SIZE / allocSize; i++) {
+      for (int i = 0; i < count; i++) {
          mAllocator->free(areas[i], allocSize);
       }
 
@@ -178,6 +225,661 @@ void TestBuddyAllocator::testSmallAllocations(void)
 }
 
 
+void TestBuddyAllocator::testInterleavedFrees(void)
+{
+   void *chunk;
+   static void *areas[HEAP_SIZE / BUDDY_MIN_SIZE];
+   const int count = HEAP_SIZE / BUDDY_MIN_SIZE;
+
+   for (int i = 0; i < count; i++) {
+      areas[i] = mAllocator->alloc(BUDDY_MIN_SIZE);
+      TS_ASSERT_DIFFERS(areas[i], (void*)NULL);
+   }
+
+   /* Free odd blocks first: no buddy can merge */
+   for (int i = 1; i < count; i += 2) {
+      mAllocator->free(areas[i], BUDDY_MIN_SIZE);
+   }
+   chunk = mAllocator->alloc(2 * BUDDY_MIN_SIZE);
+   TS_ASSERT_EQUALS(chunk, (void*)NULL);
+
+   /* Free even blocks, everything must merge back up to the whole heap */
+   for (int i = count - 2; i >= 0; i -= 2) {
+      mAllocator->free(areas[i], BUDDY_MIN_SIZE);
+   }
+   chunk = mAllocator->alloc(HEAP_SIZE);
+   TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+   mAllocator->free(chunk, HEAP_SIZE);
+}
+
+
+void TestBuddyAllocator::testRefillFragmentedHeap(void)
+{
+   void *chunk;
+   static void *areas[HEAP_SIZE / BUDDY_MIN_SIZE];
+   const int count = HEAP_SIZE / BUDDY_MIN_SIZE;
+   int i, live;
+
+   for (i = 0; i < count; i++) {
+      areas[i] = mAllocator->alloc(BUDDY_MIN_SIZE);
+      TS_ASSERT_DIFFERS(areas[i], (void*)NULL);
+   }
+
+   /* Keep one block in ten, scattered over the heap: an odd stride visits every block */
+   live = count / 10;
+   for (i = live; i < count; i++) {
+      mAllocator->free(areas[(i * 7919) % count]);
+      areas[(i * 7919) % count] = NULL;
+   }
+
+   /* The holes are filled again up to 90% */
+   for (i = 0; i < count && live < count / 10 * 9; i++) {
+      if (areas[i] == NULL) {
+         areas[i] = mAllocator->alloc(BUDDY_MIN_SIZE);
+         TS_ASSERT_DIFFERS(areas[i], (void*)NULL);
+         live++;
+      }
+   }
+
+   /* Everything merges back */
+   for (i = 0; i < count; i++) {
+      mAllocator->free(areas[i]);
+   }
+   chunk = mAllocator->alloc(HEAP_SIZE);
+   TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+   mAllocator->free(chunk);
+}
+
+
+void TestBuddyAllocator::testSizelessFree(void)
+{
+   void *chunk;
+   void *areas[MAX_INDEX];
+
+   /* Allocate one chunk of each size, free them without their size */
+   for (int i = MAX_INDEX - 1; i >= BUDDY_MIN_POWER; i--) {
+      areas[i] = mAllocator->alloc((1 << i) - 1);
+      TS_ASSERT_DIFFERS(areas[i], (void*)NULL);
+   }
+
+   for (int i = BUDDY_MIN_POWER; i < MAX_INDEX; i++) {
+      mAllocator->free(areas[i]);
+   }
+
+   /* Check memory have been released */
+   chunk = mAllocator->alloc(HEAP_SIZE);
+   TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+   mAllocator->free(chunk);
+}
+
+
+void TestBuddyAllocator::testChunkSize(void)
+{
+   void *m1;
+   void *m2;
+
+   m1 = mAllocator->alloc(1);
+   m2 = mAllocator->alloc(100);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m1), (size_t)BUDDY_MIN_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m2), (size_t)128);
+
+   /* Free blocks and addresses outside the heap have no size */
+   mAllocator->free(m2);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m2), (size_t)0);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(mMemHeap + HEAP_SIZE), (size_t)0);
+
+   mAllocator->free(m1);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m1), (size_t)0);
+}
+
+
+void TestBuddyAllocator::testOddSizedHeap(void)
+{
+   BuddyAllocator *allocator;
+   static void *areas[HEAP_SIZE / BUDDY_MIN_SIZE];
+   const uint32_t heapSize = HEAP_SIZE / 2 + HEAP_SIZE / 4 + 5 * BUDDY_MIN_SIZE + 3;
+   const int count = heapSize / BUDDY_MIN_SIZE;
+   void *chunk;
+
+   /* Only the whole minimum blocks of the heap are usable */
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, heapSize);
+   TS_ASSERT_EQUALS(allocator->heapSize(), (uint32_t) count * BUDDY_MIN_SIZE);
+
+   /* The arena can't be allocated as a whole, its largest block can */
+   TS_ASSERT_EQUALS(allocator->alloc(HEAP_SIZE), (void*)NULL);
+   chunk = allocator->alloc(HEAP_SIZE / 2);
+   TS_ASSERT_EQUALS(chunk, (void*)mMemHeap);
+   allocator->free(chunk);
+
+   /* Every minimum block is handed out once, none out of the heap */
+   for (int i = 0; i < count; i++) {
+      areas[i] = allocator->alloc(BUDDY_MIN_SIZE);
+      TS_ASSERT_DIFFERS(areas[i], (void*)NULL);
+      TS_ASSERT((char*) areas[i] + BUDDY_MIN_SIZE <= mMemHeap + heapSize);
+   }
+   TS_ASSERT_EQUALS(allocator->alloc(BUDDY_MIN_SIZE), (void*)NULL);
+
+   /* Everything merges back, but never past the end of the heap */
+   for (int i = 0; i < count; i++) {
+      allocator->free(areas[i]);
+   }
+   chunk = allocator->alloc(HEAP_SIZE / 2);
+   TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+   TS_ASSERT_DIFFERS(allocator->alloc(HEAP_SIZE / 4), (void*)NULL);
+   TS_ASSERT_EQUALS(allocator->alloc(HEAP_SIZE / 4), (void*)NULL);
+
+   delete allocator;
+}
+
+
+void TestBuddyAllocator::testMultipleRegions(void)
+{
+   BuddyAllocator *allocator;
+   void *chunk;
+   char *c;
+   int count;
+
+   /* Start with an empty arena */
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, 0);
+   TS_ASSERT_EQUALS(allocator->heapSize(), (uint32_t)0);
+   TS_ASSERT_EQUALS(allocator->alloc(1), (void*)NULL);
+
+   /* Two unaligned regions with a hole between them */
+   allocator->addRegion(mMemHeap + 4096 + 7, 3 * 4096);
+   allocator->addRegion(mMemHeap + HEAP_SIZE / 2, HEAP_SIZE / 4 + 100);
+   TS_ASSERT_EQUALS(allocator->heapSize(),
+                    (uint32_t) (3 * 4096 - BUDDY_MIN_SIZE + HEAP_SIZE / 4 + 96));
+
+   /* Chunks only come from the regions */
+   count = 0;
+   while ((c = (char*) allocator->alloc(BUDDY_MIN_SIZE)) != NULL) {
+      TS_ASSERT((c >= mMemHeap + 4096 + 16 && c + BUDDY_MIN_SIZE <= mMemHeap + 4 * 4096)
+                || (c >= mMemHeap + HEAP_SIZE / 2
+                    && c + BUDDY_MIN_SIZE <= mMemHeap + HEAP_SIZE / 2 + HEAP_SIZE / 4 + 96));
+      count++;
+   }
+   TS_ASSERT_EQUALS((uint32_t) count * BUDDY_MIN_SIZE, allocator->heapSize());
+   delete allocator;
+
+   /* Adjacent regions merge with each other */
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, 0);
+   allocator->addRegion(mMemHeap + HEAP_SIZE / 2, HEAP_SIZE / 2);
+   allocator->addRegion(mMemHeap + HEAP_SIZE / 4, HEAP_SIZE / 4);
+   allocator->addRegion(mMemHeap, HEAP_SIZE / 4);
+   chunk = allocator->alloc(HEAP_SIZE);
+   TS_ASSERT_EQUALS(chunk, (void*)mMemHeap);
+   allocator->free(chunk);
+   delete allocator;
+}
+
+void TestBuddyAllocator::testOverlappingRegions(void)
+{
+   BuddyAllocator *allocator;
+   void (*previous)(int);
+   void *chunk;
+
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, 0);
+   allocator->addRegion(mMemHeap + 64 * 1024, 64 * 1024);
+   allocator->addRegion(mMemHeap + HEAP_SIZE / 2, HEAP_SIZE / 2);
+   chunk = allocator->alloc(64 * 1024);
+   TS_ASSERT_EQUALS(chunk, (void*)(mMemHeap + 64 * 1024));
+
+   previous = signal(SIGABRT, catchAbort);
+
+   /* A region whose first block is free but runs over a chunk */
+   if (sigsetjmp(abortCatch, 1) == 0) {
+      allocator->addRegion(mMemHeap, 192 * 1024);
+      TS_FAIL("region over an allocated chunk not caught");
+   }
+
+   /* A region inside a free block */
+   if (sigsetjmp(abortCatch, 1) == 0) {
+      allocator->addRegion(mMemHeap + HEAP_SIZE / 2 + 4096, 4096);
+      TS_FAIL("region inside a free block not caught");
+   }
+
+   signal(SIGABRT, previous);
+
+   /* Nothing was added */
+   TS_ASSERT_EQUALS(allocator->heapSize(), (uint32_t) (64 * 1024 + HEAP_SIZE / 2));
+   allocator->free(chunk);
+   TS_ASSERT_EQUALS(allocator->alloc(HEAP_SIZE / 2), (void*)(mMemHeap + HEAP_SIZE / 2));
+   delete allocator;
+}
+
+
+bool TestBuddyAllocator::isZero(void *chunk, size_t size)
+{
+   for (size_t i = 0; i < size; i++) {
+      if (((char*) chunk)[i] != 0) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+void TestBuddyAllocator::testAllocZeroed(void)
+{
+   void *chunks[4];
+
+   /* The heap is dirty: allocated memory is cleared */
+   for (int i = 0; i < 4; i++) {
+      chunks[i] = mAllocator->alloc(4096);
+      memset(chunks[i], 0xA5, 4096);
+   }
+   for (int i = 0; i < 4; i++) {
+      mAllocator->free(chunks[i]);
+   }
+
+   chunks[0] = mAllocator->allocZeroed(100);
+   TS_ASSERT_DIFFERS(chunks[0], (void*)NULL);
+   TS_ASSERT(isZero(chunks[0], 100));
+   chunks[1] = mAllocator->allocZeroed(3 * 4096);
+   TS_ASSERT_DIFFERS(chunks[1], (void*)NULL);
+   TS_ASSERT(isZero(chunks[1], 3 * 4096));
+
+   mAllocator->free(chunks[0]);
+   mAllocator->free(chunks[1]);
+   TS_ASSERT_EQUALS(mAllocator->allocZeroed(0), (void*)NULL);
+   TS_ASSERT_DIFFERS(mAllocator->allocZeroed(HEAP_SIZE), (void*)NULL);
+}
+
+
+void TestBuddyAllocator::testLazyZeroing(void)
+{
+   BuddyAllocator *allocator;
+   char *chunk;
+
+   /* Lie about a heap being clean: only the links get cleared */
+   memset(mMemHeap, 0xA5, HEAP_SIZE);
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, HEAP_SIZE, true);
+   chunk = (char*) allocator->allocZeroed(256);
+   TS_ASSERT_EQUALS(chunk, mMemHeap);
+   TS_ASSERT(isZero(chunk, sizeof(struct freeblock)));
+   TS_ASSERT_EQUALS(chunk[255], (char)0xA5);
+
+   /* Split blocks stay clean */
+   chunk = (char*) allocator->allocZeroed(HEAP_SIZE / 2);
+   TS_ASSERT_EQUALS(chunk, mMemHeap + HEAP_SIZE / 2);
+   TS_ASSERT_EQUALS(chunk[HEAP_SIZE / 2 - 1], (char)0xA5);
+   allocator->free(chunk);
+
+   /* Freed memory is dirty */
+   chunk = (char*) allocator->allocZeroed(HEAP_SIZE / 2);
+   TS_ASSERT(isZero(chunk, HEAP_SIZE / 2));
+   allocator->free(chunk);
+   delete allocator;
+
+   /* Clean buddies stay clean when they merge */
+   memset(mMemHeap, 0xA5, HEAP_SIZE);
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, 0);
+   allocator->addRegion(mMemHeap + HEAP_SIZE / 2, HEAP_SIZE / 2, true);
+   allocator->addRegion(mMemHeap, HEAP_SIZE / 2, true);
+   chunk = (char*) allocator->allocZeroed(HEAP_SIZE);
+   TS_ASSERT_EQUALS(chunk, mMemHeap);
+   TS_ASSERT(isZero(mMemHeap + HEAP_SIZE / 2, sizeof(struct freeblock)));
+   TS_ASSERT_EQUALS(chunk[HEAP_SIZE - 1], (char)0xA5);
+   allocator->free(chunk);
+   delete allocator;
+}
+
+
+void TestBuddyAllocator::testScrub(void)
+{
+   char *chunk;
+
+   chunk = (char*) mAllocator->alloc(HEAP_SIZE / 2);
+   memset(chunk, 0xA5, HEAP_SIZE / 2);
+   mAllocator->free(chunk);
+
+   /* Whole blocks are zeroed until the budget is reached */
+   TS_ASSERT_EQUALS(mAllocator->scrub(1), (size_t)HEAP_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->scrub(HEAP_SIZE), (size_t)0);
+
+   /* Scrubbed memory is clean, allocZeroed only clears the links */
+   memset(mMemHeap + HEAP_SIZE - 16, 0xA5, 16);
+   chunk = (char*) mAllocator->allocZeroed(HEAP_SIZE);
+   TS_ASSERT(isZero(chunk, HEAP_SIZE - 16));
+   TS_ASSERT_EQUALS(chunk[HEAP_SIZE - 1], (char)0xA5);
+   mAllocator->free(chunk);
+
+   /* Splitting keeps blocks clean, freeing dirties them */
+   TS_ASSERT_EQUALS(mAllocator->scrub(HEAP_SIZE), (size_t)HEAP_SIZE);
+   chunk = (char*) mAllocator->alloc(BUDDY_MIN_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->scrub(HEAP_SIZE), (size_t)0);
+   mAllocator->free(chunk);
+   TS_ASSERT_EQUALS(mAllocator->scrub(HEAP_SIZE), (size_t)HEAP_SIZE);
+}
+
+
+void TestBuddyAllocator::testZeroedBytes(void)
+{
+   BuddyAllocator *allocator;
+   struct buddy_stats stats;
+   void *chunk;
+
+   /* A dirty heap is cleared as it is handed out */
+   chunk = mAllocator->allocZeroed(HEAP_SIZE);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.zeroedBytes, (uint32_t)HEAP_SIZE);
+   mAllocator->free(chunk);
+
+   /* A heap known to be clean only gets the links of its block cleared */
+   allocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, HEAP_SIZE, true);
+   chunk = allocator->allocZeroed(HEAP_SIZE);
+   allocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.zeroedBytes, (uint32_t)sizeof(struct freeblock));
+
+   /* Freed memory is dirty: scrubbing clears it ahead of allocZeroed */
+   allocator->free(chunk);
+   TS_ASSERT_EQUALS(allocator->scrub(HEAP_SIZE), (size_t)HEAP_SIZE);
+   chunk = allocator->allocZeroed(HEAP_SIZE);
+   allocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.zeroedBytes, (uint32_t)(HEAP_SIZE + sizeof(struct freeblock)));
+   allocator->free(chunk);
+   delete allocator;
+}
+
+
+void TestBuddyAllocator::testStats(void)
+{
+   struct buddy_stats stats;
+   uint32_t power;
+   void *chunk;
+
+   /* A minimum sized block splits the whole heap */
+   chunk = mAllocator->alloc(BUDDY_MIN_SIZE);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.allocs[BUDDY_MIN_POWER], (uint32_t)1);
+   TS_ASSERT_EQUALS(stats.usedBytes, (uint32_t)BUDDY_MIN_SIZE);
+   TS_ASSERT_EQUALS(stats.highWater, (uint32_t)BUDDY_MIN_SIZE);
+   for (power = BUDDY_MIN_POWER; power < MAX_INDEX; power++) {
+      TS_ASSERT_EQUALS(stats.splits[power + 1], (uint32_t)1);
+      TS_ASSERT_EQUALS(stats.freeBlocks[power], (uint32_t)1);
+   }
+   TS_ASSERT_EQUALS(stats.freeBlocks[MAX_INDEX], (uint32_t)0);
+
+   /* Freeing it merges everything back */
+   mAllocator->free(chunk);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.frees[BUDDY_MIN_POWER], (uint32_t)1);
+   TS_ASSERT_EQUALS(stats.usedBytes, (uint32_t)0);
+   TS_ASSERT_EQUALS(stats.highWater, (uint32_t)BUDDY_MIN_SIZE);
+   for (power = BUDDY_MIN_POWER; power < MAX_INDEX; power++) {
+      TS_ASSERT_EQUALS(stats.merges[power + 1], (uint32_t)1);
+      TS_ASSERT_EQUALS(stats.freeBlocks[power], (uint32_t)0);
+   }
+   TS_ASSERT_EQUALS(stats.freeBlocks[MAX_INDEX], (uint32_t)1);
+
+   /* Failures, whether the heap is too small or full */
+   TS_ASSERT_EQUALS(mAllocator->alloc(HEAP_SIZE + 1), (void*)NULL);
+   chunk = mAllocator->alloc(HEAP_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->alloc(BUDDY_MIN_SIZE), (void*)NULL);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.failedAllocs, (uint32_t)2);
+   TS_ASSERT_EQUALS(stats.highWater, (uint32_t)HEAP_SIZE);
+   mAllocator->free(chunk);
+}
+
+
+void TestBuddyAllocator::testFragmentationIndex(void)
+{
+   void *chunk;
+
+   /* The whole heap is free in one block */
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(BUDDY_MIN_POWER), (uint32_t)0);
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(MAX_INDEX), (uint32_t)0);
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(MAX_INDEX + 1), (uint32_t)1000);
+
+   /* A small block leaves one free block of each smaller size */
+   chunk = mAllocator->alloc(BUDDY_MIN_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(BUDDY_MIN_POWER), (uint32_t)0);
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(MAX_INDEX - 1),
+                    (uint32_t)((uint64_t)(HEAP_SIZE / 2 - BUDDY_MIN_SIZE) * 1000 / (HEAP_SIZE - BUDDY_MIN_SIZE)));
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(MAX_INDEX), (uint32_t)1000);
+   mAllocator->free(chunk);
+
+   /* Nothing free, nothing can be served */
+   chunk = mAllocator->alloc(HEAP_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->fragmentationIndex(BUDDY_MIN_POWER), (uint32_t)1000);
+   mAllocator->free(chunk);
+}
+
+
+#ifdef BUDDY_TRACE
+/* Last lines of the trace dump */
+static char traceLines[3][64];
+
+static void traceCapture(const char *str, int len)
+{
+   memmove(traceLines[0], traceLines[1], sizeof(traceLines) - sizeof(traceLines[0]));
+   memcpy(traceLines[2], str, len);
+   traceLines[2][len] = '\0';
+}
+#endif
+
+void TestBuddyAllocator::testTrace(void)
+{
+#ifdef BUDDY_TRACE
+   char expected[64];
+   void *chunk;
+
+   chunk = mAllocator->alloc(100);
+   mAllocator->free(chunk);
+   mAllocator->alloc(HEAP_SIZE + 1);
+   BuddyAllocator::dumpTrace(traceCapture);
+
+   /* Allocation, free, failed allocation, followed by their time stamps */
+   sprintf(expected, "a 100 %x ", (uint32_t)(uintptr_t)chunk);
+   TS_ASSERT_EQUALS(strncmp(traceLines[0], expected, strlen(expected)), 0);
+   sprintf(expected, "f %x ", (uint32_t)(uintptr_t)chunk);
+   TS_ASSERT_EQUALS(strncmp(traceLines[1], expected, strlen(expected)), 0);
+   sprintf(expected, "a %u 0 ", HEAP_SIZE + 1);
+   TS_ASSERT_EQUALS(strncmp(traceLines[2], expected, strlen(expected)), 0);
+#endif
+}
+
+
+void TestBuddyAllocator::testStaticAllocator(void)
+{
+   typedef BasicBuddyAllocator<BUDDY_MIN_POWER, MAX_INDEX> StaticBuddyAllocator;
+   StaticBuddyAllocator *allocator;
+   void *chunks[HEAP_SIZE / 1024];
+   void *chunk;
+   unsigned int i;
+
+   /* Same arena as the runtime sized allocator */
+   delete mAllocator;
+   TS_ASSERT_EQUALS(StaticBuddyAllocator::MAP_SIZE, (uint32_t)BUDDY_MAP_SIZE(MAX_INDEX));
+   allocator = new StaticBuddyAllocator(mBlockMap, mMemHeap, HEAP_SIZE);
+   TS_ASSERT_EQUALS(allocator->heapSize(), (uint32_t)HEAP_SIZE);
+
+   chunk = allocator->alloc(HEAP_SIZE);
+   TS_ASSERT_EQUALS(chunk, (void*)mMemHeap);
+   TS_ASSERT_EQUALS(allocator->alloc(1), (void*)NULL);
+   allocator->free(chunk);
+
+   for (i = 0; i < HEAP_SIZE / 1024; i++) {
+      chunks[i] = allocator->alloc(1000);
+      TS_ASSERT_DIFFERS(chunks[i], (void*)NULL);
+      TS_ASSERT_EQUALS(allocator->chunkSize(chunks[i]), (size_t)1024);
+   }
+   TS_ASSERT_EQUALS(allocator->alloc(1), (void*)NULL);
+   for (i = 0; i < HEAP_SIZE / 1024; i += 2) {
+      allocator->free(chunks[i]);
+   }
+   for (i = 1; i < HEAP_SIZE / 1024; i += 2) {
+      allocator->free(chunks[i], 1000);
+   }
+
+   /* Everything merged back */
+   TS_ASSERT_EQUALS(allocator->alloc(HEAP_SIZE), (void*)mMemHeap);
+   delete allocator;
+
+   mAllocator = new BuddyAllocator(mTZL, MAX_INDEX, mBlockMap, mMemHeap, HEAP_SIZE);
+}
+
+
+void TestBuddyAllocator::testLazyCoalescing(void)
+{
+   struct buddy_stats stats;
+   void *chunks[5];
+   void *chunk;
+   int i;
+
+   mAllocator->setLazyCoalescing(4, 0);
+   chunk = mAllocator->alloc(BUDDY_MIN_SIZE);
+
+   /* The freed block is taken back without any merge or split */
+   mAllocator->free(chunk);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(chunk), (size_t)0);
+   TS_ASSERT_EQUALS(mAllocator->alloc(BUDDY_MIN_SIZE), chunk);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.merges[BUDDY_MIN_POWER + 1], (uint32_t)0);
+   TS_ASSERT_EQUALS(stats.splits[BUDDY_MIN_POWER + 1], (uint32_t)1);
+   TS_ASSERT_EQUALS(stats.deferredFrees, (uint32_t)1);
+   mAllocator->free(chunk);
+
+   /* Only 4 blocks of a size are kept apart */
+   for (i = 0; i < 5; i++) {
+      chunks[i] = mAllocator->alloc(BUDDY_MIN_SIZE);
+   }
+   for (i = 0; i < 5; i++) {
+      mAllocator->free(chunks[i]);
+   }
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.deferredFrees, (uint32_t)2 + 4);
+
+   /* Coalescing gives back the whole heap */
+   mAllocator->coalesce();
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.freeBlocks[MAX_INDEX], (uint32_t)1);
+   TS_ASSERT_EQUALS(stats.coalesceRuns, (uint32_t)1);
+   TS_ASSERT_EQUALS(mAllocator->alloc(HEAP_SIZE), (void*)mMemHeap);
+}
+
+
+void TestBuddyAllocator::testLazyCoalescingPressure(void)
+{
+   struct buddy_stats stats;
+   void *chunk;
+
+   /* No fitting block: unmerged blocks are merged */
+   mAllocator->setLazyCoalescing(4, 0);
+   chunk = mAllocator->alloc(HEAP_SIZE / 2);
+   mAllocator->free(chunk);
+   chunk = mAllocator->alloc(HEAP_SIZE);
+   TS_ASSERT_EQUALS(chunk, (void*)mMemHeap);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.failedAllocs, (uint32_t)0);
+   mAllocator->free(chunk);
+
+   /* Under the watermark, frees merge at once */
+   mAllocator->setLazyCoalescing(4, HEAP_SIZE + 1);
+   chunk = mAllocator->alloc(BUDDY_MIN_SIZE);
+   mAllocator->free(chunk);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.deferredFrees, (uint32_t)1);
+   TS_ASSERT_EQUALS(stats.freeBlocks[MAX_INDEX], (uint32_t)1);
+
+   /* Crossing the watermark merges blocks kept apart */
+   mAllocator->setLazyCoalescing(4, HEAP_SIZE / 2 + 1);
+   chunk = mAllocator->alloc(BUDDY_MIN_SIZE);
+   mAllocator->free(chunk);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.deferredFrees, (uint32_t)2);
+   TS_ASSERT_EQUALS(stats.freeBlocks[BUDDY_MIN_POWER], (uint32_t)2);
+
+   chunk = mAllocator->alloc(HEAP_SIZE / 2);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.freeBlocks[BUDDY_MIN_POWER], (uint32_t)0);
+   TS_ASSERT_EQUALS(stats.freeBlocks[MAX_INDEX - 1], (uint32_t)1);
+   mAllocator->free(chunk);
+}
+
+
+void TestBuddyAllocator::testAllocAligned(void)
+{
+   struct buddy_stats stats;
+   void *m1;
+   void *m2;
+   void *m3;
+
+   /* Only the minimum blocks the chunk covers are taken */
+   m1 = mAllocator->allocAligned(48 * 1024, 4096);
+   TS_ASSERT_EQUALS(m1, (void*)mMemHeap);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m1), (size_t)48 * 1024);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.usedBytes, (uint32_t)48 * 1024);
+   TS_ASSERT_EQUALS(stats.freeBlocks[14], (uint32_t)1);
+
+   /* Every address of the chunk belongs to it */
+   TS_ASSERT_EQUALS(mAllocator->chunkOf((char*)m1 + 40 * 1024), m1);
+   TS_ASSERT_EQUALS(mAllocator->chunkOf((char*)m1 + 48 * 1024 - 1), m1);
+
+   /* The rest of the block is handed out */
+   m2 = mAllocator->alloc(16 * 1024);
+   TS_ASSERT_EQUALS(m2, (void*)(mMemHeap + 48 * 1024));
+
+   /* Larger alignments than the size give back the end of the block */
+   m3 = mAllocator->allocAligned(100, 64 * 1024);
+   TS_ASSERT_EQUALS((uintptr_t)m3 % (64 * 1024), 0u);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m3), (size_t)112);
+   TS_ASSERT_EQUALS(mAllocator->chunkOf((char*)m3 + 100), m3);
+
+   /* Freed chunks merge back whole */
+   mAllocator->free(m3, 100);
+   mAllocator->free(m1, 48 * 1024);
+   mAllocator->free(m2);
+   mAllocator->getStats(&stats);
+   TS_ASSERT_EQUALS(stats.usedBytes, (uint32_t)0);
+   TS_ASSERT_EQUALS(stats.freeBlocks[MAX_INDEX], (uint32_t)1);
+
+   /* Power of two sizes are one block, like alloc() */
+   m1 = mAllocator->allocAligned(4096, BUDDY_MIN_SIZE);
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m1), (size_t)4096);
+   mAllocator->free(m1);
+
+   /* Too large, and lazily freed blocks are merged to make room */
+   TS_ASSERT_EQUALS(mAllocator->allocAligned(HEAP_SIZE + 1, 1), (void*)NULL);
+   mAllocator->setLazyCoalescing(4, 0);
+   m1 = mAllocator->allocAligned(HEAP_SIZE / 2 + BUDDY_MIN_SIZE, BUDDY_MIN_SIZE);
+   mAllocator->free(m1);
+   m1 = mAllocator->allocAligned(HEAP_SIZE, HEAP_SIZE);
+   TS_ASSERT_EQUALS(m1, (void*)mMemHeap);
+   mAllocator->free(m1);
+}
+
+void TestBuddyAllocator::testAllocAlignedBelow(void)
+{
+   void *m1;
+   void *m2;
+   void *m3;
+
+   /* The lower half is taken, only a block of the upper half is free */
+   m1 = mAllocator->alloc(HEAP_SIZE / 2);
+   m2 = mAllocator->alloc(1024);
+   TS_ASSERT_EQUALS(m2, (void*)(mMemHeap + HEAP_SIZE / 2));
+
+   /* The limit skips the blocks that don't end below it */
+   TS_ASSERT_EQUALS(mAllocator->allocAligned(4096, 4096, mMemHeap + HEAP_SIZE / 2 + 4096),
+                    (void*)NULL);
+   m3 = mAllocator->allocAligned(3000, 1024, mMemHeap + HEAP_SIZE / 2 + 8192);
+   TS_ASSERT_EQUALS(m3, (void*)(mMemHeap + HEAP_SIZE / 2 + 4096));
+   TS_ASSERT_EQUALS(mAllocator->chunkSize(m3), (size_t)3008);
+   mAllocator->free(m3);
+
+   /* A chunk carved from the beginning of a larger block */
+   m3 = mAllocator->allocAligned(5000, 4096, mMemHeap + HEAP_SIZE / 2 + 16 * 1024);
+   TS_ASSERT_EQUALS(m3, (void*)(mMemHeap + HEAP_SIZE / 2 + 8192));
+   mAllocator->free(m3);
+
+   mAllocator->free(m2);
+   mAllocator->free(m1);
+}
+
+
 void TestBuddyAllocator::testBadAllocationRequests(void)
 {
    void *chunk;
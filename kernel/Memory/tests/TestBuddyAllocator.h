@@ -9,8 +9,14 @@
 
 class TestBuddyAllocator: public CxxTest::TestSuite {
 private:
+   /**
+    * Check a chunk only holds zeros.
+    */
+   bool isZero(void *chunk, size_t size);
+
    struct freeblock mTZL[MAX_INDEX];
-   char mMemHeap[1 << MAX_INDEX];
+   uint8_t mBlockMap[BUDDY_MAP_SIZE(MAX_INDEX)];
+   char mMemHeap[1 << MAX_INDEX] __attribute__((aligned(HEAP_SIZE)));
    BuddyAllocator* mAllocator;
 
 public:
@@ -18,12 +24,33 @@ public:
 	void tearDown(void);
 
     void testHeapSize(void);
+    void testPowerFromSize(void);
+    void testSizesPastFourGigabytes(void);
     void testSimpleAllocations(void);
     void testFreeBoundaries(void);
     void testCheckAddresses(void);
     void testFullAllocationsBySizes(void);
     void testAllocateOneOfEachSize(void);
     void testSmallAllocations(void);
+    void testInterleavedFrees(void);
+    void testRefillFragmentedHeap(void);
+    void testSizelessFree(void);
+    void testChunkSize(void);
+    void testOddSizedHeap(void);
+    void testMultipleRegions(void);
+    void testOverlappingRegions(void);
+    void testAllocZeroed(void);
+    void testLazyZeroing(void);
+    void testScrub(void);
+    void testZeroedBytes(void);
+    void testStats(void);
+    void testFragmentationIndex(void);
+    void testTrace(void);
+    void testStaticAllocator(void);
+    void testLazyCoalescing(void);
+    void testLazyCoalescingPressure(void);
+    void testAllocAligned(void);
+    void testAllocAlignedBelow(void);
 
     void testBadAllocationRequests(void);
     void testBadFreeRequests(void);
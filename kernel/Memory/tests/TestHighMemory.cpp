@@ -0,0 +1,88 @@
+#include "TestHighMemory.h"
+#include <string.h>
+#include <stdint.h>
+
+#define PAGE    PAGE_FRAME_SIZE
+
+/* Physical memory of the tests, the window of the address space */
+static char memory[TEST_HIGH_FRAMES * PAGE_FRAME_SIZE] __attribute__((aligned(PAGE_FRAME_SIZE)));
+
+void TestHighMemory::setUp(void)
+{
+    uint64_t directory;
+
+    mAllocator = new PageFrameAllocator(mFrames, TEST_HIGH_FRAMES);
+    mAllocator->addRange(0, sizeof(memory));
+    directory = mAllocator->allocPages((PAGE_DIRECTORIES == 4) ? 2 : 0);
+    memset(memory + directory, 0, PAGE_DIRECTORIES * PAGE_FRAME_SIZE);
+    mSpace = new AddressSpace((page_entry_t*) (memory + directory), (uint32_t) directory, memory,
+                              mAllocator, PAGE_LARGE | PAGE_GLOBAL);
+    mHigh = new HighMemory(mSpace, KMAP_START);
+}
+
+
+void TestHighMemory::tearDown(void)
+{
+    delete mHigh;
+    delete mSpace;
+    delete mAllocator;
+}
+
+
+void TestHighMemory::testNormalFrame(void)
+{
+    /* Already in the window, no slot taken */
+    TS_ASSERT_EQUALS(mHigh->map(3 * PAGE), (void*) (memory + 3 * PAGE));
+    TS_ASSERT_EQUALS(mHigh->map(PAGE_ZONE_NORMAL_END - PAGE),
+                     (void*) (memory + PAGE_ZONE_NORMAL_END - PAGE));
+    TS_ASSERT_EQUALS(mHigh->usedSlots(), (uint32_t)0);
+
+    mHigh->unmap(memory + 3 * PAGE);
+    TS_ASSERT_EQUALS(mHigh->usedSlots(), (uint32_t)0);
+}
+
+
+void TestHighMemory::testHighFrame(void)
+{
+    uint64_t physical;
+    void *a, *b;
+
+    /* Slots in order from the start of the window */
+    a = mHigh->map(TEST_HIGH_FRAME);
+    b = mHigh->map(PAGE_ZONE_NORMAL_END);
+    TS_ASSERT_EQUALS(a, (void*) (uintptr_t) KMAP_START);
+    TS_ASSERT_EQUALS(b, (void*) (uintptr_t) (KMAP_START + PAGE));
+    TS_ASSERT_EQUALS(mHigh->usedSlots(), (uint32_t)2);
+
+    TS_ASSERT(mSpace->translate(KMAP_START + 0x123, &physical));
+    TS_ASSERT_EQUALS(physical, TEST_HIGH_FRAME + 0x123);
+    TS_ASSERT(mSpace->translate(KMAP_START + PAGE, &physical));
+    TS_ASSERT_EQUALS(physical, (uint64_t) PAGE_ZONE_NORMAL_END);
+
+    /* Given back, the slot is unmapped and reused first */
+    mHigh->unmap(a);
+    TS_ASSERT(!mSpace->translate(KMAP_START, &physical));
+    TS_ASSERT_EQUALS(mHigh->usedSlots(), (uint32_t)1);
+    TS_ASSERT_EQUALS(mHigh->map(TEST_HIGH_FRAME + PAGE), a);
+    TS_ASSERT(mSpace->translate(KMAP_START, &physical));
+    TS_ASSERT_EQUALS(physical, TEST_HIGH_FRAME + PAGE);
+}
+
+
+void TestHighMemory::testSlotsExhaustion(void)
+{
+    uint32_t i;
+    void *address;
+
+    for (i = 0; i < KMAP_SLOTS; i++) {
+        address = mHigh->map(TEST_HIGH_FRAME + i * PAGE);
+        TS_ASSERT_EQUALS(address, (void*) (uintptr_t) (KMAP_START + i * PAGE));
+    }
+    TS_ASSERT_EQUALS(mHigh->usedSlots(), (uint32_t)KMAP_SLOTS);
+    TS_ASSERT_EQUALS(mHigh->map(TEST_HIGH_FRAME), (void*) NULL);
+
+    /* A slot in the middle of the window */
+    mHigh->unmap((void*) (uintptr_t) (KMAP_START + 100 * PAGE));
+    TS_ASSERT_EQUALS(mHigh->map(TEST_HIGH_FRAME), (void*) (uintptr_t) (KMAP_START + 100 * PAGE));
+    TS_ASSERT_EQUALS(mHigh->map(TEST_HIGH_FRAME), (void*) NULL);
+}
@@ -0,0 +1,33 @@
+#ifndef _TEST_HIGH_MEMORY_H_
+#define _TEST_HIGH_MEMORY_H_
+
+#include "CxxTest/TestSuite.h"
+#include "Memory/HighMemory.h"
+
+/* 64 kB of physical memory: the directories and the page table of the window */
+#define TEST_HIGH_FRAMES    16
+
+/* A frame out of the window, above 4 GB with PAE */
+#ifdef PAGING_PAE
+#define TEST_HIGH_FRAME     0x123456000ull
+#else
+#define TEST_HIGH_FRAME     0x40000000ull
+#endif
+
+class TestHighMemory: public CxxTest::TestSuite {
+    private:
+        struct page_frame mFrames[TEST_HIGH_FRAMES];
+        PageFrameAllocator *mAllocator;
+        AddressSpace *mSpace;
+        HighMemory *mHigh;
+
+    public:
+        void setUp(void);
+        void tearDown(void);
+
+        void testNormalFrame(void);
+        void testHighFrame(void);
+        void testSlotsExhaustion(void);
+};
+
+#endif /* _TEST_HIGH_MEMORY_H_ */
@@ -0,0 +1,166 @@
+#include "TestKernelHeap.h"
+#include "Memory/kmalloc.h"
+#include <string.h>
+#include <stdint.h>
+#include "Memory/BootstrapAllocator.h"
+
+/* Bootstrap heap of the kmalloc() singleton */
+static char bootstrapRegion[KHEAP_TEST_HEAP] __attribute__((aligned(KHEAP_TEST_HEAP)));
+
+void TestKernelHeap::setUp(void)
+{
+    mAllocator = new BuddyAllocator(mTZL, KHEAP_TEST_POWER, mBlockMap, mMemHeap, KHEAP_TEST_HEAP);
+    mHeap = new KernelHeap(mAllocator);
+}
+
+
+void TestKernelHeap::tearDown(void)
+{
+    delete mHeap;
+    delete mAllocator;
+}
+
+
+void TestKernelHeap::checkHeapReleased(void)
+{
+    void *chunk;
+
+    mHeap->reap();
+    chunk = mAllocator->alloc(KHEAP_TEST_HEAP);
+    TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+    mAllocator->free(chunk);
+}
+
+
+void TestKernelHeap::testSizeClasses(void)
+{
+    void *chunk;
+    size_t size;
+
+    for (size = 1; size <= KHEAP_MAX_SMALL; size++) {
+        chunk = mHeap->alloc(size);
+        TSM_ASSERT_DIFFERS(size, chunk, (void*)NULL);
+        TS_ASSERT_EQUALS((uintptr_t)chunk % sizeof(void*), 0u);
+
+        /* Served by the smallest fitting class, never wastes more than half */
+        TS_ASSERT_LESS_THAN_EQUALS(size, mHeap->chunkSize(chunk));
+        TS_ASSERT_LESS_THAN(mHeap->chunkSize(chunk), 2 * size + KHEAP_GRANULE);
+        memset(chunk, 0xA5, size);
+
+        /* Small chunks live in slabs, not at the beginning of a block */
+        TS_ASSERT_EQUALS(mAllocator->chunkSize(chunk), 0u);
+        mHeap->free(chunk);
+    }
+    chunk = mHeap->alloc(40);
+    TS_ASSERT_EQUALS(mHeap->chunkSize(chunk), 48u);
+    mHeap->free(chunk);
+
+    checkHeapReleased();
+}
+
+
+void TestKernelHeap::testLargeChunks(void)
+{
+    void *chunk;
+
+    chunk = mHeap->alloc(KHEAP_MAX_SMALL + 1);
+    TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+    TS_ASSERT_EQUALS(mHeap->chunkSize(chunk), 2u * KHEAP_MAX_SMALL);
+    TS_ASSERT_EQUALS(mAllocator->chunkSize(chunk), 2u * KHEAP_MAX_SMALL);
+    mHeap->free(chunk);
+
+    chunk = mHeap->alloc(KHEAP_TEST_HEAP);
+    TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+    mHeap->free(chunk);
+
+    checkHeapReleased();
+}
+
+
+void TestKernelHeap::testMixedSizes(void)
+{
+    void *chunks[64];
+    size_t sizes[64];
+    uint32_t seed = 42;
+
+    for (int i = 0; i < 64; i++) {
+        seed = seed * 1103515245u + 12345u;
+        sizes[i] = 1 + (seed >> 8) % (2 * KHEAP_MAX_SMALL);
+        chunks[i] = mHeap->alloc(sizes[i]);
+        TS_ASSERT_DIFFERS(chunks[i], (void*)NULL);
+        memset(chunks[i], i & 0xFF, sizes[i]);
+    }
+
+    /* No chunk overlaps another one */
+    for (int i = 0; i < 64; i++) {
+        TS_ASSERT_EQUALS(((uint8_t*) chunks[i])[0], (uint8_t)(i & 0xFF));
+        TS_ASSERT_EQUALS(((uint8_t*) chunks[i])[sizes[i] - 1], (uint8_t)(i & 0xFF));
+    }
+
+    for (int i = 63; i >= 0; i -= 2) {
+        mHeap->free(chunks[i]);
+    }
+    for (int i = 0; i < 64; i += 2) {
+        mHeap->free(chunks[i]);
+    }
+
+    checkHeapReleased();
+}
+
+
+void TestKernelHeap::testBadRequests(void)
+{
+    TS_ASSERT_EQUALS(mHeap->alloc(0), (void*)NULL);
+    TS_ASSERT_EQUALS(mHeap->alloc(2 * KHEAP_TEST_HEAP), (void*)NULL);
+    mHeap->free(NULL);
+}
+
+
+void TestKernelHeap::testKmalloc(void)
+{
+    void *small, *large;
+
+    BootstrapAllocator::setup(bootstrapRegion, KHEAP_TEST_HEAP);
+    small = kmalloc(24);
+    large = kmalloc(4 * KHEAP_MAX_SMALL);
+    TS_ASSERT_DIFFERS(small, (void*)NULL);
+    TS_ASSERT_DIFFERS(large, (void*)NULL);
+    TS_ASSERT_EQUALS(KernelHeap::getInstance()->chunkSize(small), 32u);
+    kfree(small);
+    kfree(large);
+    kfree(NULL);
+
+    KernelHeap::getInstance()->reap();
+}
+
+static size_t handedBytes;
+
+static void countHandedOver(void *start, size_t length)
+{
+    (void)start;
+    handedBytes += length;
+}
+
+void TestKernelHeap::testKmallocAfterHandOver(void)
+{
+    void *small, *large;
+    size_t handed;
+
+    /* A quarter of the heap stays with kmalloc() */
+    BootstrapAllocator::setup(bootstrapRegion, KHEAP_TEST_HEAP);
+    handedBytes = 0;
+    handed = BootstrapAllocator::getInstance()->handOver(countHandedOver, KHEAP_TEST_HEAP / 4);
+    TS_ASSERT_EQUALS(handed, handedBytes);
+    TS_ASSERT_LESS_THAN((size_t) KHEAP_TEST_HEAP / 2, handed);
+
+    /* Large chunks and the slabs of a size class not used so far */
+    large = kmalloc(4096);
+    small = kmalloc(700);
+    TS_ASSERT_DIFFERS(large, (void*)NULL);
+    TS_ASSERT_DIFFERS(small, (void*)NULL);
+    TS_ASSERT_EQUALS(KernelHeap::getInstance()->chunkSize(small), 768u);
+    kfree(small);
+    kfree(large);
+
+    KernelHeap::getInstance()->reap();
+}
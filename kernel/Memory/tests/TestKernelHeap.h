@@ -0,0 +1,33 @@
+#ifndef _TEST_KERNEL_HEAP_H_
+#define _TEST_KERNEL_HEAP_H_
+
+#include "CxxTest/TestSuite.h"
+#include "Memory/KernelHeap.h"
+
+#define KHEAP_TEST_POWER    18
+#define KHEAP_TEST_HEAP     (1 << KHEAP_TEST_POWER)
+
+class TestKernelHeap: public CxxTest::TestSuite {
+    private:
+        struct freeblock mTZL[KHEAP_TEST_POWER];
+        uint8_t mBlockMap[BUDDY_MAP_SIZE(KHEAP_TEST_POWER)];
+        char mMemHeap[KHEAP_TEST_HEAP];
+        BuddyAllocator *mAllocator;
+        KernelHeap *mHeap;
+
+        /** Check the whole heap is back to the allocator */
+        void checkHeapReleased(void);
+
+    public:
+        void setUp(void);
+        void tearDown(void);
+
+        void testSizeClasses(void);
+        void testLargeChunks(void);
+        void testMixedSizes(void);
+        void testBadRequests(void);
+        void testKmalloc(void);
+        void testKmallocAfterHandOver(void);
+};
+
+#endif /* _TEST_KERNEL_HEAP_H_ */
@@ -0,0 +1,337 @@
+#include "TestPageFrameAllocator.h"
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <signal.h>
+
+#define MB      (1024 * 1024)
+
+/* A failed assertion aborts: tests expecting one jump back from SIGABRT */
+static sigjmp_buf abortCatch;
+
+static void catchAbort(int)
+{
+    siglongjmp(abortCatch, 1);
+}
+
+void TestPageFrameAllocator::setUp(void)
+{
+    mAllocator = new PageFrameAllocator(mFrames, TEST_FRAMES);
+}
+
+
+void TestPageFrameAllocator::tearDown(void)
+{
+    delete mAllocator;
+    mAllocator = NULL;
+}
+
+
+void TestPageFrameAllocator::testEmptyAllocator(void)
+{
+    TS_ASSERT_EQUALS(mAllocator->frameCount(), (uint32_t)TEST_FRAMES);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)0);
+    TS_ASSERT_EQUALS(mAllocator->allocPages(0), (uint64_t)0);
+}
+
+
+void TestPageFrameAllocator::testAddRange(void)
+{
+    /* Partial frames are ignored */
+    mAllocator->addRange(0x1800, 0x2000);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)1);
+
+    /* Frame 0 is never given */
+    mAllocator->addRange(0, PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)1);
+
+    /* Memory past the table is ignored */
+    mAllocator->addRange(16 * MB, 64 * MB);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)(1 + TEST_FRAMES / 2));
+}
+
+
+void TestPageFrameAllocator::testAllocateAllFrames(void)
+{
+    const int count = TEST_FRAMES - 1;
+    uint64_t address;
+
+    mAllocator->addRange(0, (uint64_t) TEST_FRAMES * PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)count);
+
+    /* Every frame but the first is handed out once */
+    memset(mAddresses, 0, sizeof(mAddresses));
+    for (int i = 0; i < count; i++) {
+        address = mAllocator->allocPages(0);
+        TS_ASSERT_DIFFERS(address, (uint64_t)0);
+        TS_ASSERT_EQUALS(address % PAGE_FRAME_SIZE, (uint64_t)0);
+        TS_ASSERT(address < (uint64_t) TEST_FRAMES * PAGE_FRAME_SIZE);
+        TS_ASSERT_EQUALS(mAddresses[address / PAGE_FRAME_SIZE], (uint64_t)0);
+        mAddresses[address / PAGE_FRAME_SIZE] = address;
+    }
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)0);
+    TS_ASSERT_EQUALS(mAllocator->allocPages(0), (uint64_t)0);
+
+    /* Free them, everything merges back */
+    for (int i = 1; i < TEST_FRAMES; i++) {
+        mAllocator->freePages(mAddresses[i]);
+    }
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)count);
+
+    /* The first 4 MB block lacks frame 0 */
+    for (int i = 0; i < TEST_FRAMES / (1 << PAGE_MAX_ORDER) - 1; i++) {
+        mAddresses[i] = mAllocator->allocPages(PAGE_MAX_ORDER);
+        TS_ASSERT_DIFFERS(mAddresses[i], (uint64_t)0);
+        TS_ASSERT_EQUALS(mAddresses[i] % (PAGE_FRAME_SIZE << PAGE_MAX_ORDER), (uint64_t)0);
+    }
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), (uint64_t)0);
+    TS_ASSERT_DIFFERS(mAllocator->allocPages(PAGE_MAX_ORDER - 1), (uint64_t)0);
+}
+
+
+void TestPageFrameAllocator::testSplitAndMerge(void)
+{
+    uint64_t big, a, b;
+
+    mAllocator->addRange(8 * MB, 4 * MB);
+    big = mAllocator->allocPages(PAGE_MAX_ORDER);
+    TS_ASSERT_EQUALS(big, (uint64_t)(8 * MB));
+    mAllocator->freePages(big, PAGE_MAX_ORDER);
+
+    /* Two single frames are buddies */
+    a = mAllocator->allocPages(0);
+    b = mAllocator->allocPages(0);
+    TS_ASSERT_EQUALS(a ^ b, (uint64_t)PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), (uint64_t)0);
+
+    /* Freeing them gives the whole block back */
+    mAllocator->freePages(a);
+    mAllocator->freePages(b, 0);
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), big);
+}
+
+
+void TestPageFrameAllocator::testRangesWithHoles(void)
+{
+    uint64_t address;
+    int count;
+
+    /* Two ranges around a hole */
+    mAllocator->addRange(1 * MB, 3 * MB);
+    mAllocator->addRange(5 * MB + 0x800, 3 * MB - 0x800);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)(6 * MB / PAGE_FRAME_SIZE - 1));
+
+    /* No 4 MB block, and no frame from the hole */
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), (uint64_t)0);
+    count = 0;
+    while ((address = mAllocator->allocPages(0)) != 0) {
+        TS_ASSERT((address >= 1 * MB && address < 4 * MB)
+                  || (address >= 5 * MB + PAGE_FRAME_SIZE && address < 8 * MB));
+        mAddresses[count++] = address;
+    }
+    TS_ASSERT_EQUALS((uint32_t)count, (uint32_t)(6 * MB / PAGE_FRAME_SIZE - 1));
+    for (int i = 0; i < count; i++) {
+        mAllocator->freePages(mAddresses[i]);
+    }
+
+    /* Filling the hole merges ranges in 4 MB blocks */
+    mAllocator->addRange(0, 1 * MB);
+    mAllocator->addRange(4 * MB, 1 * MB + PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), (uint64_t)(4 * MB));
+}
+
+
+void TestPageFrameAllocator::testZones(void)
+{
+    uint64_t address;
+    int i;
+
+    /* Half the frames are below 16 MB, frame 0 is never given */
+    mAllocator->addRange(0, (uint64_t) TEST_FRAMES * PAGE_FRAME_SIZE);
+    TS_ASSERT_EQUALS(mAllocator->presentFrames(PAGE_ZONE_DMA), (uint32_t)(16 * MB / PAGE_FRAME_SIZE - 1));
+    TS_ASSERT_EQUALS(mAllocator->presentFrames(PAGE_ZONE_NORMAL), (uint32_t)(16 * MB / PAGE_FRAME_SIZE));
+    TS_ASSERT_EQUALS(mAllocator->presentFrames(PAGE_ZONE_HIGH), (uint32_t)0);
+
+    /* Requests take frames from the zone they ask for */
+    address = mAllocator->allocPages(0);
+    TS_ASSERT(address >= 16 * MB);
+    mAllocator->freePages(address);
+    address = mAllocator->allocPages(0, PAGE_ZONE_DMA);
+    TS_ASSERT(address != 0 && address < 16 * MB);
+    mAllocator->freePages(address);
+    address = mAllocator->allocPages(0, PAGE_ZONE_HIGH);
+    TS_ASSERT(address >= 16 * MB);
+    mAllocator->freePages(address);
+
+    /* Then fall back to the lower zones */
+    for (i = 0; i < 4; i++) {
+        mAddresses[i] = mAllocator->allocPages(PAGE_MAX_ORDER);
+        TS_ASSERT(mAddresses[i] >= 16 * MB);
+    }
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(PAGE_ZONE_NORMAL), (uint32_t)0);
+    address = mAllocator->allocPages(PAGE_MAX_ORDER);
+    TS_ASSERT(address != 0 && address < 16 * MB);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(PAGE_ZONE_DMA), (uint32_t)(12 * MB / PAGE_FRAME_SIZE - 1));
+
+    mAllocator->freePages(address);
+    for (i = 0; i < 4; i++) {
+        mAllocator->freePages(mAddresses[i]);
+    }
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)(TEST_FRAMES - 1));
+}
+
+
+void TestPageFrameAllocator::testZoneWatermarks(void)
+{
+    const uint32_t block = 1 << PAGE_MAX_ORDER;
+    uint64_t address[4];
+
+    mAllocator->addRange(0, (uint64_t) TEST_FRAMES * PAGE_FRAME_SIZE);
+
+    /* Under its low watermark, a zone is used after the lower ones */
+    mAllocator->setWatermarks(PAGE_ZONE_NORMAL, 0, 3 * block, 0);
+    address[0] = mAllocator->allocPages(PAGE_MAX_ORDER);
+    TS_ASSERT(address[0] >= 16 * MB);
+    address[1] = mAllocator->allocPages(PAGE_MAX_ORDER);
+    TS_ASSERT(address[1] < 16 * MB);
+
+    /* Down to its min watermark when all zones are under the low one */
+    mAllocator->setWatermarks(PAGE_ZONE_DMA, 0, 4 * block, 0);
+    address[2] = mAllocator->allocPages(PAGE_MAX_ORDER);
+    TS_ASSERT(address[2] >= 16 * MB);
+    mAllocator->setWatermarks(PAGE_ZONE_NORMAL, 2 * block, 3 * block, 0);
+    address[3] = mAllocator->allocPages(PAGE_MAX_ORDER);
+    TS_ASSERT(address[3] < 16 * MB);
+
+    /* The reserve only holds against higher zones */
+    mAllocator->setWatermarks(PAGE_ZONE_DMA, 0, 0, 2 * block);
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), (uint64_t)0);
+    TS_ASSERT_DIFFERS(mAllocator->allocPages(PAGE_MAX_ORDER, PAGE_ZONE_DMA), (uint64_t)0);
+
+    /* Default watermarks follow the zone sizes */
+    mAllocator->setDefaultWatermarks();
+    TS_ASSERT(mAllocator->allocPages(PAGE_MAX_ORDER) >= 16 * MB);
+    TS_ASSERT(mAllocator->allocPages(0) >= 16 * MB);
+}
+
+
+void TestPageFrameAllocator::testLifetimeGrouping(void)
+{
+    const uint32_t block = 1 << PAGE_MAX_ORDER;
+    uint64_t pinned, movable, reclaimable;
+    int i;
+
+    /* 16 MB of normal zone, four pageblocks, all movable */
+    mAllocator->addRange(16 * MB, 16 * MB);
+    TS_ASSERT_EQUALS(mAllocator->pageBlockLifetime(16 * MB), PAGE_LIFETIME_MOVABLE);
+
+    /* Interleaved requests of each lifetime take distinct pageblocks */
+    for (i = 0; i < 64; i++) {
+        mAddresses[3 * i] = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_PINNED);
+        mAddresses[3 * i + 1] = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_MOVABLE);
+        mAddresses[3 * i + 2] = mAllocator->allocPages(1, PAGE_ZONE_NORMAL, PAGE_LIFETIME_RECLAIMABLE);
+    }
+    pinned = mAddresses[0] & ~(uint64_t) (4 * MB - 1);
+    movable = mAddresses[1] & ~(uint64_t) (4 * MB - 1);
+    reclaimable = mAddresses[2] & ~(uint64_t) (4 * MB - 1);
+    TS_ASSERT(pinned != movable && pinned != reclaimable && movable != reclaimable);
+    TS_ASSERT_EQUALS(mAllocator->pageBlockLifetime(pinned), PAGE_LIFETIME_PINNED);
+    TS_ASSERT_EQUALS(mAllocator->pageBlockLifetime(reclaimable), PAGE_LIFETIME_RECLAIMABLE);
+    for (i = 0; i < 3 * 64; i++) {
+        TS_ASSERT_EQUALS(mAddresses[i] & ~(uint64_t) (4 * MB - 1),
+                         (i % 3 == 0) ? pinned : (i % 3 == 1) ? movable : reclaimable);
+    }
+
+    /* Freeing the short lived frames gives their pageblocks back whole */
+    for (i = 0; i < 64; i++) {
+        mAllocator->freePages(mAddresses[3 * i + 1]);
+        mAllocator->freePages(mAddresses[3 * i + 2], 1);
+    }
+    TS_ASSERT_EQUALS(mAllocator->freeBlocks(PAGE_MAX_ORDER), (uint32_t)3);
+
+    /* A full pageblock makes its lifetime take another one */
+    for (i = 64; i < (int) block; i++) {
+        mAddresses[i] = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_PINNED);
+        TS_ASSERT_EQUALS(mAddresses[i] & ~(uint64_t) (4 * MB - 1), pinned);
+    }
+    mAddresses[block] = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_PINNED);
+    TS_ASSERT_DIFFERS(mAddresses[block] & ~(uint64_t) (4 * MB - 1), pinned);
+    TS_ASSERT_EQUALS(mAllocator->pageBlockLifetime(mAddresses[block]), PAGE_LIFETIME_PINNED);
+    TS_ASSERT_EQUALS(mAllocator->freeBlocks(PAGE_MAX_ORDER), (uint32_t)2);
+}
+
+
+void TestPageFrameAllocator::testMovableClaims(void)
+{
+    const uint32_t block = 1 << PAGE_MAX_ORDER;
+    uint64_t first, second, address;
+    uint32_t i;
+
+    /* Two pageblocks, both taken by pinned frames */
+    mAllocator->addRange(16 * MB, 8 * MB);
+    for (i = 0; i < 2 * block; i++) {
+        mAddresses[i] = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_PINNED);
+    }
+    first = mAddresses[0] & ~(uint64_t) (4 * MB - 1);
+    second = mAddresses[block] & ~(uint64_t) (4 * MB - 1);
+    TS_ASSERT_DIFFERS(first, second);
+
+    /* A movable request takes frames of a pageblock mostly allocated, not the pageblock */
+    for (i = 0; i < block / 16; i++) {
+        mAllocator->freePages(mAddresses[i]);
+    }
+    address = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_MOVABLE);
+    TS_ASSERT_EQUALS(address & ~(uint64_t) (4 * MB - 1), first);
+    TS_ASSERT_EQUALS(mAllocator->pageBlockLifetime(first), PAGE_LIFETIME_PINNED);
+
+    /* It takes a pageblock half free */
+    for (i = block; i < block + block / 2; i++) {
+        mAllocator->freePages(mAddresses[i]);
+    }
+    address = mAllocator->allocPages(0, PAGE_ZONE_NORMAL, PAGE_LIFETIME_MOVABLE);
+    TS_ASSERT_EQUALS(address & ~(uint64_t) (4 * MB - 1), second);
+    TS_ASSERT_EQUALS(mAllocator->pageBlockLifetime(second), PAGE_LIFETIME_MOVABLE);
+}
+
+void TestPageFrameAllocator::testBadRequests(void)
+{
+    mAllocator->addRange(0, (uint64_t) TEST_FRAMES * PAGE_FRAME_SIZE);
+
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER + 1), (uint64_t)0);
+    mAllocator->freePages(0);
+    mAllocator->freePages(0, 3);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)(TEST_FRAMES - 1));
+}
+
+
+void TestPageFrameAllocator::testFreeRightBuddyTwice(void)
+{
+    void (*previous)(int);
+    uint64_t left, right;
+
+    mAllocator->addRange(8 * MB, 4 * MB);
+    left = mAllocator->allocPages(0);
+    right = mAllocator->allocPages(0);
+    TS_ASSERT_EQUALS(left ^ right, (uint64_t) PAGE_FRAME_SIZE);
+    if (right < left) {
+        right = left;
+        left = right ^ PAGE_FRAME_SIZE;
+    }
+
+    /* The right buddy merges into the left one and no longer heads a block */
+    mAllocator->freePages(left);
+    mAllocator->freePages(right);
+    TS_ASSERT_EQUALS((uint32_t) mFrames[right / PAGE_FRAME_SIZE].flags, (uint32_t)0);
+    TS_ASSERT_EQUALS((uint32_t) mFrames[right / PAGE_FRAME_SIZE].order, (uint32_t)0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)(4 * MB / PAGE_FRAME_SIZE));
+
+    /* Freeing it again is caught before it reaches the free areas */
+    previous = signal(SIGABRT, catchAbort);
+    if (sigsetjmp(abortCatch, 1) == 0) {
+        mAllocator->freePages(right);
+        TS_FAIL("double free of a right buddy not caught");
+    }
+    signal(SIGABRT, previous);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), (uint32_t)(4 * MB / PAGE_FRAME_SIZE));
+    TS_ASSERT_EQUALS(mAllocator->allocPages(PAGE_MAX_ORDER), (uint64_t)(8 * MB));
+}
@@ -0,0 +1,33 @@
+#ifndef _TEST_PAGE_FRAME_ALLOCATOR_H_
+#define _TEST_PAGE_FRAME_ALLOCATOR_H_
+
+#include "CxxTest/TestSuite.h"
+#include "Memory/PageFrameAllocator.h"
+
+/* 32 MB of physical memory */
+#define TEST_FRAMES     8192
+
+class TestPageFrameAllocator: public CxxTest::TestSuite {
+    private:
+        struct page_frame mFrames[TEST_FRAMES];
+        uint64_t mAddresses[TEST_FRAMES];
+        PageFrameAllocator *mAllocator;
+
+    public:
+        void setUp(void);
+        void tearDown(void);
+
+        void testEmptyAllocator(void);
+        void testAddRange(void);
+        void testAllocateAllFrames(void);
+        void testSplitAndMerge(void);
+        void testRangesWithHoles(void);
+        void testZones(void);
+        void testZoneWatermarks(void);
+        void testLifetimeGrouping(void);
+        void testMovableClaims(void);
+        void testBadRequests(void);
+        void testFreeRightBuddyTwice(void);
+};
+
+#endif /* _TEST_PAGE_FRAME_ALLOCATOR_H_ */
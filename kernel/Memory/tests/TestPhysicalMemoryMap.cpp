@@ -16,171 +16,243 @@ void TestPhysicalMemoryMap::tearDown(void)
 }
 
 
-void TestPhysicalMemoryMap::testGetFreeChunk(void)
-{
-    struct memory_chunk *first;
-    struct memory_chunk *second;
-
-    first = mLocalMap->getFreeChunk();
-    TS_ASSERT_DIFFERS(first, (struct memory_chunk*)NULL);
-
-    first->address = 0xDEADBEEF;
-    first->length = 0x1000;
-    first->status = FREE_MEMORY;
-
-    second = mLocalMap->getFreeChunk();
-    TS_ASSERT_DIFFERS(second, (struct memory_chunk*)NULL);
-    TS_ASSERT_DIFFERS(first, second);
-    TS_ASSERT_DIFFERS(second->address, 0xDEADBEEFu);
-    TS_ASSERT_DIFFERS(second->length, 0x1000u);
-    TS_ASSERT_EQUALS(second->status, UNKNOWN_MEMORY);
-
-    /* As the object is hightly verified, we need
-     * to send back theses objects to avoir a failure */
-    mLocalMap->addChunk(first);
-    mLocalMap->addChunk(second);
-}
-
-
 void TestPhysicalMemoryMap::feedMemoryMap(int count, uint64_t base_address, uint64_t base_size)
 {
-   struct memory_chunk *descriptor;
-
-   for (int i = 0; i < count; i++) {
-      descriptor = mLocalMap->getFreeChunk();
-      TS_ASSERT_DIFFERS(descriptor, (struct memory_chunk*)NULL);
-      descriptor->address = base_address + 0x1000 * i;
-      descriptor->length = base_size + 0x1000 * i;
-      descriptor->status = FREE_MEMORY;
-      mLocalMap->addChunk(descriptor);
+   struct memory_chunk descriptor;
+
+   for (int i = count - 1; i >= 0; i--) {
+      descriptor.address = base_address + 0x2000 * i;
+      descriptor.length = base_size + i;
+      descriptor.status = FREE_MEMORY;
+      mLocalMap->addChunk(&descriptor);
    }
 }
 
 
-void TestPhysicalMemoryMap::testClear(void)
+void TestPhysicalMemoryMap::testAddChunk(void)
 {
-   bool b;
-   struct memory_chunk *mc;
-   
-   feedMemoryMap(10, 0xDEADBEEFu, 0);
-   mLocalMap->clear();
-
-   mc = mLocalMap->current();
-   TS_ASSERT_EQUALS(mc, (struct memory_chunk*)NULL);
-   b = mLocalMap->next();
-   TS_ASSERT_EQUALS(b, false);
-   mc = mLocalMap->current();
-   TS_ASSERT_EQUALS(mc, (struct memory_chunk*)NULL);
+    struct memory_chunk chunk;
+
+    TS_ASSERT_EQUALS(mLocalMap->count(), 0);
+    TS_ASSERT_EQUALS(mLocalMap->begin(), mLocalMap->end());
+
+    chunk.address = 0xDEADB000u;
+    chunk.length = 0x1000;
+    chunk.status = FREE_MEMORY;
+    mLocalMap->addChunk(&chunk);
+
+    /* The map keeps its own copy */
+    chunk.address = 0x1000;
+    chunk.status = RESERVED_MEMORY;
+    mLocalMap->addChunk(&chunk);
+    TS_ASSERT_EQUALS(mLocalMap->count(), 2);
+
+    mCursor = mLocalMap->begin();
+    checkChunk(0x1000, 0x1000, RESERVED_MEMORY);
+    checkChunk(0xDEADB000u, 0x1000, FREE_MEMORY);
+    TS_ASSERT_EQUALS(mCursor, mLocalMap->end());
 }
 
 
-void TestPhysicalMemoryMap::testCurrent(void)
+void TestPhysicalMemoryMap::testClear(void)
 {
-    struct memory_chunk *mc;
-
-    mc = mLocalMap->current();
-    TS_ASSERT_EQUALS(mc, (struct memory_chunk*)NULL);
-
-    /* Create a chunk descriptor */
-    mc = mLocalMap->getFreeChunk();
-    TS_ASSERT_DIFFERS(mc, (struct memory_chunk*)NULL);
-
-    mc->address = 0xBAADB00Du;
-    mc->length = 0x1000;
-    mc->status = FREE_MEMORY;
-    mLocalMap->addChunk(mc);
-    mc = (struct memory_chunk*)NULL;
-
-    /* Get and check the created */
-    mc = mLocalMap->current();
-    TS_ASSERT_DIFFERS(mc, (struct memory_chunk*)NULL);
-    TS_ASSERT_EQUALS(mc->address, 0xBAADB00Du);
-    TS_ASSERT_EQUALS(mc->length, 0x1000u);
-    TS_ASSERT_EQUALS(mc->status, FREE_MEMORY);
-
-    /* Go to the next descriptor, it must be NULL */
-    TS_ASSERT(!mLocalMap->next());
-    mc = mLocalMap->current();
-    TS_ASSERT_EQUALS(mc, (struct memory_chunk*)NULL);
-
-    /* Rewind and check it's the right one */
-    mLocalMap->rewind();
-    mc = mLocalMap->current();
-    TS_ASSERT_DIFFERS(mc, (struct memory_chunk*)NULL);
-    TS_ASSERT_EQUALS(mc->address, 0xBAADB00Du);
-    TS_ASSERT_EQUALS(mc->length, 0x1000u);
-    TS_ASSERT_EQUALS(mc->status, FREE_MEMORY);
-
-    /* Empty the list, now it's NULL */
-    mLocalMap->clear();
-    mc = mLocalMap->current();
-    TS_ASSERT_EQUALS(mc, (struct memory_chunk*)NULL);
+   feedMemoryMap(10, 0xDEADB000u, 1);
+   TS_ASSERT_EQUALS(mLocalMap->count(), 10);
+
+   mLocalMap->clear();
+   TS_ASSERT_EQUALS(mLocalMap->count(), 0);
+   TS_ASSERT_EQUALS(mLocalMap->begin(), mLocalMap->end());
+   TS_ASSERT_EQUALS(mLocalMap->lookup(0xDEADB000u), (const struct memory_chunk*)NULL);
 }
 
 
-void TestPhysicalMemoryMap::testNext(void)
+void TestPhysicalMemoryMap::testIteration(void)
 {
     /* Test parameters */
     const int descriptorCount = 10;
     const uint64_t descriptorBase = 0x0u;
-    const uint64_t descriptorSize = 0x0u;
+    const uint64_t descriptorSize = 0x10u;
     /* Test checkers */
-    int checkCount = 0;
-    struct memory_chunk *mc;
+    PhysicalMemoryMap::iterator chunk;
+    int checkCount;
 
-    /* Feed the map with chunk descriptors */
+    /* Chunks come in address order, however they were added */
     feedMemoryMap(descriptorCount, descriptorBase, descriptorSize);
 
-    while (mLocalMap->next()) {
-        mc = mLocalMap->current();
-        TS_ASSERT_DIFFERS(mc, (struct memory_chunk*)NULL);
-        TS_ASSERT_LESS_THAN_EQUALS(mc->address, descriptorBase + descriptorCount * 0x1000u);
-        TS_ASSERT_LESS_THAN_EQUALS(mc->length, descriptorSize + descriptorCount * 0x1000u);
-        checkCount++;
+    /* Walking the map does not change it: walk it twice */
+    for (int pass = 0; pass < 2; pass++) {
+        checkCount = 0;
+        for (chunk = mLocalMap->begin(); chunk != mLocalMap->end(); chunk++) {
+            TS_ASSERT_EQUALS(chunk->address, descriptorBase + checkCount * 0x2000u);
+            TS_ASSERT_EQUALS(chunk->length, descriptorSize + checkCount);
+            checkCount++;
+        }
+        TS_ASSERT_EQUALS(checkCount, descriptorCount);
     }
-    TS_ASSERT_EQUALS(checkCount + 1, descriptorCount);
-
-    /* Empty the map and check that next behaves as expected */
-    mLocalMap->clear();
-    TS_ASSERT(!mLocalMap->next());
 }
 
 
-void TestPhysicalMemoryMap::testRewind(void)
+void TestPhysicalMemoryMap::testLookup(void)
 {
-    /* Test parameters */
-    const int descriptorCount = 10;
-    const uint64_t descriptorBase = 0x0u;
-    const uint64_t descriptorSize = 0x0u;
-    /* Test checkers */
-    int checkCount = 0;
-    struct memory_chunk *mc = NULL;
+    feedMemoryMap(MEMORY_MAP_CAPACITY, 0x100000, 0x1000);
 
-    /* Feed the map with chunk descriptors */
-    feedMemoryMap(descriptorCount, descriptorBase, descriptorSize);
+    /* Beginning, inside and end of chunks */
+    for (int i = 0; i < MEMORY_MAP_CAPACITY; i++) {
+        uint64_t address = 0x100000 + 0x2000 * i;
+
+        TS_ASSERT_EQUALS(mLocalMap->lookup(address), mLocalMap->begin() + i);
+        TS_ASSERT_EQUALS(mLocalMap->lookup(address + 0x1000 + i - 1), mLocalMap->begin() + i);
+        TS_ASSERT_EQUALS(mLocalMap->lookup(address + 0x1000 + i), (const struct memory_chunk*)NULL);
+    }
+
+    /* Before and after the map */
+    TS_ASSERT_EQUALS(mLocalMap->lookup(0), (const struct memory_chunk*)NULL);
+    TS_ASSERT_EQUALS(mLocalMap->lookup(0xFFFFF), (const struct memory_chunk*)NULL);
+    TS_ASSERT_EQUALS(mLocalMap->lookup(0xFFFFFFFFFFFFFFFFull), (const struct memory_chunk*)NULL);
+}
+
+
+void TestPhysicalMemoryMap::testRangeStatus(void)
+{
+    const struct memory_chunk chunks[] = {
+        { 0x0,      0x9F000,  FREE_MEMORY },
+        { 0x9F000,  0x1000,   RESERVED_MEMORY },
+        { 0x100000, 0x100000, FREE_MEMORY },
+        { 0x200000, 0x100000, UNKNOWN_MEMORY },
+    };
+
+    mLocalMap->build(chunks, 4);
+
+    /* Inside one chunk */
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x1000, 0x1000), FREE_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x9F000, 0x1000), RESERVED_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x100000, 0x100000), FREE_MEMORY);
+
+    /* Across chunks, the most restrictive status */
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x9E000, 0x2000), RESERVED_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x1FF000, 0x2000), UNKNOWN_MEMORY);
+
+    /* Holes are unknown, but reserved memory is still reserved */
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0xA0000, 0x1000), UNKNOWN_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0xFF000, 0x2000), UNKNOWN_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x2FF000, 0x2000), UNKNOWN_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x9F000, 0x62000), RESERVED_MEMORY);
+}
 
-    /* Test rewind function multiple times */
-    for (int i = 0; i < 100; i++) {
-        checkCount = 0;
-        mc = (struct memory_chunk*) NULL;
-
-        /* Check list values*/
-        while (mLocalMap->next()) {
-            mc = mLocalMap->current();
-            TS_ASSERT_DIFFERS(mc, (struct memory_chunk*)NULL);
-            TS_ASSERT_LESS_THAN_EQUALS(mc->address, descriptorBase + descriptorCount * 0x1000u);
-            TS_ASSERT_LESS_THAN_EQUALS(mc->length, descriptorSize + descriptorCount * 0x1000u);
-            checkCount++;
-        }
-        TS_ASSERT_EQUALS(checkCount + 1, descriptorCount);
 
-        /* Rewind the head of the list */
-        mLocalMap->rewind();
-        TS_ASSERT_DIFFERS(mLocalMap->current(), (struct memory_chunk*)NULL);
+void TestPhysicalMemoryMap::checkChunk(uint64_t address, uint64_t length, enum chunk_status status)
+{
+    TS_ASSERT_DIFFERS(mCursor, mLocalMap->end());
+    if (mCursor != mLocalMap->end()) {
+        TS_ASSERT_EQUALS(mCursor->address, address);
+        TS_ASSERT_EQUALS(mCursor->length, length);
+        TS_ASSERT_EQUALS(mCursor->status, status);
+        mCursor++;
     }
+}
+
 
-    /* Check we don't lose anything */
-    mLocalMap->clear();
-    TS_ASSERT(!mLocalMap->next());
+void TestPhysicalMemoryMap::testBuildSorts(void)
+{
+    /* A typical PC, upside down */
+    const struct memory_chunk chunks[] = {
+        { 0x100000,  0x7EE0000, FREE_MEMORY },
+        { 0xFFFC0000, 0x40000,  RESERVED_MEMORY },
+        { 0xF0000,   0x10000,   RESERVED_MEMORY },
+        { 0x0,       0x9FC00,   FREE_MEMORY },
+        { 0x7FE0000, 0x20000,   RESERVED_MEMORY },
+        { 0x9FC00,   0x400,     RESERVED_MEMORY },
+    };
+
+    mLocalMap->build(chunks, 6);
+    mCursor = mLocalMap->begin();
+    checkChunk(0x0, 0x9FC00, FREE_MEMORY);
+    checkChunk(0x9FC00, 0x400, RESERVED_MEMORY);
+    checkChunk(0xF0000, 0x10000, RESERVED_MEMORY);
+    checkChunk(0x100000, 0x7EE0000, FREE_MEMORY);
+    checkChunk(0x7FE0000, 0x20000, RESERVED_MEMORY);
+    checkChunk(0xFFFC0000, 0x40000, RESERVED_MEMORY);
+    TS_ASSERT_EQUALS(mCursor, mLocalMap->end());
+
+    /* Building again replaces the content */
+    mLocalMap->build(chunks, 1);
+    mCursor = mLocalMap->begin();
+    checkChunk(0x100000, 0x7EE0000, FREE_MEMORY);
+    TS_ASSERT_EQUALS(mCursor, mLocalMap->end());
 }
 
+
+void TestPhysicalMemoryMap::testBuildResolvesOverlaps(void)
+{
+    const struct memory_chunk chunks[] = {
+        { 0x0,      0x100000, FREE_MEMORY },
+        { 0x80000,  0x10000,  RESERVED_MEMORY },
+        { 0x88000,  0x10000,  UNKNOWN_MEMORY },
+        { 0xC0000,  0x0,      RESERVED_MEMORY },
+        { 0x200000, 0x100000, UNKNOWN_MEMORY },
+        { 0x280000, 0x100000, FREE_MEMORY },
+    };
+
+    /* Reserved wins over unknown, unknown wins over free */
+    mLocalMap->build(chunks, 6);
+    mCursor = mLocalMap->begin();
+    checkChunk(0x0, 0x80000, FREE_MEMORY);
+    checkChunk(0x80000, 0x10000, RESERVED_MEMORY);
+    checkChunk(0x90000, 0x8000, UNKNOWN_MEMORY);
+    checkChunk(0x98000, 0x68000, FREE_MEMORY);
+    checkChunk(0x200000, 0x100000, UNKNOWN_MEMORY);
+    checkChunk(0x300000, 0x80000, FREE_MEMORY);
+    TS_ASSERT_EQUALS(mCursor, mLocalMap->end());
+}
+
+
+void TestPhysicalMemoryMap::testBuildMergesAdjacent(void)
+{
+    const struct memory_chunk chunks[] = {
+        { 0x3000, 0x1000, FREE_MEMORY },
+        { 0x0,    0x1000, FREE_MEMORY },
+        { 0x1000, 0x2000, FREE_MEMORY },
+        { 0x1800, 0x800,  FREE_MEMORY },
+        { 0x4000, 0x1000, RESERVED_MEMORY },
+        { 0x5000, 0x1000, RESERVED_MEMORY },
+        { 0x7000, 0x1000, RESERVED_MEMORY },
+    };
+
+    /* Holes are kept, touching chunks of the same status are merged */
+    mLocalMap->build(chunks, 7);
+    mCursor = mLocalMap->begin();
+    checkChunk(0x0, 0x4000, FREE_MEMORY);
+    checkChunk(0x4000, 0x2000, RESERVED_MEMORY);
+    checkChunk(0x7000, 0x1000, RESERVED_MEMORY);
+    TS_ASSERT_EQUALS(mCursor, mLocalMap->end());
+}
+
+
+void TestPhysicalMemoryMap::testCarve(void)
+{
+    struct memory_chunk chunks[3] = {
+        { 0x0,      0x9F000,    FREE_MEMORY },
+        { 0x9F000,  0x61000,    RESERVED_MEMORY },
+        { 0x100000, 0x3F00000,  FREE_MEMORY },
+    };
+
+    mLocalMap->build(chunks, 3);
+
+    /* Inside a free chunk, aligned, above a bound: cut in three */
+    TS_ASSERT_EQUALS(mLocalMap->carve(0x100000, 0x1000, 0x1000800, 0x4000000), (uint64_t)0x1001000);
+    TS_ASSERT_EQUALS(mLocalMap->count(), 5);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x1001000, 0x100000), RESERVED_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x100000, 0xF01000), FREE_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->rangeStatus(0x1101000, 0x2EFF000), FREE_MEMORY);
+
+    /* Never at address 0, cut in two */
+    TS_ASSERT_EQUALS(mLocalMap->carve(0x1000, 0x1000, 0, 0x100000), (uint64_t)0x1000);
+    TS_ASSERT_EQUALS(mLocalMap->count(), 7);
+    TS_ASSERT_EQUALS(mLocalMap->lookup(0)->status, FREE_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->lookup(0x1000)->status, RESERVED_MEMORY);
+    TS_ASSERT_EQUALS(mLocalMap->lookup(0x2000)->length, (uint64_t)0x9D000);
+
+    /* Nothing fits below the bound */
+    TS_ASSERT_EQUALS(mLocalMap->carve(0x200000, 0x1000, 0x1000000, 0x1200000), (uint64_t)0);
+    TS_ASSERT_EQUALS(mLocalMap->count(), 7);
+}
@@ -1,3 +1,4 @@
+
 #ifndef _TEST_PHYSICAL_MEMORY_MAP__H_
 #define _TEST_PHYSICAL_MEMORY_MAP__H_
 
@@ -7,10 +8,13 @@
 class TestPhysicalMemoryMap: public CxxTest::TestSuite {
     private:
         PhysicalMemoryMap *mLocalMap;
+        PhysicalMemoryMap::iterator mCursor;
+
         /**
-         * Fill the mLocalMap with <count> chunk descriptors. They'll have
-         * the provided address as base + count * 0x1000. The size will be
-         * computed on the same model. Chunk type will be set at FREE_MEMORY.
+         * Fill the mLocalMap with <count> chunk descriptors, in reverse
+         * order. The chunk i is at base_address + i * 0x2000 with a size of
+         * base_size + i, smaller than 0x2000. Chunk type will be set at
+         * FREE_MEMORY.
          *
          * @param count the number of chunks to provide
          * @param base_address the base address for the computation described
@@ -19,15 +23,24 @@ class TestPhysicalMemoryMap: public CxxTest::TestSuite {
          */
         void feedMemoryMap(int count, uint64_t base_adress, uint64_t base_size);
 
+        /**
+         * Check the chunk under the cursor, and move forward.
+         */
+        void checkChunk(uint64_t address, uint64_t length, enum chunk_status status);
+
     public:
         void setUp(void);
         void tearDown(void);
 
-        void testGetFreeChunk(void);
+        void testAddChunk(void);
         void testClear(void);
-        void testCurrent(void);
-        void testNext(void);
-        void testRewind(void);
+        void testIteration(void);
+        void testLookup(void);
+        void testRangeStatus(void);
+        void testBuildSorts(void);
+        void testBuildResolvesOverlaps(void);
+        void testBuildMergesAdjacent(void);
+        void testCarve(void);
 };
 
 #endif /* _TEST_PHYSICAL_MEMORY_MAP__H_ */
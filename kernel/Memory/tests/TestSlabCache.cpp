@@ -0,0 +1,199 @@
+#include "TestSlabCache.h"
+#include <string.h>
+#include <stdint.h>
+
+/** Object used through the tests: the size of a memory chunk descriptor */
+struct test_object {
+    uint64_t address;
+    uint64_t length;
+    uint32_t status;
+    uint32_t magic;
+};
+
+#define TEST_OBJECT_MAGIC   0x0B1EC7EDu
+
+static int constructorCalls;
+
+static void testObjectConstructor(void *object)
+{
+    ((struct test_object*) object)->magic = TEST_OBJECT_MAGIC;
+    constructorCalls++;
+}
+
+void TestSlabCache::setUp(void)
+{
+    mAllocator = new BuddyAllocator(mTZL, SLAB_TEST_POWER, mBlockMap, mMemHeap, SLAB_TEST_HEAP);
+    constructorCalls = 0;
+}
+
+
+void TestSlabCache::tearDown(void)
+{
+    delete mAllocator;
+}
+
+
+void TestSlabCache::checkHeapReleased(void)
+{
+    void *chunk;
+
+    chunk = mAllocator->alloc(SLAB_TEST_HEAP);
+    TS_ASSERT_DIFFERS(chunk, (void*)NULL);
+    mAllocator->free(chunk);
+}
+
+
+void TestSlabCache::testGeometry(void)
+{
+    SlabCache cache(mAllocator, "test", 28);
+    void *o;
+
+    /* No padding: the objects are aligned on 4 bytes, their natural alignment */
+    TS_ASSERT_EQUALS(cache.objectSize(), 28u);
+    TS_ASSERT_LESS_THAN_EQUALS((size_t)(1 << SLAB_MIN_POWER), cache.slabSize());
+    TS_ASSERT_LESS_THAN_EQUALS((uint32_t)SLAB_MIN_OBJECTS, cache.objectsPerSlab());
+    TS_ASSERT_LESS_THAN_EQUALS(cache.objectsPerSlab() * cache.objectSize(), cache.slabSize());
+    TS_ASSERT_EQUALS(cache.slabCount(), 0u);
+
+    /* With its descriptor and free indexes, an object takes less than a 32 bytes buddy block */
+    TS_ASSERT_LESS_THAN(cache.slabSize() / cache.objectsPerSlab(), 32u);
+
+    /* Objects of a multiple of the pointer size are aligned on pointers */
+    SlabCache aligned(mAllocator, "aligned", sizeof(struct test_object));
+    TS_ASSERT_EQUALS(aligned.objectSize(), sizeof(struct test_object));
+    o = aligned.alloc();
+    TS_ASSERT_EQUALS((uintptr_t) o % sizeof(void*), 0u);
+    aligned.free(o);
+
+    /* Big objects get bigger slabs */
+    SlabCache big(mAllocator, "big", 2000);
+    TS_ASSERT_LESS_THAN_EQUALS((uint32_t)SLAB_MIN_OBJECTS, big.objectsPerSlab());
+}
+
+
+void TestSlabCache::testAllocFree(void)
+{
+    SlabCache cache(mAllocator, "test", sizeof(struct test_object));
+    struct test_object *o1, *o2;
+
+    o1 = (struct test_object*) cache.alloc();
+    o2 = (struct test_object*) cache.alloc();
+    TS_ASSERT_DIFFERS(o1, (struct test_object*)NULL);
+    TS_ASSERT_DIFFERS(o2, (struct test_object*)NULL);
+    TS_ASSERT_DIFFERS(o1, o2);
+    TS_ASSERT_EQUALS((uintptr_t)o1 % sizeof(void*), 0u);
+    TS_ASSERT_EQUALS(cache.objectsInUse(), 2u);
+    TS_ASSERT_EQUALS(cache.slabCount(), 1u);
+
+    /* Objects don't overlap */
+    memset(o1, 0xAA, sizeof(*o1));
+    memset(o2, 0x55, sizeof(*o2));
+    TS_ASSERT_EQUALS(o1->magic, 0xAAAAAAAAu);
+
+    /* The last freed object is the next one given */
+    cache.free(o1);
+    TS_ASSERT_EQUALS(cache.alloc(), (void*)o1);
+
+    cache.free(o1);
+    cache.free(o2);
+    cache.free(NULL);
+    TS_ASSERT_EQUALS(cache.objectsInUse(), 0u);
+}
+
+
+void TestSlabCache::testSlabLists(void)
+{
+    SlabCache cache(mAllocator, "test", sizeof(struct test_object));
+    const uint32_t count = 3 * cache.objectsPerSlab();
+    static void *objects[SLAB_TEST_HEAP / sizeof(struct test_object)];
+
+    for (uint32_t i = 0; i < count; i++) {
+        objects[i] = cache.alloc();
+        TS_ASSERT_DIFFERS(objects[i], (void*)NULL);
+    }
+    TS_ASSERT_EQUALS(cache.slabCount(), 3u);
+
+    /* Free the first slab: it is kept as the empty slab */
+    for (uint32_t i = 0; i < cache.objectsPerSlab(); i++) {
+        cache.free(objects[i]);
+    }
+    TS_ASSERT_EQUALS(cache.slabCount(), 3u);
+
+    /* A partial slab is used before the empty one */
+    cache.free(objects[count - 1]);
+    TS_ASSERT_EQUALS(cache.alloc(), objects[count - 1]);
+
+    /* Extra empty slabs are given back */
+    for (uint32_t i = cache.objectsPerSlab(); i < count; i++) {
+        cache.free(objects[i]);
+    }
+    TS_ASSERT_EQUALS(cache.slabCount(), (uint32_t)SLAB_MAX_EMPTY);
+    TS_ASSERT_EQUALS(cache.objectsInUse(), 0u);
+
+    cache.reap();
+    TS_ASSERT_EQUALS(cache.slabCount(), 0u);
+    checkHeapReleased();
+}
+
+
+void TestSlabCache::testConstructor(void)
+{
+    SlabCache cache(mAllocator, "test", sizeof(struct test_object), testObjectConstructor);
+    struct test_object *o;
+
+    o = (struct test_object*) cache.alloc();
+    TS_ASSERT_DIFFERS(o, (struct test_object*)NULL);
+    TS_ASSERT_EQUALS(o->magic, TEST_OBJECT_MAGIC);
+    TS_ASSERT_EQUALS((uint32_t)constructorCalls, cache.objectsPerSlab());
+
+    /* Objects are not constructed again when reused */
+    o->length = 0x1000;
+    cache.free(o);
+    o = (struct test_object*) cache.alloc();
+    TS_ASSERT_EQUALS(o->magic, TEST_OBJECT_MAGIC);
+    TS_ASSERT_EQUALS(o->length, 0x1000u);
+    TS_ASSERT_EQUALS((uint32_t)constructorCalls, cache.objectsPerSlab());
+
+    cache.free(o);
+}
+
+
+void TestSlabCache::testReap(void)
+{
+    SlabCache *cache;
+    void *o;
+
+    cache = new SlabCache(mAllocator, "test", 100);
+    o = cache->alloc();
+    cache->free(o);
+    TS_ASSERT_EQUALS(cache->slabCount(), 1u);
+    cache->reap();
+    TS_ASSERT_EQUALS(cache->slabCount(), 0u);
+
+    /* Destruction gives everything back */
+    o = cache->alloc();
+    cache->free(o);
+    delete cache;
+    checkHeapReleased();
+}
+
+
+void TestSlabCache::testExhaustion(void)
+{
+    SlabCache cache(mAllocator, "test", sizeof(struct test_object));
+    static void *objects[SLAB_TEST_HEAP / sizeof(struct test_object)];
+    uint32_t count;
+
+    count = 0;
+    while ((objects[count] = cache.alloc()) != NULL) {
+        count++;
+    }
+    TS_ASSERT_EQUALS(count, cache.objectsPerSlab() * (SLAB_TEST_HEAP / cache.slabSize()));
+    TS_ASSERT_EQUALS(mAllocator->alloc(1), (void*)NULL);
+
+    while (count > 0) {
+        cache.free(objects[--count]);
+    }
+    cache.reap();
+    checkHeapReleased();
+}
@@ -0,0 +1,32 @@
+#ifndef _TEST_SLAB_CACHE_H_
+#define _TEST_SLAB_CACHE_H_
+
+#include "CxxTest/TestSuite.h"
+#include "Memory/SlabCache.h"
+
+#define SLAB_TEST_POWER     18
+#define SLAB_TEST_HEAP      (1 << SLAB_TEST_POWER)
+
+class TestSlabCache: public CxxTest::TestSuite {
+    private:
+        struct freeblock mTZL[SLAB_TEST_POWER];
+        uint8_t mBlockMap[BUDDY_MAP_SIZE(SLAB_TEST_POWER)];
+        char mMemHeap[SLAB_TEST_HEAP];
+        BuddyAllocator *mAllocator;
+
+        /** Check the whole heap is back to the allocator */
+        void checkHeapReleased(void);
+
+    public:
+        void setUp(void);
+        void tearDown(void);
+
+        void testGeometry(void);
+        void testAllocFree(void);
+        void testSlabLists(void);
+        void testConstructor(void);
+        void testReap(void);
+        void testExhaustion(void);
+};
+
+#endif /* _TEST_SLAB_CACHE_H_ */
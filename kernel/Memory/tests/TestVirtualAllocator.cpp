@@ -0,0 +1,213 @@
+#include "TestVirtualAllocator.h"
+#include <string.h>
+#include <stdint.h>
+
+#define PAGE    PAGE_FRAME_SIZE
+
+/* Physical memory of the tests, the window of the address space */
+static char memory[TEST_VIRTUAL_FRAMES * PAGE_FRAME_SIZE] __attribute__((aligned(PAGE_FRAME_SIZE)));
+
+void TestVirtualAllocator::setUp(void)
+{
+    uint64_t directory;
+
+    /* Frames hold garbage until they are cleared */
+    memset(memory, 0xA5, sizeof(memory));
+
+    mAllocator = new PageFrameAllocator(mFrames, TEST_VIRTUAL_FRAMES);
+    mAllocator->addRange(0, sizeof(memory));
+    directory = mAllocator->allocPages((PAGE_DIRECTORIES == 4) ? 2 : 0);
+    memset(memory + directory, 0, PAGE_DIRECTORIES * PAGE_FRAME_SIZE);
+    mSpace = new AddressSpace((page_entry_t*) (memory + directory), (uint32_t) directory, memory,
+                              mAllocator, PAGE_LARGE | PAGE_GLOBAL);
+    mRanges = new VirtualAllocator(mSpace, mAllocator, NULL, TEST_VIRTUAL_START, TEST_VIRTUAL_END);
+}
+
+
+void TestVirtualAllocator::tearDown(void)
+{
+    delete mRanges;
+    delete mSpace;
+    delete mAllocator;
+}
+
+
+void TestVirtualAllocator::testReserveFirstFit(void)
+{
+    uint32_t a, b, c, d;
+
+    /* Ranges follow each other, a guard page apart */
+    a = mRanges->reserve(2 * PAGE, PAGE_WRITE);
+    b = mRanges->reserve(PAGE + 1, PAGE_WRITE);
+    c = mRanges->reserve(1, PAGE_WRITE);
+    TS_ASSERT_EQUALS(a, TEST_VIRTUAL_START);
+    TS_ASSERT_EQUALS(b, a + 3 * PAGE);
+    TS_ASSERT_EQUALS(c, b + 3 * PAGE);
+    TS_ASSERT_EQUALS(mRanges->areaCount(), (uint32_t)3);
+    TS_ASSERT_EQUALS(mRanges->reservedPages(), (uint32_t)5);
+
+    /* The lowest gap that fits */
+    mRanges->release(b);
+    TS_ASSERT_EQUALS(mRanges->reservedPages(), (uint32_t)3);
+    d = mRanges->reserve(3 * PAGE, 0);
+    TS_ASSERT_EQUALS(d, c + 2 * PAGE);
+    d = mRanges->reserve(2 * PAGE, 0);
+    TS_ASSERT_EQUALS(d, b);
+
+    TS_ASSERT_EQUALS(mRanges->reserve(0, 0), (uint32_t)0);
+}
+
+
+void TestVirtualAllocator::testReserveExhaustion(void)
+{
+    uint32_t a;
+
+    /* The whole range, but the guard page */
+    TS_ASSERT_EQUALS(mRanges->reserve(64 * PAGE, 0), (uint32_t)0);
+    a = mRanges->reserve(63 * PAGE, 0);
+    TS_ASSERT_EQUALS(a, TEST_VIRTUAL_START);
+    TS_ASSERT_EQUALS(mRanges->reserve(1, 0), (uint32_t)0);
+    TS_ASSERT_EQUALS(mRanges->reserve(0xFFFFFFFFu, 0), (uint32_t)0);
+
+    mRanges->release(a);
+    TS_ASSERT_EQUALS(mRanges->areaCount(), (uint32_t)0);
+    TS_ASSERT_EQUALS(mRanges->reserve(63 * PAGE, 0), TEST_VIRTUAL_START);
+}
+
+
+void TestVirtualAllocator::testLookup(void)
+{
+    const struct virtual_area *area;
+    uint32_t a, b;
+
+    a = mRanges->reserve(2 * PAGE, PAGE_WRITE | VIRTUAL_DEMAND);
+    b = mRanges->reserve(PAGE, 0);
+
+    area = mRanges->lookup(a + PAGE + 0x123);
+    TS_ASSERT(area != NULL);
+    TS_ASSERT_EQUALS(area->address, a);
+    TS_ASSERT_EQUALS(area->length, 2 * PAGE);
+    TS_ASSERT_EQUALS(area->flags, (uint32_t)(PAGE_WRITE | VIRTUAL_DEMAND));
+
+    area = mRanges->lookup(b + PAGE - 1);
+    TS_ASSERT(area != NULL);
+    TS_ASSERT_EQUALS(area->address, b);
+
+    /* Guard pages, and outside of the ranges */
+    TS_ASSERT(mRanges->lookup(a + 2 * PAGE) == NULL);
+    TS_ASSERT(mRanges->lookup(b + PAGE) == NULL);
+    TS_ASSERT(mRanges->lookup(TEST_VIRTUAL_START - 1) == NULL);
+    TS_ASSERT(mRanges->lookup(0) == NULL);
+}
+
+
+void TestVirtualAllocator::testDemandPaging(void)
+{
+    uint32_t frames = mAllocator->freeFrames();
+    uint64_t physical, other;
+    uint32_t a;
+    int i;
+
+    /* Reserving takes no frame */
+    a = mRanges->reserve(8 * PAGE, PAGE_WRITE | VIRTUAL_DEMAND);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+    TS_ASSERT(!mSpace->translate(a, &physical));
+
+    /* The first access takes a page table and a cleared frame */
+    TS_ASSERT(mRanges->fault(a + 3 * PAGE + 0x10, FAULT_WRITE));
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 2);
+    TS_ASSERT_EQUALS(mRanges->backedPages(), (uint32_t)1);
+    TS_ASSERT(mSpace->translate(a + 3 * PAGE, &physical));
+    for (i = 0; i < (int) PAGE; i++) {
+        if (memory[physical + i] != 0) {
+            TS_FAIL("demand frame not cleared");
+            break;
+        }
+    }
+    TS_ASSERT(!mSpace->translate(a + 2 * PAGE, &other));
+
+    /* Another access to the page, then another page */
+    TS_ASSERT(mRanges->fault(a + 3 * PAGE + 0x20, 0));
+    TS_ASSERT_EQUALS(mRanges->backedPages(), (uint32_t)1);
+    TS_ASSERT(mRanges->fault(a, 0));
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 3);
+    TS_ASSERT(mSpace->translate(a, &other));
+    TS_ASSERT(other != physical);
+
+    /* Frames and page table are given back with the range */
+    mRanges->release(a);
+    TS_ASSERT_EQUALS(mRanges->backedPages(), (uint32_t)0);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+    TS_ASSERT(!mSpace->translate(a + 3 * PAGE, &physical));
+}
+
+
+void TestVirtualAllocator::testSparseTable(void)
+{
+    VirtualAllocator ranges(mSpace, mAllocator, NULL, VIRTUAL_START, VIRTUAL_END);
+    uint32_t frames = mAllocator->freeFrames();
+    uint32_t table, entry, tables, lastTable;
+
+    /* A 12 bytes descriptor per frame of 4 GB: 12 MB of addresses */
+    table = ranges.reserve(12 * (1024 * 1024), PAGE_WRITE | VIRTUAL_DEMAND);
+    TS_ASSERT_EQUALS(table, VIRTUAL_START);
+
+    /* Only the pages of the descriptors in use are backed, and their tables */
+    tables = 0;
+    lastTable = 0xFFFFFFFFu;
+    for (entry = 0; entry < 1024 * 1024; entry += 256 * 1024) {
+        TS_ASSERT(ranges.fault(table + 12 * entry, FAULT_WRITE));
+        if ((table + 12 * entry) >> PAGE_LARGE_POWER != lastTable) {
+            lastTable = (table + 12 * entry) >> PAGE_LARGE_POWER;
+            tables++;
+        }
+    }
+    TS_ASSERT_EQUALS(ranges.backedPages(), (uint32_t)4);
+    TS_ASSERT_EQUALS(ranges.reservedPages(), (uint32_t)3072);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames - 4 - tables);
+
+    ranges.release(table);
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+}
+
+
+void TestVirtualAllocator::testFaultRefused(void)
+{
+    uint32_t frames = mAllocator->freeFrames();
+    uint32_t owned, readOnly, demand;
+
+    owned = mRanges->reserve(PAGE, PAGE_WRITE);
+    readOnly = mRanges->reserve(PAGE, VIRTUAL_DEMAND);
+    demand = mRanges->reserve(PAGE, PAGE_WRITE | VIRTUAL_DEMAND);
+
+    /* Ranges mapped by their owner, guard pages, and unreserved addresses */
+    TS_ASSERT(!mRanges->fault(owned, 0));
+    TS_ASSERT(!mRanges->fault(demand + PAGE, FAULT_WRITE));
+    TS_ASSERT(!mRanges->fault(TEST_VIRTUAL_END - PAGE, 0));
+
+    /* Rights of the range, and protection faults */
+    TS_ASSERT(!mRanges->fault(readOnly, FAULT_WRITE));
+    TS_ASSERT(!mRanges->fault(demand, FAULT_PRESENT | FAULT_WRITE));
+    TS_ASSERT_EQUALS(mAllocator->freeFrames(), frames);
+
+    /* Reads of a read only demand range are fine */
+    TS_ASSERT(mRanges->fault(readOnly, 0));
+    TS_ASSERT_EQUALS(mRanges->backedPages(), (uint32_t)1);
+}
+
+
+void TestVirtualAllocator::testNoFrameLeft(void)
+{
+    uint64_t physical;
+    uint32_t a;
+
+    a = mRanges->reserve(2 * PAGE, PAGE_WRITE | VIRTUAL_DEMAND);
+    TS_ASSERT(mRanges->fault(a, FAULT_WRITE));
+
+    while (mAllocator->freeFrames() > 0) {
+        mAllocator->allocPages(0);
+    }
+    TS_ASSERT(!mRanges->fault(a + PAGE, FAULT_WRITE));
+    TS_ASSERT(!mSpace->translate(a + PAGE, &physical));
+    TS_ASSERT_EQUALS(mRanges->backedPages(), (uint32_t)1);
+}
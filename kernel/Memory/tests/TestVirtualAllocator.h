@@ -0,0 +1,34 @@
+#ifndef _TEST_VIRTUAL_ALLOCATOR_H_
+#define _TEST_VIRTUAL_ALLOCATOR_H_
+
+#include "CxxTest/TestSuite.h"
+#include "Memory/VirtualAllocator.h"
+
+/* 256 kB of physical memory: the directory, page tables and demand frames */
+#define TEST_VIRTUAL_FRAMES 64
+
+/* Managed range of the tests: 64 pages */
+#define TEST_VIRTUAL_START  0xF8000000u
+#define TEST_VIRTUAL_END    (TEST_VIRTUAL_START + 64 * PAGE_FRAME_SIZE)
+
+class TestVirtualAllocator: public CxxTest::TestSuite {
+    private:
+        struct page_frame mFrames[TEST_VIRTUAL_FRAMES];
+        PageFrameAllocator *mAllocator;
+        AddressSpace *mSpace;
+        VirtualAllocator *mRanges;
+
+    public:
+        void setUp(void);
+        void tearDown(void);
+
+        void testReserveFirstFit(void);
+        void testReserveExhaustion(void);
+        void testLookup(void);
+        void testDemandPaging(void);
+        void testSparseTable(void);
+        void testFaultRefused(void);
+        void testNoFrameLeft(void);
+};
+
+#endif /* _TEST_VIRTUAL_ALLOCATOR_H_ */
@@ -28,7 +28,7 @@ void panic(const char *fmt, ...)
         printf("\nStack trace:\n");
         for (i = 0; i < entries; ++i) {
                 addr = backtrace_buffer[i];
-                printf(" %3d: %s(%08x)\n", i, symbols[i], (uintptr_t) addr);
+                printf(" %3d: %s(%p)\n", i, symbols[i], addr);
         }
         assert(0 && "Failure. Stop here.");
 }
@@ -20,6 +20,37 @@ ifeq ($(MAKECMDGOALS),$(KERNEL_QEMU_DEBUG))
 	OUTPUT := $(OUTPUT_BASE)/qemu-debug
 endif
 
+# Kernel recording buddy allocator operations, dumped on the qemu debug console
+KERNEL_BUDDY_TRACE := kernel-buddy-trace.bin
+$(KERNEL_BUDDY_TRACE): KERNEL_CFLAGS += -DVGA_DEBUG -DBUDDY_TRACE
+$(KERNEL_BUDDY_TRACE): KERNEL_CXXFLAGS += -DVGA_DEBUG -DBUDDY_TRACE
+ifeq ($(MAKECMDGOALS),$(KERNEL_BUDDY_TRACE))
+	OUTPUT := $(OUTPUT_BASE)/buddy-trace
+endif
+
+# Kernel measuring map and unmap of 4 kB pages, results on the qemu debug console
+KERNEL_PAGING_BENCH := kernel-paging-bench.bin
+$(KERNEL_PAGING_BENCH): KERNEL_CFLAGS += -DQEMU_DEBUG -DPAGING_BENCH
+$(KERNEL_PAGING_BENCH): KERNEL_CXXFLAGS += -DQEMU_DEBUG -DPAGING_BENCH
+ifeq ($(MAKECMDGOALS),$(KERNEL_PAGING_BENCH))
+	OUTPUT := $(OUTPUT_BASE)/paging-bench
+endif
+
+# Kernel with PAE paging, reaching 64 GB of physical memory, qemu debug console
+KERNEL_PAE := kernel-pae.bin
+$(KERNEL_PAE): FLAGS += -DPAGING_PAE
+$(KERNEL_PAE): KERNEL_CFLAGS += -DQEMU_DEBUG -DPAGING_PAE
+$(KERNEL_PAE): KERNEL_CXXFLAGS += -DQEMU_DEBUG -DPAGING_PAE
+ifeq ($(MAKECMDGOALS),$(KERNEL_PAE))
+	OUTPUT := $(OUTPUT_BASE)/pae
+endif
+
+# Host benchmarks of the libraries, no kernel is built
+ifneq ($(filter bench%,$(MAKECMDGOALS)),)
+	OUTPUT := $(OUTPUT_BASE)/bench
+endif
+
 # Summary of all kernel configs
-KERNEL_CONFIGS := $(KERNEL_DEFAULT) $(KERNEL_QEMU_DEBUG)
+KERNEL_CONFIGS := $(KERNEL_DEFAULT) $(KERNEL_QEMU_DEBUG) $(KERNEL_BUDDY_TRACE) $(KERNEL_PAGING_BENCH) \
+                  $(KERNEL_PAE)
 
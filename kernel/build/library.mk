@@ -51,7 +51,7 @@ endif
 # Test binary link
 $$(OUTPUT)/$(1)/test$(1): INCLUDES += -I$(1)/tests/
 $$(OUTPUT)/$(1)/test$(1): $$(OUTPUT)/$(1)/tests/test$(1).o $$(OUTPUT)/lib$(1).a $$($(1)_TEST_OBJS)
-	$$(QCPP) -m32 -o $$@ $$^ -L$$(OUTPUT) -l$(1)
+	$$(QCPP) $$(HOST_LDFLAGS) -o $$@ $$^ -L$$(OUTPUT) -l$(1)
 
 # Test binary generation and compilation
 $$(OUTPUT)/$(1)/tests/test$(1).o: $$(OUTPUT)/$(1)/tests/test$(1).cpp
@@ -74,5 +74,32 @@ lib$(1).a: $$(OUTPUT)/lib$(1).a
 
 endif
 
+### Benchmark target ###
+ifeq ("$(wildcard $(1)/bench)", "$(1)/bench")
+
+# Run the benchmarks, BENCH_ARGS are given to the binary
+bench$(1): $$(OUTPUT)/$(1)/bench$(1)
+	@echo -e "\tBENCH\t  $$@"; $$(OUTPUT)/$(1)/bench$(1) $$(BENCH_ARGS)
+
+$(1)_BENCH_FILES	:= $$(call all-compilables-under, $(1)/bench)
+$(1)_BENCH_OBJS		:= $$(addprefix $$(OUTPUT)/, $$(call objetize-compilables, $$($(1)_BENCH_FILES)))
+$(1)_BENCH_DEPS		:= $$(addprefix $$(OUTPUT)/, $$(call generate-dependencies, $$($(1)_BENCH_FILES)))
+
+ifneq "$$(OUTPUT)" ""
+-include $$($(1)_BENCH_DEPS)
+endif
+
+# Benchmark binary link
+$$(OUTPUT)/$(1)/bench$(1): $$($(1)_BENCH_OBJS) $$(OUTPUT)/lib$(1).a
+	$$(QCPP) $$(HOST_LDFLAGS) -o $$@ $$^ -L$$(OUTPUT) -l$(1)
+
+$$(OUTPUT)/$(1)/bench/%.o: $(1)/bench/%.cpp
+	$$(QCPP) $$(CXXFLAGS) -O2 -I. -I$(1)/bench/ -c $$< -o $$@
+
+$$(OUTPUT)/$(1)/bench/%.o: $(1)/bench/%.c
+	$$(QCC) $$(CFLAGS) -O2 -I. -I$(1)/bench/ -c $$< -o $$@
+
+endif
+
 endef
 
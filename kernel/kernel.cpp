@@ -7,13 +7,140 @@
  * C++ kernel entry point.
  */
 
+#include "Memory/BootstrapAllocator.h"
+#include "Memory/KernelHeap.h"
+#include "Memory/PhysicalMemoryMap.h"
+#include "Memory/PageFrameAllocator.h"
+#include "Memory/VirtualAllocator.h"
+#include "Memory/HighMemory.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include "stdio.h"
+#include "panic.h"
 #include "kernel.h"
-#include "Memory/BootstrapAllocator.h"
+#include "Boot/bootstrap.h"
+#include "Boot/memorymap.h"
+#include "Boot/paging.h"
+#include "Boot/timestamp.h"
+#include "Boot/qemu.h"
+
+/*
+ * Highest physical address of the page frames. The x86_64 kernel has no
+ * kmap window yet, it only reaches the memory its boot page tables map.
+ */
+#ifdef __x86_64__
+#define KERNEL_FRAME_LIMIT      BOOT_MAPPED_SIZE
+#else
+#define KERNEL_FRAME_LIMIT      PAGE_FRAME_LIMIT
+#endif
+
+/**
+ * Carve the bootstrap heap from free memory, out of the DMA zone if it can,
+ * build the bootstrap allocator on it and report how long it took.
+ */
+static void __init kernel_setup_heap(void)
+{
+        PhysicalMemoryMap *map = memorymap_get();
+        BootstrapAllocator *ba;
+        uint64_t start, heap;
+        uint32_t imageEnd, size, align;
+        uint32_t elapsed;
+
+        size = bootstrap_heap_size;
+        size = (size < BOOTSTRAP_MIN_SIZE) ? BOOTSTRAP_MIN_SIZE : size;
+        size = (size > (1u << BOOTSTRAP_MAX_POWER)) ? (1u << BOOTSTRAP_MAX_POWER) : size;
+        size = (size + PAGE_FRAME_SIZE - 1) & ~(PAGE_FRAME_SIZE - 1);
+        imageEnd = (uint32_t) ((uintptr_t) _bss_end - KERNEL_BASE);
+
+        /* Aligned on its arena, so are the blocks of the heap */
+        align = BootstrapAllocator::arenaSize(size);
+        heap = map->carve(size, align, PAGE_ZONE_DMA_END, PAGE_ZONE_NORMAL_END);
+        if (heap == 0) {
+                heap = map->carve(size, align, imageEnd, PAGE_ZONE_NORMAL_END);
+        }
+        if (heap == 0) {
+                panic("init: no free memory for a %u kB bootstrap heap", size / 1024);
+        }
+
+        start = timestamp_read();
+        ba = BootstrapAllocator::setup((char*) (uintptr_t) (heap + KERNEL_BASE), size);
+        elapsed = timestamp_elapsed_us(start);
+
+        printf("init: %u kB bootstrap heap at %08x set up in %u.%03u ms\n",
+               ba->heapSize() / 1024, (uint32_t) heap, elapsed / 1000, elapsed % 1000);
+}
+
+/**
+ * Build the page frame allocator and report how long it took.
+ */
+static void __init kernel_setup_frames(void)
+{
+        PageFrameAllocator *frames;
+        uint64_t start;
+        uint32_t elapsed;
+
+        start = timestamp_read();
+        frames = PageFrameAllocator::setup(memorymap_get(),
+                                           (uintptr_t) _start - KERNEL_BASE,
+                                           (uintptr_t) _bss_end - KERNEL_BASE,
+                                           KERNEL_FRAME_LIMIT);
+        elapsed = timestamp_elapsed_us(start);
+
+        printf("init: %u page frames, %u free, set up in %u.%03u ms\n",
+               frames->frameCount(), frames->freeFrames(),
+               elapsed / 1000, elapsed % 1000);
+        printf("init: zones DMA %u kB, normal %u kB, high %u kB\n",
+               frames->presentFrames(PAGE_ZONE_DMA) * (PAGE_FRAME_SIZE / 1024),
+               frames->presentFrames(PAGE_ZONE_NORMAL) * (PAGE_FRAME_SIZE / 1024),
+               frames->presentFrames(PAGE_ZONE_HIGH) * (PAGE_FRAME_SIZE / 1024));
+}
+
+/**
+ * Build the kmap window and the allocator of the kernel virtual ranges,
+ * backed on demand from now on.
+ */
+static void __init kernel_setup_virtual(void)
+{
+        /* The x86_64 kernel runs on the page tables of crt0.S */
+        if (AddressSpace::getInstance() == NULL) {
+                printf("init: no kernel virtual ranges, the boot page tables are kept\n");
+                return;
+        }
+
+        HighMemory::setup();
+        VirtualAllocator::setup();
+
+        printf("init: %u MB of kernel virtual ranges at %08x\n",
+               (VIRTUAL_END - VIRTUAL_START) >> 20, VIRTUAL_START);
+}
+
+/**
+ * Give a range of the kernel image to the page frame allocator.
+ */
+static void kernel_give_frames(void *start, size_t length)
+{
+        PageFrameAllocator::getInstance()->addRange((uintptr_t) start - KERNEL_BASE, length);
+}
+
+/**
+ * Give the init sections and the free pages of the bootstrap heap to the
+ * page frame allocator, and report how much memory it got back. The kernel
+ * heap keeps growing in the bootstrap heap: a reserve is left to it.
+ */
+static void kernel_reclaim_boot_memory(void)
+{
+        uint32_t initSize, heapSize;
+
+        initSize = (uint32_t) (_init_end - _init_start);
+        kernel_give_frames(_init_start, initSize);
+        heapSize = BootstrapAllocator::getInstance()->handOver(kernel_give_frames, KHEAP_RESERVE);
+
+        printf("init: %u kB reclaimed, %u kB of init sections, %u kB of bootstrap heap\n",
+               (initSize + heapSize) / 1024, initSize / 1024, heapSize / 1024);
+}
 
 void kernel_main(int argc, char **argv)
 {
@@ -22,9 +149,19 @@ void kernel_main(int argc, char **argv)
 
         printf("%s", "Running stage 2 ...\n");
 
-        BootstrapAllocator *ba = BootstrapAllocator::getInstance();
-        (void)ba;
+        kernel_setup_heap();
+        kernel_setup_frames();
+        kernel_setup_virtual();
+
+        /* Nothing from the init sections runs past this point */
+        kernel_reclaim_boot_memory();
 
+#ifdef BUDDY_TRACE
+        BuddyAllocator::dumpTrace(qemu_putbytes);
+#endif
+#ifdef PAGING_BENCH
+        paging_bench();
+#endif
 }
 
 
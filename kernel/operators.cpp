@@ -0,0 +1,59 @@
+/*
+ * operators.cpp
+ *
+ * Copyright (C) 2012 Simple Object Kernel project
+ *
+ * C++ memory operators, wired to the kernel heap. Kept out of the libraries
+ * so that host test binaries keep their own operators.
+ */
+
+#include "stddef.h"
+#include "stdint.h"
+#include "panic.h"
+#include "Memory/kmalloc.h"
+
+/**
+ * Allocate memory for an object. We have no exceptions: running out of
+ * memory in a new expression is fatal.
+ */
+static void *operator_new(size_t size)
+{
+        void *chunk;
+
+        /* Each object must have a distinct address */
+        chunk = kmalloc((size == 0) ? 1 : size);
+        if (chunk == NULL) {
+                panic("operator new: kernel heap exhausted (%lu bytes)", (unsigned long) size);
+        }
+        return chunk;
+}
+
+void *operator new(size_t size)
+{
+        return operator_new(size);
+}
+
+void *operator new[](size_t size)
+{
+        return operator_new(size);
+}
+
+void operator delete(void *chunk)
+{
+        kfree(chunk);
+}
+
+void operator delete[](void *chunk)
+{
+        kfree(chunk);
+}
+
+void operator delete(void *chunk, size_t)
+{
+        kfree(chunk);
+}
+
+void operator delete[](void *chunk, size_t)
+{
+        kfree(chunk);
+}
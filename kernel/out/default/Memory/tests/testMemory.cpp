@@ -0,0 +1,134 @@
+/* Generated file, do not edit */
+
+#ifndef CXXTEST_RUNNING
+#define CXXTEST_RUNNING
+#endif
+
+#define _CXXTEST_HAVE_STD
+#include <CxxTest/TestListener.h>
+#include <CxxTest/TestTracker.h>
+#include <CxxTest/TestRunner.h>
+#include <CxxTest/RealDescriptions.h>
+#include <CxxTest/ErrorPrinter.h>
+
+int main() {
+ return CxxTest::ErrorPrinter().run();
+}
+#include "Memory/tests/TestBootstrapAllocator.h"
+
+static TestBootstrapAllocator suite_TestBootstrapAllocator;
+
+static CxxTest::List Tests_TestBootstrapAllocator = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_TestBootstrapAllocator( "Memory/tests/TestBootstrapAllocator.h", 7, "TestBootstrapAllocator", suite_TestBootstrapAllocator, Tests_TestBootstrapAllocator );
+
+static class TestDescription_TestBootstrapAllocator_testSingleton : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBootstrapAllocator_testSingleton() : CxxTest::RealTestDescription( Tests_TestBootstrapAllocator, suiteDescription_TestBootstrapAllocator, 12, "testSingleton" ) {}
+ void runTest() { suite_TestBootstrapAllocator.testSingleton(); }
+} testDescription_TestBootstrapAllocator_testSingleton;
+
+static class TestDescription_TestBootstrapAllocator_testReset : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBootstrapAllocator_testReset() : CxxTest::RealTestDescription( Tests_TestBootstrapAllocator, suiteDescription_TestBootstrapAllocator, 13, "testReset" ) {}
+ void runTest() { suite_TestBootstrapAllocator.testReset(); }
+} testDescription_TestBootstrapAllocator_testReset;
+
+#include "Memory/tests/TestBuddyAllocator.h"
+
+static TestBuddyAllocator suite_TestBuddyAllocator;
+
+static CxxTest::List Tests_TestBuddyAllocator = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_TestBuddyAllocator( "Memory/tests/TestBuddyAllocator.h", 10, "TestBuddyAllocator", suite_TestBuddyAllocator, Tests_TestBuddyAllocator );
+
+static class TestDescription_TestBuddyAllocator_testHeapSize : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testHeapSize() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 20, "testHeapSize" ) {}
+ void runTest() { suite_TestBuddyAllocator.testHeapSize(); }
+} testDescription_TestBuddyAllocator_testHeapSize;
+
+static class TestDescription_TestBuddyAllocator_testSimpleAllocations : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testSimpleAllocations() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 21, "testSimpleAllocations" ) {}
+ void runTest() { suite_TestBuddyAllocator.testSimpleAllocations(); }
+} testDescription_TestBuddyAllocator_testSimpleAllocations;
+
+static class TestDescription_TestBuddyAllocator_testFreeBoundaries : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testFreeBoundaries() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 22, "testFreeBoundaries" ) {}
+ void runTest() { suite_TestBuddyAllocator.testFreeBoundaries(); }
+} testDescription_TestBuddyAllocator_testFreeBoundaries;
+
+static class TestDescription_TestBuddyAllocator_testCheckAddresses : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testCheckAddresses() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 23, "testCheckAddresses" ) {}
+ void runTest() { suite_TestBuddyAllocator.testCheckAddresses(); }
+} testDescription_TestBuddyAllocator_testCheckAddresses;
+
+static class TestDescription_TestBuddyAllocator_testFullAllocationsBySizes : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testFullAllocationsBySizes() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 24, "testFullAllocationsBySizes" ) {}
+ void runTest() { suite_TestBuddyAllocator.testFullAllocationsBySizes(); }
+} testDescription_TestBuddyAllocator_testFullAllocationsBySizes;
+
+static class TestDescription_TestBuddyAllocator_testAllocateOneOfEachSize : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testAllocateOneOfEachSize() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 25, "testAllocateOneOfEachSize" ) {}
+ void runTest() { suite_TestBuddyAllocator.testAllocateOneOfEachSize(); }
+} testDescription_TestBuddyAllocator_testAllocateOneOfEachSize;
+
+static class TestDescription_TestBuddyAllocator_testSmallAllocations : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testSmallAllocations() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 26, "testSmallAllocations" ) {}
+ void runTest() { suite_TestBuddyAllocator.testSmallAllocations(); }
+} testDescription_TestBuddyAllocator_testSmallAllocations;
+
+static class TestDescription_TestBuddyAllocator_testBadAllocationRequests : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testBadAllocationRequests() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 28, "testBadAllocationRequests" ) {}
+ void runTest() { suite_TestBuddyAllocator.testBadAllocationRequests(); }
+} testDescription_TestBuddyAllocator_testBadAllocationRequests;
+
+static class TestDescription_TestBuddyAllocator_testBadFreeRequests : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestBuddyAllocator_testBadFreeRequests() : CxxTest::RealTestDescription( Tests_TestBuddyAllocator, suiteDescription_TestBuddyAllocator, 29, "testBadFreeRequests" ) {}
+ void runTest() { suite_TestBuddyAllocator.testBadFreeRequests(); }
+} testDescription_TestBuddyAllocator_testBadFreeRequests;
+
+#include "Memory/tests/TestPhysicalMemoryMap.h"
+
+static TestPhysicalMemoryMap suite_TestPhysicalMemoryMap;
+
+static CxxTest::List Tests_TestPhysicalMemoryMap = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_TestPhysicalMemoryMap( "Memory/tests/TestPhysicalMemoryMap.h", 7, "TestPhysicalMemoryMap", suite_TestPhysicalMemoryMap, Tests_TestPhysicalMemoryMap );
+
+static class TestDescription_TestPhysicalMemoryMap_testGetFreeChunk : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestPhysicalMemoryMap_testGetFreeChunk() : CxxTest::RealTestDescription( Tests_TestPhysicalMemoryMap, suiteDescription_TestPhysicalMemoryMap, 26, "testGetFreeChunk" ) {}
+ void runTest() { suite_TestPhysicalMemoryMap.testGetFreeChunk(); }
+} testDescription_TestPhysicalMemoryMap_testGetFreeChunk;
+
+static class TestDescription_TestPhysicalMemoryMap_testClear : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestPhysicalMemoryMap_testClear() : CxxTest::RealTestDescription( Tests_TestPhysicalMemoryMap, suiteDescription_TestPhysicalMemoryMap, 27, "testClear" ) {}
+ void runTest() { suite_TestPhysicalMemoryMap.testClear(); }
+} testDescription_TestPhysicalMemoryMap_testClear;
+
+static class TestDescription_TestPhysicalMemoryMap_testCurrent : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestPhysicalMemoryMap_testCurrent() : CxxTest::RealTestDescription( Tests_TestPhysicalMemoryMap, suiteDescription_TestPhysicalMemoryMap, 28, "testCurrent" ) {}
+ void runTest() { suite_TestPhysicalMemoryMap.testCurrent(); }
+} testDescription_TestPhysicalMemoryMap_testCurrent;
+
+static class TestDescription_TestPhysicalMemoryMap_testNext : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestPhysicalMemoryMap_testNext() : CxxTest::RealTestDescription( Tests_TestPhysicalMemoryMap, suiteDescription_TestPhysicalMemoryMap, 29, "testNext" ) {}
+ void runTest() { suite_TestPhysicalMemoryMap.testNext(); }
+} testDescription_TestPhysicalMemoryMap_testNext;
+
+static class TestDescription_TestPhysicalMemoryMap_testRewind : public CxxTest::RealTestDescription {
+public:
+ TestDescription_TestPhysicalMemoryMap_testRewind() : CxxTest::RealTestDescription( Tests_TestPhysicalMemoryMap, suiteDescription_TestPhysicalMemoryMap, 30, "testRewind" ) {}
+ void runTest() { suite_TestPhysicalMemoryMap.testRewind(); }
+} testDescription_TestPhysicalMemoryMap_testRewind;
+
+#include <CxxTest/Root.cpp>